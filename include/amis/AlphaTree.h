@@ -67,70 +67,47 @@ public:
       outside_prod.resize(max_id);
     }
     // Initialize & inside product
-    //cerr << "inside prod" << std::endl;
-    typename std::vector< ParameterValue >::iterator inside_it = inside_prod.begin();
-    typename std::vector< ParameterValue >::iterator outside_it = outside_prod.begin();
-    //typename std::vector< Real >::iterator sum_ref_it = sum_reference.begin();
-    for ( typename EventTree< Feature, ReferenceProbability >::const_iterator event_node = event_tree.begin();
-          event_node != event_tree.end();
-          ++event_node, ++inside_it, ++outside_it ) {
-      outside_it->clear(); // initialize outside products
-      if ( event_node->isDisjunctiveNode() ) {
+    const EventTreeNodeID num_nodes = event_tree.numEventTreeNodes();
+    for ( EventTreeNodeID id = 0; id < num_nodes; ++id ) {
+      ParameterValue& inside = inside_prod[ id ];
+      outside_prod[ id ].clear(); // initialize outside products
+      const EventTreeNodeID* dtr_begin = event_tree.daughterBegin( id );
+      const EventTreeNodeID* dtr_end = event_tree.daughterEnd( id );
+      if ( event_tree.isDisjunctiveNode( id ) ) {
         AMIS_PROF3( "AlphaTree::inside_prod(disj)" );
-	inside_it->accumulate( inside_prod, event_node->daughterList().begin(), event_node->daughterList().end() );
+	inside.accumulate( inside_prod, dtr_begin, dtr_end );
       }
       else {
         AMIS_PROF3( "AlphaTree:inside_prod(conj)" );
         // conjunctive node
-        inside_it->initValue( ParameterValue::exponent( parameterspace.getParameters(), event_node->featureList() ) );
+        inside.initValue( ParameterValue::exponent( parameterspace.getParameters(), event_tree.featureList( id ) ) );
         if ( ReferenceProbability ) {
-          *inside_it *= event_node->featureList().referenceProbability();
+          inside *= event_tree.referenceProbability( id );
         }
-        for ( EventTreeNodeIDList::const_iterator dtr = event_node->daughterList().begin();
-              dtr != event_node->daughterList().end();
-              ++dtr ) {
-          *inside_it *= inside_prod[ *dtr ];
+        for ( const EventTreeNodeID* dtr = dtr_begin; dtr != dtr_end; ++dtr ) {
+          inside *= inside_prod[ *dtr ];
         }
       }
     }
     // summation of products
-    --inside_it;
-    sum_product = *inside_it;
+    sum_product = inside_prod[ num_nodes - 1 ];
 
-    --outside_it;// --alpha_it;
-    outside_it->initAlpha( 1.0 );
-    for ( typename EventTree< Feature, ReferenceProbability >::const_reverse_iterator event_node = event_tree.rbegin();
-          event_node != event_tree.rend();
-          ++event_node, --outside_it, --inside_it ) {
-      if ( event_node->isDisjunctiveNode() ) {
+    outside_prod[ num_nodes - 1 ].initAlpha( 1.0 );
+    for ( EventTreeNodeID id = num_nodes; id-- > 0; ) {
+      const EventTreeNodeID* dtr_begin = event_tree.daughterBegin( id );
+      const EventTreeNodeID* dtr_end = event_tree.daughterEnd( id );
+      if ( event_tree.isDisjunctiveNode( id ) ) {
         AMIS_PROF3( "AlphaTree::outside_prod(disj)" );
         // disjunctive node
-        for ( EventTreeNodeIDList::const_iterator dtr = event_node->daughterList().begin();
-              dtr != event_node->daughterList().end();
-              ++dtr ) {
-          outside_prod[ *dtr ] += *outside_it;
-        }
+        ParameterValue::addEach( outside_prod, dtr_begin, dtr_end, ParameterValue( outside_prod[ id ] ) );
       }
       else {
         AMIS_PROF3( "AlphaTree::outside_prod(conj)" );
         // conjunctive node
-        //outside_it->accumulate( outside_prod, event_node->motherList(), max_freq );
         // optimized version
-        const EventTreeNodeIDList& daughters = event_node->daughterList();
-        if ( ! daughters.empty() ) {
-	  ParameterValue inside_outside;
-	  //inside_outside.product(*outside_it, *inside_it);
-	  inside_outside = product(*outside_it, *inside_it);
-          for ( size_t id = 0; id < daughters.size(); ++id ) {
-	    if (!inside_prod[ daughters[ id ] ].isZero() ) {
-	      //std::cerr << outside_prod[daughters[id]].getValue() << ", ";
-	      outside_prod[ daughters[ id ] ].incQuotient( inside_outside,
-							   inside_prod[ daughters[ id ] ]);
-	      //std::cerr << inside_outside.getValue() << ", "
-	      //<< inside_prod[daughters[ id ]].getValue() << ", "
-	      //<< outside_prod[ daughters[ id ] ].getValue() << std::endl;
-	    }
-          }
+        if ( dtr_begin != dtr_end ) {
+	  ParameterValue inside_outside = product( outside_prod[ id ], inside_prod[ id ] );
+	  ParameterValue::incQuotientEach( outside_prod, inside_prod, dtr_begin, dtr_end, inside_outside );
         }
       }
     }
@@ -190,67 +167,50 @@ public:
       maximizers.resize(max_id);
     }
     // Initialize & inside product
-    //cerr << "inside prod" << std::endl;
-    typename std::vector< ParameterValue >::iterator inside_it = inside_prod.begin();
-    typename std::vector< EventTreeNodeID >::iterator max_it = max_dtr.begin();
-    std::vector< bool >::iterator check_it = maximizers.begin();
-    //typename std::vector< Real >::iterator sum_ref_it = sum_reference.begin();
-    for ( typename EventTree< Feature, ReferenceProbability >::const_iterator event_node = event_tree.begin();
-          event_node != event_tree.end();
-          ++event_node, ++inside_it, ++max_it, ++check_it ) {
-      *max_it = 0;
-      *check_it = false;
-      if ( event_node->isDisjunctiveNode() ) {
+    const EventTreeNodeID num_nodes = event_tree.numEventTreeNodes();
+    for ( EventTreeNodeID id = 0; id < num_nodes; ++id ) {
+      ParameterValue& inside = inside_prod[ id ];
+      max_dtr[ id ] = 0;
+      maximizers[ id ] = false;
+      const EventTreeNodeID* dtr_begin = event_tree.daughterBegin( id );
+      const EventTreeNodeID* dtr_end = event_tree.daughterEnd( id );
+      if ( event_tree.isDisjunctiveNode( id ) ) {
         AMIS_PROF3( "AlphaTree::inside_prod(disj)" );
-	const EventTreeNodeIDList& dtrs = event_node->daughterList();
-	inside_it->clear();
-	
-	for ( EventTreeNodeIDList::const_iterator it = dtrs.begin();
-	      it != dtrs.end();
-	      ++it ) {
-	  if ( inside_prod[*it].getValue() > inside_it->getValue() ) {
-	    *inside_it = inside_prod[*it];
-	    *max_it = *it;
+	inside.clear();
+	for ( const EventTreeNodeID* dtr = dtr_begin; dtr != dtr_end; ++dtr ) {
+	  if ( inside_prod[ *dtr ].getValue() > inside.getValue() ) {
+	    inside = inside_prod[ *dtr ];
+	    max_dtr[ id ] = *dtr;
 	  }
 	}
       }
       else {
         AMIS_PROF3( "AlphaTree:inside_prod(conj)" );
         // conjunctive node
-        inside_it->initValue( ParameterValue::exponent( parameterspace.getParameters(), event_node->featureList() ) );
+        inside.initValue( ParameterValue::exponent( parameterspace.getParameters(), event_tree.featureList( id ) ) );
         if ( ReferenceProbability ) {
-          *inside_it *= event_node->featureList().referenceProbability();
+          inside *= event_tree.referenceProbability( id );
         }
-        for ( EventTreeNodeIDList::const_iterator dtr = event_node->daughterList().begin();
-              dtr != event_node->daughterList().end();
-              ++dtr ) {
-          *inside_it *= inside_prod[*dtr];
+        for ( const EventTreeNodeID* dtr = dtr_begin; dtr != dtr_end; ++dtr ) {
+          inside *= inside_prod[ *dtr ];
         }
       }
     }
     // summation of products
-    --inside_it;
-    max_product = *inside_it;
+    max_product = inside_prod[ num_nodes - 1 ];
 
-    --max_it;
-    --check_it;// --alpha_it;
-    *check_it = true;
-    for ( typename EventTree< Feature, ReferenceProbability >::const_reverse_iterator event_node = event_tree.rbegin();
-          event_node != event_tree.rend();
-          ++event_node, --max_it, --check_it ) {
-      if ( *check_it ) {
-	if ( event_node->isDisjunctiveNode() ) {
+    maximizers[ num_nodes - 1 ] = true;
+    for ( EventTreeNodeID id = num_nodes; id-- > 0; ) {
+      if ( maximizers[ id ] ) {
+	if ( event_tree.isDisjunctiveNode( id ) ) {
 	  AMIS_PROF3( "AlphaTree::outside_prod(disj)" );
 	  // disjunctive node
-	  maximizers[*max_it] = true;
+	  maximizers[ max_dtr[ id ] ] = true;
 	}
 	else {
 	  AMIS_PROF3( "AlphaTree::outside_prod(conj)" );
-	  const EventTreeNodeIDList& daughters = event_node->daughterList();
-	  for ( EventTreeNodeIDList::const_iterator it = daughters.begin();
-		it != daughters.end();
-		++it ) {
-	    maximizers[*it] = true;
+	  for ( const EventTreeNodeID* dtr = event_tree.daughterBegin( id ); dtr != event_tree.daughterEnd( id ); ++dtr ) {
+	    maximizers[ *dtr ] = true;
 	  }
 	}
       }
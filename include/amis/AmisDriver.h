@@ -143,6 +143,8 @@ public:
   virtual void inputModel( ModelFormat& format, NameTable& name_table, ModelBase& model );
   /// Input events by using the event format
   virtual void inputEventSpace( EventReader& format, EventSpace& event_space );
+  /// Identifier of the type of events stored in an event cache
+  std::string eventCacheSignature();
   
   /// Input events by using the event format while making a model
 
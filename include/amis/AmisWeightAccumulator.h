@@ -31,11 +31,32 @@ AMIS_NAMESPACE_BEGIN
 
 template<class Feature, class ParameterValue, bool ReferenceProbability>
 class AmisWeightAccumulator : public WeightAccumulator {
+  /// Unnormalized probabilities of the feature lists of an event (scratch)
+  std::vector<ParameterValue> prod;
 public:
   typedef Event<Feature, ReferenceProbability> EventType;
   AmisWeightAccumulator()
   { }
 
+  WeightAccumulator* clone() const
+  {
+    return new AmisWeightAccumulator<Feature, ParameterValue, ReferenceProbability>();
+  }
+
+  void collectFeatures(const EventBase& event_base,
+		       std::vector<FeatureID>& features) const
+  {
+    const EventType& event =
+      dynamic_cast<const EventType&>(event_base);
+    for ( typename EventType::const_iterator fl = event.begin(); fl != event.end(); ++fl ) {
+      for ( typename FeatureList<Feature>::const_iterator feature = fl->begin();
+	    feature != fl->end();
+	    ++feature ) {
+	features.push_back(feature->id());
+      }
+    }
+  }
+
   void empiricalCount(std::vector<Real>& ee,
 		      const EventBase& event_base,
 		      Real event_empirical_expectation)
@@ -57,13 +78,31 @@ public:
 		  Real event_empirical_expectation,
 		  const ModelBase& model)
   {
-    const EventType& event =
-      dynamic_cast<const EventType&>(event_base);
-    const ParameterSpace<ParameterValue>* parameterspace =
-      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace());
+    return modelCount(me,
+		      dynamic_cast<const EventType&>(event_base),
+		      event_empirical_expectation,
+		      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace()));
+  }
+
+  Real modelCountRange(std::vector<Real>& me,
+		       const EventBase* const* events,
+		       size_t num_events,
+		       Real event_empirical_expectation,
+		       const ModelBase& model)
+  {
+    return modelCountEach<EventType, ParameterValue>(*this, me, events, num_events,
+						     event_empirical_expectation, model);
+  }
+
+  /// Model expectation of an event of the concrete type
+  Real modelCount(std::vector<Real>& me,
+		  const EventType& event,
+		  Real event_empirical_expectation,
+		  const ParameterSpace<ParameterValue>* parameterspace)
+  {
 
     int n = event.numFeatureList();
-    std::vector<ParameterValue> prod(n);
+    growScratch(prod, n);
     typename std::vector<ParameterValue>::iterator pt;
     Real sum = 0.0;
 
@@ -71,7 +110,7 @@ public:
     for ( typename EventType::const_iterator fl = event.begin(); fl != event.end(); ++pt, ++fl ) {
       pt->initValue(ParameterValue::exponent( parameterspace->getParameters(), *fl ));
     }
-    ParameterValue::scale_prob(prod.begin(), prod.end());
+    ParameterValue::scale_prob(prod.begin(), prod.begin() + n);
 
     pt = prod.begin();
     for ( typename EventType::const_iterator fl = event.begin(); fl != event.end(); ++pt, ++fl ) {
@@ -127,21 +166,22 @@ public:
       dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace());
 
     size_t n = event.numFeatureList();
-    std::vector<Real> prod(n);
+    growScratch(prod, n);
 
     for ( size_t i = 0; i < n; ++i ) {
-      prod[i] = ParameterValue::exponent(parameterspace->getParameters(), event[i]);
+      prod[i].initValue(ParameterValue::exponent(parameterspace->getParameters(), event[i]));
     }
 
     Real max = 0.0;
     size_t max_target = 0;
     for ( size_t i = 0; i < n; ++i ) {
+      Real score = prod[i].getValue();
       if ( ReferenceProbability ) {
-	prod[i] *= event[i].referenceProbability();
+	score *= event[i].referenceProbability();
 	//ref_sum += fl->referenceProbability();
       }
-      if ( prod[i] > max ) {
-	max = prod[i];
+      if ( score > max ) {
+	max = score;
 	max_target = i;
       }
     }
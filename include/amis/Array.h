@@ -108,7 +108,12 @@ public:
     return *this;
   }
   
+  /// Change the number of elements; the values of the elements are
+  /// unspecified afterwards.  The storage is reused when the size is
+  /// unchanged, as is the case when a single event object is read over
+  /// and over from an event file.
   void resize( size_type n ) {
+    if ( n == size() ) return;
     if ( head != NULL ) deallocate( head, tail - head );
     if ( n ) {
       head = allocate( n );
@@ -118,32 +123,33 @@ public:
     }
   }
 
+  /// Refer to the elements [first, last) owned by someone else, such as
+  /// an EventArena.  The array must not be destroyed nor assigned
+  /// afterwards, because it does not own the elements.
+  void attach( T* first, T* last ) {
+    head = first;
+    tail = last;
+  }
+
   void swap( T& x ) {
     std::swap( head, x.head );
     std::swap( tail, x.tail );
   }
   
 public:
+  /// Read the elements in one block
   void readObject( objstream& is ) {
-    if ( head != NULL ) deallocate( head, tail - head );
-    size_type num;
+    size_type num = 0;
     is >> num;
-    if ( num == 0 ) {
-      head = tail = NULL;
-    } else {
-      head = allocate( num );
-      tail = head + num;
-      for ( T* it = head; it != tail; ++it ) {
-        it->readObject( is );
-      }
-    }
+    if ( ! is ) return;
+    resize( num );
+    is.readBlock( head, num );
   }
 
+  /// Write the elements in one block; T must be a plain type
   void writeObject( objstream& os ) const {
     os << size();
-    for( T* it = head; it != tail; ++it ) {
-      it->writeObject( os );
-    }
+    os.writeBlock( head, size() );
   }
 };
 
@@ -37,6 +37,8 @@ private:
 protected:
   void initNormalizers()
   {
+    model_expectation.setNumThreads( num_threads );
+    model_expectation.setDeterministic( deterministic_reduction );
     model_expectation.initialize( model, event_space );
     empirical_expectation.initialize( model, event_space );
     empirical_expectation.setEmpiricalExpectation();
@@ -52,6 +54,17 @@ protected:
     return ret;
   }
 
+  /// Print ending message with the usage of threads
+  void endingMessage()
+  {
+    Estimator::endingMessage();
+    if ( model_expectation.numWorkers() > 1 ) {
+      OStringStream os;
+      model_expectation.writeThreadUsage( os );
+      AMIS_PROF_MESSAGE( os.str() << std::flush );
+    }
+  }
+
   Real modelExpectation(int i)
   {
     return model_expectation[i];// / empirical_variance->getFeatureScale(i);
@@ -73,19 +73,41 @@ private:
   char_type* in_buffer;
   size_type out_buffer_size;
   char_type* out_buffer;
+  bool in_body;        // a stream has been started and not finished
+  bool stream_end;     // the current stream has been finished
+  bool end_of_input;
+  size_type num_streams;
 
-public:
-  /// Constructor
-  explicit IBzStreamBuf( std::istream& is, size_type s = DEFAULT_BUFFER_SIZE )
-    : in_stream( is ) {
-    bz.next_in = NULL;
-    bz.avail_in = 0;
+  /// Initialize bzlib for the next stream
+  void initialize() {
     bz.bzalloc = NULL;
     bz.bzfree = NULL;
     bz.opaque = NULL;
     if ( BZ2_bzDecompressInit( &bz, 0, 0 ) != BZ_OK ) {
       throw BzStreamError( "Initialization of bzlib failed" );
     }
+  }
+
+public:
+  /// Description of an error status of bzlib
+  static std::string errorMessage( int status ) {
+    switch ( status ) {
+    case BZ_DATA_ERROR: return "Decompression by bzlib failed: data integrity error";
+    case BZ_DATA_ERROR_MAGIC: return "Decompression by bzlib failed: not a bzip2 stream";
+    case BZ_MEM_ERROR: return "Decompression by bzlib failed: out of memory";
+    case BZ_PARAM_ERROR: return "Decompression by bzlib failed: parameter error";
+    case BZ_SEQUENCE_ERROR: return "Decompression by bzlib failed: sequence error";
+    default: return "Decompression by bzlib failed";
+    }
+  }
+
+  /// Constructor
+  explicit IBzStreamBuf( std::istream& is, size_type s = DEFAULT_BUFFER_SIZE )
+    : in_stream( is ), in_body( false ), stream_end( false ),
+      end_of_input( false ), num_streams( 0 ) {
+    bz.next_in = NULL;
+    bz.avail_in = 0;
+    initialize();
     in_buffer_size = s;
     in_buffer = new char_type[ in_buffer_size ];
     out_buffer_size = s;
@@ -103,26 +125,52 @@ public:
 public:
   /// Called when out_buffer is empty
   int underflow() {
-    bz.next_out = out_buffer;
-    bz.avail_out = out_buffer_size;
-    while ( true ) {
+    std::streambuf::setg( NULL, NULL, NULL );
+    while ( ! end_of_input ) {
       if ( bz.avail_in == 0 ) {
         in_stream.read( in_buffer, in_buffer_size );
-        if ( in_stream.gcount() == 0 ) return EOF;
         bz.next_in = in_buffer;
         bz.avail_in = in_stream.gcount();
+        if ( bz.avail_in == 0 ) {
+          if ( in_body ) throw BzStreamError( "Unexpected end of bzip2 stream" );
+          end_of_input = true;
+          break;
+        }
       }
+      if ( stream_end ) {
+        // another stream follows, as written by parallel compressors
+        char* next_in = bz.next_in;
+        unsigned int avail_in = bz.avail_in;
+        BZ2_bzDecompressEnd( &bz );
+        initialize();
+        bz.next_in = next_in;
+        bz.avail_in = avail_in;
+        stream_end = false;
+      }
+      bz.next_out = out_buffer;
+      bz.avail_out = out_buffer_size;
+      in_body = true;
       int status = BZ2_bzDecompress( &bz );
       if ( status == BZ_STREAM_END ) {
-        std::streambuf::setg( out_buffer, out_buffer, out_buffer + out_buffer_size - bz.avail_out );
-        return *out_buffer;
+        in_body = false;
+        stream_end = true;
+        ++num_streams;
+      }
+      else if ( status == BZ_DATA_ERROR_MAGIC && num_streams > 0 ) {
+        // trailing garbage is ignored as bzip2 does
+        in_body = false;
+        end_of_input = true;
+      }
+      else if ( status != BZ_OK ) {
+        throw BzStreamError( errorMessage( status ) );
       }
-      if ( status != BZ_OK ) throw BzStreamError( "Decompression by bzlib failed" );
-      if ( bz.avail_out == 0 ) {
-        std::streambuf::setg( out_buffer, out_buffer, out_buffer + out_buffer_size );
-        return *out_buffer;
+      size_type size = out_buffer_size - bz.avail_out;
+      if ( size > 0 ) {
+        std::streambuf::setg( out_buffer, out_buffer, out_buffer + size );
+        return static_cast< unsigned char >( *out_buffer );
       }
     }
+    return EOF;
   }
 };
 
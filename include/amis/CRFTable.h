@@ -16,6 +16,7 @@
 
 #include <amis/configure.h>
 #include <amis/EventCRF.h>
+#include <amis/DenseKernel.h>
 #include <vector>
 
 AMIS_NAMESPACE_BEGIN
@@ -23,8 +24,11 @@ AMIS_NAMESPACE_BEGIN
 //////////////////////////////////////////////////////////////////////
 
 /**
- * Partially calculated alpha product values are stored in a tree
- * structure according to the tree structure of an event.
+ * Forward and backward products of a linear-chain event are stored in
+ * contiguous matrices of positions x states, which grow to the longest
+ * event seen.  Transitions are summed over the compressed rows of
+ * CRFTransition, or by a matrix-vector product when the transitions are
+ * compiled densely.
  */
 
 template < class Feature, class ParameterValue, bool ReferenceProbability = false >
@@ -40,55 +44,83 @@ private:
   size_t max_length;
   size_t num_targets;
   size_t num_states;
-  std::vector< std::vector< ParameterValue > > state_weight;
-  std::vector< std::vector< ParameterValue > > forward_prod;
-  std::vector< std::vector< ParameterValue > > backward_prod;
-  //std::vector< std::vector< ParameterValue > > tmp_prod;
+  // max_length x num_targets and max_length x num_states matrices
+  std::vector< ParameterValue > state_weight;
+  std::vector< ParameterValue > forward_prod;
+  std::vector< ParameterValue > backward_prod;
   ParameterValue sum_forward;
-  //std::vector< Real > sum_reference;
+  // work area of the dense transitions
+  std::vector< ParameterValue > next_sum;
+  std::vector< Real > linear_row;
+  std::vector< Real > linear_sum;
+
+  ParameterValue* weightRow( size_t index ) { return &state_weight[ index * num_targets ]; }
+  ParameterValue* forwardRow( size_t index ) { return &forward_prod[ index * num_states ]; }
+  ParameterValue* backwardRow( size_t index ) { return &backward_prod[ index * num_states ]; }
+
+  void allocate( size_t length )
+  {
+    if ( length <= max_length ) return;
+    max_length = length;
+    state_weight.resize( max_length * num_targets );
+    forward_prod.resize( max_length * num_states );
+    backward_prod.resize( max_length * num_states );
+  }
+
+  /// y[ state ] = sum of x[ s ] over the transitions s -> state
+  /// (forward) or state -> s (backward)
+  void transitionSum( const ParameterValue* x, ParameterValue* y, bool forward )
+  {
+    Real shift;
+    const Real* lx = ParameterValue::linearRow( x, num_states, &linear_row[ 0 ], shift );
+    DenseKernel::product( forward ? transition.forwardMatrix() : transition.backwardMatrix(),
+			  lx, &linear_sum[ 0 ], num_states );
+    for ( size_t state = 0; state < num_states; ++state ) {
+      y[ state ].initLinear( linear_sum[ state ], shift );
+    }
+  }
 
 public:
   /// Constructor
   CRFTable(const FixedTarget& ft, const CRFTransition& crf)
-    : fixed_target(ft), transition(crf)
+    : fixed_target(ft), transition(crf), max_length(0)
   {
     num_targets = fixed_target.numTargets();
     num_states = transition.numStates();
-    state_weight.resize(200, std::vector<ParameterValue>(num_targets));
-    forward_prod.resize(200, std::vector<ParameterValue>(num_states));
-    backward_prod.resize(200, std::vector<ParameterValue>(num_states));
+    next_sum.resize(num_states);
+    linear_row.resize(num_states);
+    linear_sum.resize(num_states);
   }
   /// Destructor
   ~CRFTable() {}
 
 public:
-  /// Initialize the tree of the size _id_ with alpha sets of the size _freq_
-  /// Set the products of alpha values to the tree
+  /// Set the products of alpha values by the forward-backward algorithm,
+  /// and return the log of the factor by which they are scaled.
+  /// The state products of each position, and then the forward products
+  /// of each position, are divided by their largest value, so that the
+  /// products stay in range on long events; the backward products share
+  /// the factors of the forward products, which cancel in targetWeight().
   Real setProduct( const ParameterSpace<ParameterValue>& parameterspace,
 		   const EventCRF< Feature, ReferenceProbability >& event_crf )
   {
     Real log_scale = 0.0;
-    //std::cerr << "start setProduct" << std::endl;
-    //event_crf.getTransition().debugInfo(std::cerr);
 
     size_t crf_length = event_crf.length();
     if ( crf_length == 0 || num_states == 0 ||
 	 num_targets == 0 || parameterspace.getParameters().size() == 0 ) return 0.0;
-    if ( crf_length >= forward_prod.size() ) {
-      state_weight.resize(crf_length, std::vector<ParameterValue>(num_targets));
-      forward_prod.resize(crf_length, std::vector<ParameterValue>(num_states));
-      backward_prod.resize(crf_length, std::vector<ParameterValue>(num_states));
-      //tmp_prod.resize(crf_length, std::vector<ParameterValue>(num_states));
-    }
-    
+    allocate( crf_length );
+    // transitions are multiplied by a matrix if it is made and the values allow
+    bool dense = transition.hasDenseTransitions() && ParameterValue::denseTransition();
+
     FeatureID start_state = event_crf.observedEventIDs().front();
     FeatureID end_state = event_crf.observedEventIDs().back();
 
     for ( size_t index = 0; index < crf_length; ++index ) {
       const std::vector<Feature>& hist_list  = event_crf.getHistoryList()[index];
-      std::vector<ParameterValue>& state_weight_index(state_weight[index]);
+      ParameterValue* weight = weightRow( index );
       for ( size_t target = 0; target < num_targets; ++target ) {
-	state_weight_index[target].initAlpha(1.0);
+	weight[target].initAlpha(1.0);
       }
       for( typename std::vector<Feature>::const_iterator itr = hist_list.begin();
 	   itr != hist_list.end();
@@ -97,86 +129,92 @@ public:
 	ParameterValue::exponent_fix(parameterspace.getParameters(),
 				     fixed_target.getFeatures(itr->id()),
 				     freq,
-				     state_weight_index);
+				     weight);
       }
     }
 
     for ( size_t index = 0; index < crf_length; ++index ) {
-      std::vector<ParameterValue>& state_weight_index(state_weight[index]);
-      std::vector<ParameterValue>& backward_prod_index(backward_prod[index]);
+      ParameterValue* weight = weightRow( index );
+      ParameterValue* backward = backwardRow( index );
       for ( size_t state = 0; state < num_states; ++state ) {
-	const std::vector<FeatureID>& targets(transition.out(state));
 	ParameterValue tmp; tmp.initAlpha(1.0);
-	for ( std::vector<FeatureID>::const_iterator tt = targets.begin();
-	      tt != targets.end();
-	      ++tt ) {
-	  tmp *= state_weight_index[*tt];
+	for ( const FeatureID* tt = transition.outBegin( state ); tt != transition.outEnd( state ); ++tt ) {
+	  tmp *= weight[*tt];
 	}
-	backward_prod_index[state] = tmp;
+	backward[state] = tmp;
       }
+      // a single position must not overflow the forward products
+      log_scale += ParameterValue::scale_weight(backward, NULL, num_states);
       for ( size_t target = 0; target < num_targets; ++ target ) {
-	state_weight_index[target].initAlpha(0.0);
+	weight[target].initAlpha(0.0);
       }
     }
 
+    ParameterValue* forward = forwardRow( 0 );
     for ( size_t state = 0; state < num_states; ++state ) {
-      forward_prod[0][state].initAlpha(0);
+      forward[state].initAlpha(0);
     }
-    forward_prod[0][start_state] = backward_prod[0][start_state];
+    forward[start_state] = backwardRow( 0 )[start_state];
 
-    log_scale += log(ParameterValue::scale_weight(forward_prod[0], backward_prod[0]));
+    log_scale += ParameterValue::scale_weight(forward, backwardRow( 0 ), num_states);
     for ( size_t index = 1; index < crf_length; ++index ) {
-      std::vector<ParameterValue>& forward_prod_index(forward_prod[index]);
-      std::vector<ParameterValue>& forward_prod_index_1(forward_prod[index-1]);
-      std::vector<ParameterValue>& backward_prod_index(backward_prod[index]);
+      const ParameterValue* prev = forwardRow( index - 1 );
+      ParameterValue* backward = backwardRow( index );
+      forward = forwardRow( index );
+      if ( dense ) {
+	transitionSum( prev, forward, true );
+      }
+      else {
+	for ( size_t state = 0; state < num_states; ++state ) {
+	  forward[state].accumulate(prev, transition.prevBegin(state), transition.prevEnd(state));
+	}
+      }
       for ( size_t state = 0; state < num_states; ++state ) {
-	forward_prod_index[state].accumulate(forward_prod_index_1, transition.prevStates(state));
-	forward_prod_index[state] *= backward_prod_index[state];
+	forward[state] *= backward[state];
       }
-      log_scale += log(ParameterValue::scale_weight(forward_prod[index], backward_prod_index));
+      log_scale += ParameterValue::scale_weight(forward, backward, num_states);
     }
-    sum_forward = forward_prod[crf_length-1][end_state];
-
+    sum_forward = forwardRow( crf_length - 1 )[end_state];
 
+    ParameterValue* backward = backwardRow( crf_length - 1 );
     for ( size_t state = 0; state < num_states; ++state ) {
       if ( state != end_state ) {
-	backward_prod[crf_length-1][state].initAlpha(0);
+	backward[state].initAlpha(0);
       }
     }
     ParameterValue tmp;
     for ( int s_index = crf_length-2; s_index >= 0; --s_index ) {
       size_t index = s_index;
-      std::vector<ParameterValue>& forward_prod_index(forward_prod[index]);
-      std::vector<ParameterValue>& backward_prod_index(backward_prod[index]);
-      std::vector<ParameterValue>& backward_prod_index_1(backward_prod[index+1]);
-      std::vector<ParameterValue>& state_weight_index(state_weight[index]);
+      const ParameterValue* next = backwardRow( index + 1 );
+      ParameterValue* weight = weightRow( index );
+      forward = forwardRow( index );
+      backward = backwardRow( index );
+      if ( dense ) {
+	transitionSum( next, &next_sum[ 0 ], false );
+      }
       for ( size_t state = 0; state < num_states; ++state ) {
-	tmp.accumulate(backward_prod_index_1, transition.nextStates(state));
-	backward_prod_index[state] *= tmp;
+	if ( dense ) {
+	  tmp = next_sum[state];
+	}
+	else {
+	  tmp.accumulate(next, transition.nextBegin(state), transition.nextEnd(state));
+	}
+	backward[state] *= tmp;
 
-	tmp = quotient(product(forward_prod_index[state], tmp),
+	tmp = quotient(product(forward[state], tmp),
 		       sum_forward);
-	const std::vector<FeatureID>& emission(transition.out(state));
-	for ( std::vector<FeatureID>::const_iterator it = emission.begin();
-	      it != emission.end();
-	      ++ it ) {
-	  state_weight_index[*it] += tmp;
-	}
+	ParameterValue::addEach(weight, transition.outBegin(state), transition.outEnd(state), tmp);
       }
     }
 
+    forward = forwardRow( crf_length - 1 );
+    backward = backwardRow( crf_length - 1 );
+    ParameterValue* weight = weightRow( crf_length - 1 );
     for ( size_t state = 0; state < num_states; ++state ) {
-      tmp = quotient(product(forward_prod[crf_length-1][state], backward_prod[crf_length-1][state]),
+      tmp = quotient(product(forward[state], backward[state]),
 		     sum_forward);
-      const std::vector<FeatureID>& emission(transition.out(state));
-      for ( std::vector<FeatureID>::const_iterator it = emission.begin();
-	    it != emission.end();
-	    ++ it ) {
-	state_weight[crf_length-1][*it] += tmp;
-      }
+      ParameterValue::addEach(weight, transition.outBegin(state), transition.outEnd(state), tmp);
     }
-    //ParameterValue sum_backward = backward_prod[0][start_state];
-    //std::cerr << "forward/backward = " << sum_forward.getAlpha() << "/" << sum_backward.getAlpha() << std::endl;
     return log_scale;
   }
 
@@ -185,14 +223,20 @@ public:
     return sum_forward;
   }
 
-  const std::vector<ParameterValue>& targetWeight(size_t index) const
+  /// Expectations of the targets at a position, num_targets values
+  const ParameterValue* targetWeight(size_t index) const
   {
-    return state_weight[index];
+    return &state_weight[index * num_targets];
   }
 };
 
 
 
+/**
+ * The path of the largest product of an event, found with the same
+ * layout and transitions as CRFTable.
+ */
+
 template < class Feature, class ParameterValue, bool ReferenceProbability = false >
 class CRFViterbi {
 public:
@@ -206,101 +250,122 @@ private:
   size_t max_length;
   size_t num_targets;
   size_t num_states;
-  std::vector< std::vector< ParameterValue > > state_weight;
-  std::vector< std::vector< ParameterValue > > forward_max;
-  std::vector< std::vector< size_t > > backward_pointer;
+  // max_length x num_targets and max_length x num_states matrices
+  std::vector< ParameterValue > state_weight;
+  std::vector< ParameterValue > forward_max;
+  std::vector< size_t > backward_pointer;
   ParameterValue max_product;
   size_t crf_length;
   std::pair<size_t, size_t> start_state;
   std::pair<size_t, size_t> end_state;
-  //std::vector< Real > sum_reference;
+  // work area of the dense transitions
+  std::vector< Real > linear_row;
+
+  ParameterValue* weightRow( size_t index ) { return &state_weight[ index * num_targets ]; }
+  ParameterValue* forwardRow( size_t index ) { return &forward_max[ index * num_states ]; }
+  size_t* pointerRow( size_t index ) { return &backward_pointer[ index * num_states ]; }
+
+  void allocate( size_t length )
+  {
+    if ( length <= max_length ) return;
+    max_length = length;
+    state_weight.resize( max_length * num_targets );
+    forward_max.resize( max_length * num_states );
+    backward_pointer.resize( max_length * num_states );
+  }
 
 public:
   /// Constructor
   CRFViterbi(const FixedTarget& ft, const CRFTransition& crf)
-    : fixed_target(ft), transition(crf)
+    : fixed_target(ft), transition(crf), max_length(0), crf_length(0)
   {
     num_targets = fixed_target.numTargets();
     num_states = transition.numStates();
+    linear_row.resize(num_states);
   }
   /// Destructor
   ~CRFViterbi() {}
 
 public:
-  /// Initialize the tree of the size _id_ with alpha sets of the size _freq_
-  /// Set the products of alpha values to the tree
+  /// Find the path of the largest product
   void setPath( const ParameterSpace<ParameterValue>& parameterspace,
 		const EventCRF< Feature, ReferenceProbability >& event_crf )
   {
-    //std::cerr << "start setProduct" << std::endl;
-    //event_crf.getTransition().debugInfo(std::cerr);
-
     crf_length = event_crf.length();
     if ( crf_length == 0 ) return;
-    if ( crf_length >= forward_max.size() ) {
-      state_weight.resize(crf_length, std::vector<ParameterValue>(num_targets));
-      forward_max.resize(crf_length, std::vector<ParameterValue>(num_states));
-      backward_pointer.resize(crf_length, std::vector<size_t>(num_states));
-    }
-    
+    allocate( crf_length );
+    bool dense = transition.hasDenseTransitions() && ParameterValue::denseTransition();
+
     start_state = std::pair<size_t, size_t>(0, event_crf.observedEventIDs().front());
     end_state = std::pair<size_t, size_t>(crf_length-1, event_crf.observedEventIDs().back());
 
     for ( size_t index = 0; index < crf_length; ++index ) {
+      ParameterValue* forward = forwardRow( index );
+      size_t* pointer = pointerRow( index );
+      ParameterValue* weight = weightRow( index );
       for ( size_t state = 0; state < num_states; ++state ) {
-	forward_max[index][state].initAlpha(0.0);
-	backward_pointer[index][state] = 0;
+	forward[state].initAlpha(0.0);
+	pointer[state] = 0;
       }
       for ( size_t target = 0; target < num_targets; ++target ) {
-	state_weight[index][target].initAlpha(1.0);
+	weight[target].initAlpha(1.0);
       }
-    }
-
-
-    for ( size_t index = 0; index < crf_length; ++index ) {
       const std::vector<Feature>& hist_list  = event_crf.getHistoryList()[index];
       for( typename std::vector<Feature>::const_iterator itr = hist_list.begin();
 	   itr != hist_list.end();
 	   ++itr ) {
 	FeatureID hid = itr->id();
 	typename Feature::FeatureFreq freq = itr->freq();
-	const std::vector< std::pair<FeatureID, FeatureID> >& fv =
+	FixedTarget::FeatureRange fv =
 	  fixed_target.getFeatures( hid );
-	ParameterValue::exponent_fix( parameterspace.getParameters(), fv, freq, state_weight[index]);
+	ParameterValue::exponent_fix( parameterspace.getParameters(), fv, freq, weight);
       }
     }
 
-    forward_max[0][start_state.second].initAlpha(1.0);
-    const std::vector<FeatureID>& initial_targets(transition.out(start_state.second));
-    for ( std::vector<FeatureID>::const_iterator tt = initial_targets.begin();
-	  tt != initial_targets.end();
+    ParameterValue* forward = forwardRow( 0 );
+    ParameterValue* weight = weightRow( 0 );
+    forward[start_state.second].initAlpha(1.0);
+    for ( const FeatureID* tt = transition.outBegin( start_state.second );
+	  tt != transition.outEnd( start_state.second );
 	  ++tt ) {
-      forward_max[0][start_state.second] *= state_weight[0][*tt];
+      forward[start_state.second] *= weight[*tt];
     }
-    
+    // only the path matters, so the products are scaled without a record
+    ParameterValue::scale_weight( forward, NULL, num_states );
+
     for ( size_t index = 1; index < crf_length; ++index ) {
+      const ParameterValue* prev = forwardRow( index - 1 );
+      forward = forwardRow( index );
+      weight = weightRow( index );
+      size_t* pointer = pointerRow( index );
+      Real shift = 0.0;
+      const Real* lx = dense ? ParameterValue::linearRow( prev, num_states, &linear_row[ 0 ], shift ) : NULL;
       for ( size_t state = 0; state < num_states; ++state ) {
-	const std::vector<FeatureID>& prev(transition.prevStates(state));
 	size_t max_id = 0;
-	for ( std::vector<FeatureID>::const_iterator it = prev.begin();
-	      it != prev.end();
-	      ++it ) {
-	  if ( forward_max[index-1][*it].getValue() > forward_max[index][state].getValue() ) {
-	    max_id = *it;
-	    forward_max[index][state] = forward_max[index-1][*it];
+	if ( dense ) {
+	  Real best = 0.0;
+	  size_t id = DenseKernel::maxProduct( transition.forwardMatrix() + state * num_states, lx, num_states, best );
+	  if ( id < num_states ) {
+	    max_id = id;
+	    forward[state].initLinear( best, shift );
+	  }
+	}
+	else {
+	  for ( const FeatureID* it = transition.prevBegin( state ); it != transition.prevEnd( state ); ++it ) {
+	    if ( prev[*it].getValue() > forward[state].getValue() ) {
+	      max_id = *it;
+	      forward[state] = prev[*it];
+	    }
 	  }
 	}
-	const std::vector<FeatureID>& targets(transition.out(state));
-	for ( std::vector<FeatureID>::const_iterator tt = targets.begin();
-	      tt != targets.end();
-	      ++tt ) {
-	  forward_max[index][state] *= state_weight[index][*tt];
+	for ( const FeatureID* tt = transition.outBegin( state ); tt != transition.outEnd( state ); ++tt ) {
+	  forward[state] *= weight[*tt];
 	}
-	backward_pointer[index][state] = max_id;
+	pointer[state] = max_id;
       }
+      ParameterValue::scale_weight( forward, NULL, num_states );
     }
-    max_product = forward_max[crf_length-1][end_state.second];
-    //std::cerr << "max = " << max_product.getValue() << std::endl;
+    max_product = forwardRow( crf_length - 1 )[end_state.second];
   }
 
   const ParameterValue& maxProduct() const {
@@ -322,9 +387,8 @@ public:
     if ( ret.first == 0 ) {
       throw WeightAccumulatorError("should not happen, CRFViterbi::next");
     }
-    //    std::cerr << "ret " << ret.first << ", " << ret.second << std::endl;
 
-    ret.second = backward_pointer[ret.first][ret.second];
+    ret.second = pointerRow( ret.first )[ret.second];
     --ret.first;
   }
 };
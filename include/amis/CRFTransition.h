@@ -15,6 +15,7 @@
 
 #include <amis/configure.h>
 #include <amis/Feature.h>
+#include <amis/Real.h>
 #include <amis/ErrorBase.h>
 #include <vector>
 #include <map>
@@ -52,6 +53,31 @@ private:
   RelTable next_state;
   RelTable prev_state;
 
+  // Compressed rows of prev_state, next_state and out_table, made by compile()
+  std::vector< FeatureID > prev_offset;
+  std::vector< FeatureID > prev_list;
+  std::vector< FeatureID > next_offset;
+  std::vector< FeatureID > next_list;
+  std::vector< FeatureID > out_offset;
+  std::vector< FeatureID > out_list;
+  // num_states x num_states matrices of 0/1; empty unless compiled densely
+  std::vector< Real > forward_matrix;   // [ cur * num_states + prev ]
+  std::vector< Real > backward_matrix;  // [ cur * num_states + next ]
+
+  static void compileRows( const RelTable& table, std::vector< FeatureID >& offset, std::vector< FeatureID >& list )
+  {
+    offset.assign( 1, 0 );
+    list.clear();
+    for ( RelTable::const_iterator it = table.begin(); it != table.end(); ++it ) {
+      list.insert( list.end(), it->begin(), it->end() );
+      offset.push_back( list.size() );
+    }
+  }
+  static const FeatureID* rowBase( const std::vector< FeatureID >& list )
+  {
+    return list.empty() ? NULL : &list[ 0 ];
+  }
+
 public:
   CRFTransition(const FixedTarget& ft)
     : fixed_target(ft)
@@ -69,6 +95,7 @@ public:
     next_state.clear();
     prev_state.clear();
     num_states = 0;
+    clearCompiled();
   }
 
   FeatureID numStates() const
@@ -83,6 +110,7 @@ public:
     transition_table.clear();
     next_state.clear();
     prev_state.clear();
+    clearCompiled();
   }
   
   void finalize()
@@ -203,6 +231,71 @@ public:
   {
     return transition_table[cur][next];
   }
+
+  /// Ratio of the pairs of states that have a transition
+  double density() const
+  {
+    if ( num_states == 0 ) return 0.0;
+    size_t num_paths = 0;
+    for ( RelTable::const_iterator it = next_state.begin(); it != next_state.end(); ++it ) {
+      num_paths += it->size();
+    }
+    return static_cast< double >( num_paths ) / num_states / num_states;
+  }
+
+  /// Make the compressed rows of the transitions and the targets, and
+  /// also the transition matrices if _dense_; must be called after all
+  /// the paths and targets are added
+  void compile( bool dense )
+  {
+    compileRows( prev_state, prev_offset, prev_list );
+    compileRows( next_state, next_offset, next_list );
+    compileRows( out_table, out_offset, out_list );
+    forward_matrix.clear();
+    backward_matrix.clear();
+    if ( dense ) {
+      forward_matrix.resize( static_cast< size_t >( num_states ) * num_states, 0.0 );
+      backward_matrix.resize( static_cast< size_t >( num_states ) * num_states, 0.0 );
+      for ( FeatureID cur = 0; cur < num_states; ++cur ) {
+	for ( std::vector< FeatureID >::const_iterator it = next_state[ cur ].begin();
+	      it != next_state[ cur ].end();
+	      ++it ) {
+	  forward_matrix[ static_cast< size_t >( *it ) * num_states + cur ] = 1.0;
+	  backward_matrix[ static_cast< size_t >( cur ) * num_states + *it ] = 1.0;
+	}
+      }
+    }
+  }
+
+  void clearCompiled()
+  {
+    prev_offset.clear();
+    prev_list.clear();
+    next_offset.clear();
+    next_list.clear();
+    out_offset.clear();
+    out_list.clear();
+    forward_matrix.clear();
+    backward_matrix.clear();
+  }
+
+  /// Whether the transition matrices are made
+  bool hasDenseTransitions() const
+  {
+    return ! forward_matrix.empty();
+  }
+
+  /// Compressed rows; valid after compile()
+  const FeatureID* prevBegin(FeatureID cur) const { return rowBase( prev_list ) + prev_offset[ cur ]; }
+  const FeatureID* prevEnd(FeatureID cur) const { return rowBase( prev_list ) + prev_offset[ cur + 1 ]; }
+  const FeatureID* nextBegin(FeatureID cur) const { return rowBase( next_list ) + next_offset[ cur ]; }
+  const FeatureID* nextEnd(FeatureID cur) const { return rowBase( next_list ) + next_offset[ cur + 1 ]; }
+  const FeatureID* outBegin(FeatureID cur) const { return rowBase( out_list ) + out_offset[ cur ]; }
+  const FeatureID* outEnd(FeatureID cur) const { return rowBase( out_list ) + out_offset[ cur + 1 ]; }
+
+  /// Transition matrices; valid if hasDenseTransitions()
+  const Real* forwardMatrix() const { return &forward_matrix[ 0 ]; }
+  const Real* backwardMatrix() const { return &backward_matrix[ 0 ]; }
   
   FeatureID newState()  { return num_states++; }
   
@@ -259,6 +352,27 @@ public:
     }
     }*/
   
+  /// Write the states, the transitions and the targets of the states,
+  /// which event caches record (see EventReader::cacheSignature)
+  void writeSignature( std::ostream& os ) const
+  {
+    for ( FeatureID i = 0; i < num_states; ++i ) {
+      os << stateName(i) << " ->";
+      for ( std::vector<FeatureID>::const_iterator jt = next_state[i].begin();
+	    jt != next_state[i].end();
+	    ++jt ) {
+	os << ' ' << *jt;
+      }
+      os << " :";
+      for ( std::vector<FeatureID>::const_iterator jt = out_table[i].begin();
+	    jt != out_table[i].end();
+	    ++jt ) {
+	os << ' ' << *jt;
+      }
+      os << '\n';
+    }
+  }
+
   public:
   // Debugging
   void debugInfo( std::ostream& ostr ) const
@@ -43,6 +43,31 @@ public:
     : fixed_target(ft), transition(crf), crf_table(ft, crf), crf_viterbi(ft, crf)
   { }
 
+  WeightAccumulator* clone() const
+  {
+    return new CRFWeightAccumulator<Feature, ParameterValue, ReferenceProbability>(fixed_target, transition);
+  }
+
+  void collectFeatures(const EventBase& event_base,
+		       std::vector<FeatureID>& features) const
+  {
+    const EventType& crf =
+      dynamic_cast<const EventType&>(event_base);
+    for ( size_t i = 0; i < crf.length(); ++i ) {
+      const std::vector< Feature >& history_list = crf.getHistoryList()[i];
+      for ( typename std::vector< Feature >::const_iterator h_it = history_list.begin();
+	    h_it != history_list.end();
+	    ++h_it ) {
+	FixedTarget::FeatureRange fv = fixed_target.getFeatures(h_it->id());
+	for ( FixedTarget::FeatureRange::const_iterator tf_it = fv.begin();
+	      tf_it != fv.end();
+	      ++tf_it ) {
+	  features.push_back(tf_it->second);
+	}
+      }
+    }
+  }
+
   void empiricalCount(std::vector<Real>& ee,
 		      const EventBase& event_base,
 		      Real event_empirical_expectation)
@@ -63,15 +88,34 @@ public:
 		  Real event_empirical_expectation,
 		  const ModelBase& model)
   {
-    const EventType& crf =
-      dynamic_cast<const EventType&>(event_base);
-    const ParameterSpace<ParameterValue>* parameterspace =
-      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace());
+    return modelCount(me,
+		      dynamic_cast<const EventType&>(event_base),
+		      event_empirical_expectation,
+		      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace()));
+  }
+
+  Real modelCountRange(std::vector<Real>& me,
+		       const EventBase* const* events,
+		       size_t num_events,
+		       Real event_empirical_expectation,
+		       const ModelBase& model)
+  {
+    return modelCountEach<EventType, ParameterValue>(*this, me, events, num_events,
+						     event_empirical_expectation, model);
+  }
+
+  /// Model expectation of an event of the concrete type
+  Real modelCount(std::vector<Real>& me,
+		  const EventType& crf,
+		  Real event_empirical_expectation,
+		  const ParameterSpace<ParameterValue>* parameterspace)
+  {
     
     Real log_scale = crf_table.setProduct( *parameterspace, crf );
     ParameterValue inv_sum = crf_table.sumProduct();
 
-    if ( !finite( inv_sum.getValue() ) ) {
+    // a sum of zero leaves no path to normalize over
+    if ( !finite( inv_sum.getLambda() ) || !finite( log_scale ) ) {
       this->incIgnored();
       //OStringStream oss;
       //oss << "IN: " << __PRETTY_FUNCTION__ << "sum is not finite (" << inv_sum.getValue() << "). this should not occur";
@@ -85,14 +129,14 @@ public:
 
     AMIS_DEBUG_MESSAGE( 5, "\t\tSet model expectations for features\n" );
     for ( size_t i = 0; i < crf.length(); ++i ) {
-      const std::vector<ParameterValue>& weights = crf_table.targetWeight(i);
+      const ParameterValue* weights = crf_table.targetWeight(i);
       const std::vector< Feature >& history_list = crf.getHistoryList()[i];
       for ( typename std::vector< Feature >::const_iterator h_it = history_list.begin();
 	    h_it != history_list.end();
 	    ++h_it ) {
 	Real fb_product = denom * h_it->freq();
-	const std::vector< std::pair<FeatureID, FeatureID> >& fv = fixed_target.getFeatures(h_it->id());
-	for ( std::vector< std::pair<FeatureID, FeatureID> >::const_iterator tf_it = fv.begin();
+	FixedTarget::FeatureRange fv = fixed_target.getFeatures(h_it->id());
+	for ( FixedTarget::FeatureRange::const_iterator tf_it = fv.begin();
 	      tf_it != fv.end();
 	      ++tf_it ) {
 	  me[tf_it->second] += weights[tf_it->first].getAlpha() * fb_product;
@@ -106,6 +150,7 @@ public:
 	  ++fit ) {
       lp += parameterspace->getParameter( fit->id() ).getLambda() * fit->freq();
     }
+    // log Z is the log of the scaled sum plus the log of the scale
     lp += (inv_sum.getLambda()-log_scale);
     if ( ReferenceProbability ) {
       assert(false);
@@ -129,7 +174,7 @@ public:
     ParameterValue max = crf_viterbi.maxProduct();
 
     //std::cerr << "max = " << max.getValue() << std::endl;
-    if ( !finite( max.getValue() ) ) {
+    if ( !finite( max.getLambda() ) ) {
       this->incIgnored();
       //OStringStream oss;
       //oss << "IN: " << __PRETTY_FUNCTION__ << "sum is not finite (" << max.getValue() << "). this should not occur";
@@ -147,12 +192,12 @@ public:
       for ( typename std::vector< Feature >::const_iterator h_it = history_list.begin();
 	    h_it != history_list.end();
 	    ++h_it ) {
-	const std::vector< std::pair<FeatureID, FeatureID> >& fv = fixed_target.getFeatures(h_it->id());
-	for ( std::vector< std::pair<FeatureID, FeatureID> >::const_iterator tf_it = fv.begin();
+	FixedTarget::FeatureRange fv = fixed_target.getFeatures(h_it->id());
+	for ( FixedTarget::FeatureRange::const_iterator tf_it = fv.begin();
 	      tf_it != fv.end();
 	      ++tf_it ) {
-	  const std::vector<FeatureID>& targets = transition.out(it.second);
-	  if ( std::find(targets.begin(), targets.end(), tf_it->first) != targets.end() ) {
+	  const FeatureID* targets_end = transition.outEnd(it.second);
+	  if ( std::find(transition.outBegin(it.second), targets_end, tf_it->first) != targets_end ) {
 	    Real incr = -h_it->freq() * crf.eventFrequency() * step_size;
 	    model.incLambda(tf_it->second, incr);
 	    history[tf_it->second] += static_cast<double>(iteration) * incr;
@@ -0,0 +1,144 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_DenseKernel_h_
+
+#define Amis_DenseKernel_h_
+
+#include <amis/configure.h>
+#include <amis/Real.h>
+#include <amis/SparseKernel.h>
+
+AMIS_NAMESPACE_BEGIN
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Kernels over a dense square matrix and a dense vector, used for the
+ * transitions of CRFTable.
+ *
+ * product() computes the matrix-vector product, and maxProduct() the
+ * largest element-wise product of a row and a vector.  Matrices are
+ * stored row by row.  The instruction set is the one chosen by
+ * SparseKernel::level(); the vector loops add the terms in a different
+ * order from the scalar loop, so results may differ in the last bits.
+ */
+
+class DenseKernel {
+public:
+  /// Rows shorter than this are processed by the scalar loop
+  static const size_t MIN_VECTOR_LENGTH = 8;
+
+private:
+#ifdef AMIS_SIMD_X86
+  __attribute__(( target( "avx2,fma" ) ))
+  static void productAVX2( const double* m, const double* x, double* y, size_t n ) {
+    for ( size_t i = 0; i < n; ++i, m += n ) {
+      __m256d acc0 = _mm256_setzero_pd();
+      __m256d acc1 = _mm256_setzero_pd();
+      size_t j = 0;
+      for ( ; j + 8 <= n; j += 8 ) {
+        acc0 = _mm256_fmadd_pd( _mm256_loadu_pd( m + j ), _mm256_loadu_pd( x + j ), acc0 );
+        acc1 = _mm256_fmadd_pd( _mm256_loadu_pd( m + j + 4 ), _mm256_loadu_pd( x + j + 4 ), acc1 );
+      }
+      if ( j + 4 <= n ) {
+        acc0 = _mm256_fmadd_pd( _mm256_loadu_pd( m + j ), _mm256_loadu_pd( x + j ), acc0 );
+        j += 4;
+      }
+      acc0 = _mm256_add_pd( acc0, acc1 );
+      __m128d s = _mm_add_pd( _mm256_castpd256_pd128( acc0 ), _mm256_extractf128_pd( acc0, 1 ) );
+      double sum = _mm_cvtsd_f64( _mm_add_sd( s, _mm_unpackhi_pd( s, s ) ) );
+      for ( ; j < n; ++j ) sum += m[ j ] * x[ j ];
+      y[ i ] = sum;
+    }
+  }
+
+  __attribute__(( target( "avx2,fma" ) ))
+  static size_t maxProductAVX2( const double* m, const double* x, size_t n, double& best ) {
+    // the first index of the largest value in each lane
+    __m256d value = _mm256_set1_pd( best );
+    __m256d index = _mm256_set1_pd( static_cast< double >( n ) );
+    __m256d cur = _mm256_setr_pd( 0.0, 1.0, 2.0, 3.0 );
+    const __m256d step = _mm256_set1_pd( 4.0 );
+    size_t j = 0;
+    for ( ; j + 4 <= n; j += 4 ) {
+      __m256d v = _mm256_mul_pd( _mm256_loadu_pd( m + j ), _mm256_loadu_pd( x + j ) );
+      __m256d gt = _mm256_cmp_pd( v, value, _CMP_GT_OQ );
+      value = _mm256_blendv_pd( value, v, gt );
+      index = _mm256_blendv_pd( index, cur, gt );
+      cur = _mm256_add_pd( cur, step );
+    }
+    double lane_value[ 4 ], lane_index[ 4 ];
+    _mm256_storeu_pd( lane_value, value );
+    _mm256_storeu_pd( lane_index, index );
+    size_t arg = n;
+    for ( int k = 0; k < 4; ++k ) {
+      size_t l = static_cast< size_t >( lane_index[ k ] );
+      if ( l == n ) continue;
+      if ( lane_value[ k ] > best || ( lane_value[ k ] == best && l < arg ) ) {
+        best = lane_value[ k ];
+        arg = l;
+      }
+    }
+    for ( ; j < n; ++j ) {
+      double v = m[ j ] * x[ j ];
+      if ( v > best ) {
+        best = v;
+        arg = j;
+      }
+    }
+    return arg;
+  }
+#endif // AMIS_SIMD_X86
+
+public:
+  /// y[ i ] = sum( m[ i * n + j ] * x[ j ] ) for i in [0, n)
+  static void product( const Real* m, const Real* x, Real* y, size_t n ) {
+#ifdef AMIS_SIMD_X86
+    if ( n >= MIN_VECTOR_LENGTH && SparseKernel::level() != SparseKernel::SCALAR ) {
+      productAVX2( m, x, y, n );
+      return;
+    }
+#endif // AMIS_SIMD_X86
+    for ( size_t i = 0; i < n; ++i, m += n ) {
+      Real sum = 0.0;
+      for ( size_t j = 0; j < n; ++j ) {
+        sum += m[ j ] * x[ j ];
+      }
+      y[ i ] = sum;
+    }
+  }
+
+  /// The first j in [0, n) whose m[ j ] * x[ j ] is the largest and is
+  /// above best, which is then set to it; n if there is no such j
+  static size_t maxProduct( const Real* m, const Real* x, size_t n, Real& best ) {
+#ifdef AMIS_SIMD_X86
+    if ( n >= MIN_VECTOR_LENGTH && SparseKernel::level() != SparseKernel::SCALAR ) {
+      return maxProductAVX2( m, x, n, best );
+    }
+#endif // AMIS_SIMD_X86
+    size_t arg = n;
+    for ( size_t j = 0; j < n; ++j ) {
+      Real v = m[ j ] * x[ j ];
+      if ( v > best ) {
+        best = v;
+        arg = j;
+      }
+    }
+    return arg;
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_DenseKernel_h_
+// end of DenseKernel.h
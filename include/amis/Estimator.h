@@ -82,6 +82,8 @@ protected:
   bool till_convergence;
   /// Whether to show messages
   bool suppress_message;
+  /// Whether to sum up expectations in a thread-independent order
+  bool deterministic_reduction;
 
   /// Timer to measure the estimation time
   ProfTimer profile_timer;
@@ -155,6 +157,10 @@ public:
   bool suppressMessage() { return suppress_message; }
   /// Let the estimator to suppress profiling messages
   void setSuppressMessage( bool t = true ) { suppress_message = t; }
+  /// Whether expectations are reduced deterministically
+  bool deterministicReduction() { return deterministic_reduction; }
+  /// Let the estimator to reduce expectations independently of the number of threads
+  void setDeterministicReduction( bool t = true ) { deterministic_reduction = t; }
 
   /// Get the timer measuring estimation time
   const ProfTimer& getEstimationTimer() { return profile_timer; }
@@ -27,6 +27,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <new>
 
 AMIS_NAMESPACE_BEGIN
 
@@ -37,6 +38,9 @@ AMIS_NAMESPACE_BEGIN
 /// <overview>An event</overview>
 /// <desc>
 /// This class describes an event object.
+/// Feature lists are read from a range of FeatureList objects, which
+/// is the event's own vector while the event is built, or a run in an
+/// EventArena for an event made by compactInto().
 /// </desc>
 /// <body>
 
@@ -49,53 +53,94 @@ public:
   //typedef FeatureList< Feature >* iterator;
   //typedef const FeatureList< Feature >* const_iterator;
 
-  typedef typename std::vector< FeatureList<Feature> >::iterator iterator;
-  typedef typename std::vector< FeatureList<Feature> >::const_iterator const_iterator;
-  typedef typename std::vector< FeatureList<Feature> >::size_type size_type;
+  typedef FeatureList<Feature>* iterator;
+  typedef const FeatureList<Feature>* const_iterator;
+  typedef size_t size_type;
   
  
   iterator begin() {
-    return feature_lists.begin();
+    return list_head;
   }
   
   const_iterator begin() const {
-    return feature_lists.begin();
+    return list_head;
   }
   
   
   iterator end() {
-    return feature_lists.end();
+    return list_tail;
   }
   
   
   const_iterator end() const {
-    return feature_lists.end();
+    return list_tail;
   }
 
 private:
   std::vector< FeatureList< Feature > > feature_lists;
+  FeatureList< Feature >* list_head;
+  FeatureList< Feature >* list_tail;
   int active_id;
   static const int NULL_ACTIVE_ID = -1;
 
+  void referOwnLists() {
+    list_head = feature_lists.empty() ? NULL : &feature_lists[ 0 ];
+    list_tail = list_head + feature_lists.size();
+  }
+
 public:
   Event() {
     freq_count = 0;
     active_id = NULL_ACTIVE_ID;
+    list_head = list_tail = NULL;
+  }
+
+  Event( const Event< Feature, ReferenceProbability >& event )
+    : EventBase( event ), feature_lists( event.begin(), event.end() ), active_id( event.active_id ) {
+    referOwnLists();
   }
 
   ~Event() {}
 
+  Event< Feature, ReferenceProbability >& operator=( const Event< Feature, ReferenceProbability >& event ) {
+    if ( this != &event ) {
+      freq_count = event.freq_count;
+      feature_lists.assign( event.begin(), event.end() );
+      active_id = event.active_id;
+      referOwnLists();
+    }
+    return *this;
+  }
+
   void clear() {
     freq_count = 0;
     active_id = NULL_ACTIVE_ID;
     feature_lists.resize( 0 );
+    referOwnLists();
   }
   
   void swap( Event< Feature, ReferenceProbability >& event ) {
     std::swap( freq_count, event.freq_count );
     feature_lists.swap( event.feature_lists );
+    std::swap( list_head, event.list_head );
+    std::swap( list_tail, event.list_tail );
     std::swap( active_id, event.active_id );
   }
+
+  EventBase* compactInto( EventArena& arena ) const {
+    Event< Feature, ReferenceProbability >* event =
+      new ( arena.allocate< Event< Feature, ReferenceProbability > >() ) Event< Feature, ReferenceProbability >();
+    event->freq_count = freq_count;
+    event->active_id = active_id;
+    FeatureList< Feature >* lists = arena.allocate< FeatureList< Feature > >( size() );
+    for ( size_t i = 0; i < size(); ++i ) {
+      new ( lists + i ) FeatureList< Feature >();
+      lists[ i ].copyToArena( list_head[ i ], arena );
+    }
+    event->list_head = lists;
+    event->list_tail = lists + size();
+    return event;
+  }
   
   
   void addFeatureList( const std::vector< Feature >& vec, int f ) {
@@ -111,10 +156,11 @@ public:
     else {
       throw IllegalEventError( "Event frequency must be positive" );
     }
+    referOwnLists();
   }
 
   const FeatureList< Feature >& observedEvent() const {
-    return feature_lists[ active_id ];
+    return list_head[ active_id ];
   }
   
   int observedEventID() const {
@@ -122,7 +168,7 @@ public:
   }
 
   size_t size() const {
-    return feature_lists.size();
+    return list_tail - list_head;
   }
   size_t numFeatureList() const {
     return size();
@@ -132,7 +178,7 @@ public:
   }
 
   const FeatureList< Feature >& operator[]( size_t i ) const {
-    return feature_lists[ i ];
+    return list_head[ i ];
   }
 
   Real eventProbability() const {
@@ -154,6 +200,15 @@ public:
     return freq;
   }
 
+  size_t computationCost() const
+  {
+    size_t cost = 0;
+    for ( const_iterator it = begin(); it != end(); ++it ) {
+      cost += it->size() + 1;
+    }
+    return cost;
+  }
+
   bool isObserved( size_t i ) const
   {
     if ( active_id == NULL_ACTIVE_ID ) throw IllegalEventError( "Observed feature list not found" );
@@ -170,11 +225,17 @@ public:
 public:
 
   void readObject( objstream& is ) {
-    is >> freq_count;
-    size_t num_fl;
-    is >> num_fl;
-    is >> active_id;
+    readFrequency( is );
+    size_t num_fl = 0;
+    if ( is.isCompact() ) {
+      num_fl = is.readVarint();
+      active_id = static_cast< int >( is.readSignedVarint() );
+    } else {
+      is >> num_fl;
+      is >> active_id;
+    }
     feature_lists.resize( num_fl );
+    referOwnLists();
     for ( iterator it = begin();
           it != end();
           ++it ) {
@@ -183,9 +244,14 @@ public:
   }
   /// Read an object from a stream
   void writeObject( objstream& os ) const {
-    os << freq_count;
-    os << feature_lists.size();
-    os << active_id;
+    writeFrequency( os );
+    if ( os.isCompact() ) {
+      os.writeVarint( size() );
+      os.writeSignedVarint( active_id );
+    } else {
+      os << size();
+      os << active_id;
+    }
     for ( const_iterator it = begin();
           it != end();
           ++it ) {
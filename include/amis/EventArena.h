@@ -0,0 +1,126 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_EventArena_h_
+
+#define Amis_EventArena_h_
+
+#include <amis/configure.h>
+
+#include <vector>
+#include <new>
+#include <cstdlib>
+
+AMIS_NAMESPACE_BEGIN
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A grow-only memory region for events stored on memory.
+ *
+ * Objects are placed one after another in large blocks, so that the
+ * events of a data set, their feature lists and their features lie
+ * contiguously in the order of input, and are released all at once
+ * when the arena is destroyed.  Destructors of the objects placed in
+ * an arena are never called; they must not own memory elsewhere.
+ */
+
+class EventArena {
+public:
+  /// Default size of a block in bytes
+  static const size_t DEFAULT_BLOCK_SIZE = 4 * 1024 * 1024;
+  /// Alignment of allocated objects
+  static const size_t ALIGNMENT = 16;
+
+private:
+  std::vector< char* > block_list;
+  size_t block_size;
+  char* current;
+  char* limit;
+  size_t used_bytes;
+  size_t reserved_bytes;
+
+  EventArena( const EventArena& );
+  EventArena& operator=( const EventArena& );
+
+  static size_t align( size_t n ) {
+    return ( n + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT;
+  }
+
+  void newBlock( size_t n ) {
+    size_t size = n > block_size ? n : block_size;
+    char* block = static_cast< char* >( std::malloc( size ) );
+    if ( block == NULL ) throw std::bad_alloc();
+    block_list.push_back( block );
+    current = block;
+    limit = block + size;
+    reserved_bytes += size;
+  }
+
+public:
+  /// Constructor
+  explicit EventArena( size_t init_block_size = DEFAULT_BLOCK_SIZE )
+    : block_size( init_block_size ), current( NULL ), limit( NULL ),
+      used_bytes( 0 ), reserved_bytes( 0 ) {
+  }
+  /// Destructor
+  ~EventArena() {
+    clear();
+  }
+
+  /// Allocate uninitialized memory for n objects of type T
+  template < class T >
+  T* allocate( size_t n = 1 ) {
+    size_t bytes = align( n * sizeof( T ) );
+    if ( bytes == 0 ) return NULL;
+    if ( current == NULL || static_cast< size_t >( limit - current ) < bytes ) {
+      newBlock( bytes );
+    }
+    T* ret = reinterpret_cast< T* >( current );
+    current += bytes;
+    used_bytes += bytes;
+    return ret;
+  }
+
+  /// Release all the blocks
+  void clear() {
+    for ( size_t i = 0; i < block_list.size(); ++i ) {
+      std::free( block_list[ i ] );
+    }
+    block_list.clear();
+    current = limit = NULL;
+    used_bytes = reserved_bytes = 0;
+  }
+
+  /// Take over all the blocks of another arena, which becomes empty.
+  /// Objects placed in the other arena remain where they are.
+  void splice( EventArena& other ) {
+    block_list.insert( block_list.end(), other.block_list.begin(), other.block_list.end() );
+    used_bytes += other.used_bytes;
+    reserved_bytes += other.reserved_bytes;
+    other.block_list.clear();
+    other.current = other.limit = NULL;
+    other.used_bytes = other.reserved_bytes = 0;
+  }
+
+  /// Bytes given to objects
+  size_t usedBytes() const { return used_bytes; }
+  /// Bytes taken from the system
+  size_t reservedBytes() const { return reserved_bytes; }
+  /// Number of blocks
+  size_t numBlocks() const { return block_list.size(); }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_EventArena_h_
+// end of EventArena.h
@@ -23,6 +23,7 @@
 #include <amis/objstream.h>
 #include <amis/StringStream.h>
 #include <amis/Tokenizer.h>
+#include <amis/EventArena.h>
 
 #include <vector>
 #include <algorithm>
@@ -113,8 +114,37 @@ public:
 
   virtual Real maxFeatureCount() const = 0;
 
+  /// Estimated work to compute the model expectation of this event
+  virtual size_t computationCost() const {
+    return numFeatureList();
+  }
+
+  /// Make a copy of this event placed in an arena, or NULL if this
+  /// type of events cannot be placed in an arena
+  virtual EventBase* compactInto( EventArena& arena ) const {
+    return NULL;
+  }
+
   ////////////////////////////////////////////////////////////
 
+protected:
+  /// Read the event frequency in the encoding of the stream
+  void readFrequency( objstream& is ) {
+    if ( is.isCompact() ) {
+      freq_count = is.readVarint();
+    } else {
+      is >> freq_count;
+    }
+  }
+  /// Write the event frequency in the encoding of the stream
+  void writeFrequency( objstream& os ) const {
+    if ( os.isCompact() ) {
+      os.writeVarint( freq_count );
+    } else {
+      os << freq_count;
+    }
+  }
+
 public:
   virtual void readObject( objstream& is ) = 0;
 
@@ -93,7 +93,7 @@ public:
 	FeatureID   hid   = itr->id();
 	FeatureFreq freq  = itr->freq();
 	
-	const std::vector< std::pair<FeatureID, FeatureID> >& fv = fixed_target.getFeatures( hid );
+	FixedTarget::FeatureRange fv = fixed_target.getFeatures( hid );
       
 	for ( size_t k = 0; k < fv.size(); k++ ) {
 	  FeatureID tid = fv[k].first;
@@ -148,6 +148,14 @@ public:
     return ret;
   }
 
+  size_t computationCost() const {
+    size_t cost = length();
+    for ( typename std::vector<std::vector<Feature> >::const_iterator itr = history_list.begin(); itr != history_list.end(); ++itr ) {
+      cost += itr->size();
+    }
+    return cost;
+  }
+
   Real maxFeatureCount() const {
     FeatureFreq ret = 0;
     for ( typename std::vector<std::vector<Feature> >::const_iterator itr = history_list.begin(); itr != history_list.end(); ++itr ) {
@@ -162,52 +170,67 @@ public:
 public:
   void writeObject( objstream& os ) const
   {
-    os << freq_count;
+    writeFrequency( os );
     observed_list.writeObject(os);
-    os << static_cast<size_t>( active_list.size() );
-    for ( typename std::vector<FeatureID>::const_iterator it = active_list.begin();
-          it != active_list.end();
-          ++it ) {
-      os << *it;
+    if ( os.isCompact() ) {
+      os.writeVarint( active_list.size() );
+      FeatureID prev = 0;
+      for ( typename std::vector<FeatureID>::const_iterator it = active_list.begin();
+            it != active_list.end();
+            ++it ) {
+        os.writeSignedVarint( static_cast<long>( *it ) - static_cast<long>( prev ) );
+        prev = *it;
+      }
+      os.writeVarint( history_list.size() );
+      for ( typename std::vector<std::vector<Feature> >::const_iterator it = history_list.begin();
+            it != history_list.end();
+            ++it ) {
+        os.writeVarint( it->size() );
+        if ( ! it->empty() ) writeFeatures( os, &(*it)[0], it->size() );
+      }
+      return;
     }
+    os.writeArray( active_list );
     os << static_cast<size_t>( history_list.size() );
     for ( typename std::vector<std::vector<Feature> >::const_iterator it = history_list.begin();
           it != history_list.end();
           ++it ) {
-      os << static_cast<size_t>( it->size() );
-      for ( typename std::vector<Feature>::const_iterator jt = it->begin();
-	    jt != it->end();
-	    ++jt ) {
-	jt->writeObject(os);
-      }
+      os.writeArray( *it );
     }
   }
   /// Write an object into a stream
 
   void readObject( objstream& is )
   {
-    is >> freq_count;
+    readFrequency( is );
     observed_list.readObject( is );
-    size_t size;
-    is >> size;
-    active_list.resize(size);
-    for ( typename std::vector<FeatureID>::iterator it = active_list.begin();
-          it != active_list.end();
-          ++it ) {
-      is >> *it;
+    if ( is.isCompact() ) {
+      active_list.resize( is.readVarint() );
+      long prev = 0;
+      for ( typename std::vector<FeatureID>::iterator it = active_list.begin();
+            it != active_list.end();
+            ++it ) {
+        prev += is.readSignedVarint();
+        *it = static_cast<FeatureID>( prev );
+      }
+      history_list.resize( is.readVarint() );
+      for ( typename std::vector<std::vector<Feature> >::iterator it = history_list.begin();
+            it != history_list.end();
+            ++it ) {
+        it->resize( is.readVarint() );
+        if ( ! it->empty() ) readFeatures( is, &(*it)[0], it->size() );
+      }
+      return;
     }
+    is.readArray( active_list );
+    size_t size = 0;
     is >> size;
+    if ( ! is ) return;
     history_list.resize(size);
     for ( typename std::vector<std::vector<Feature> >::iterator it = history_list.begin();
           it != history_list.end();
           ++it ) {
-      is >> size;
-      it->resize(size);
-      for ( typename std::vector<Feature>::iterator jt = it->begin();
-	    jt != it->end();
-	    ++jt ) {
-	jt->readObject(is);
-      }
+      is.readArray( *it );
     }
   }
   /// Read an object from a stream
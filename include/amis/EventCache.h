@@ -0,0 +1,181 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_EventCache_h_
+
+#define Amis_EventCache_h_
+
+#include <amis/configure.h>
+#include <amis/ErrorBase.h>
+#include <amis/EventSpace.h>
+#include <amis/EventReader.h>
+#include <amis/NameTable.h>
+#include <amis/objstream.h>
+#include <amis/Profile.h>
+#include <amis/Real.h>
+
+#include <string>
+#include <vector>
+
+AMIS_NAMESPACE_BEGIN
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Notification of a broken or mismatching event cache
+ */
+
+class EventCacheError : public ErrorBase {
+public:
+  EventCacheError( const std::string& s ) : ErrorBase( s ) {}
+  /// Initialize with an error message
+  EventCacheError( const char* s ) : ErrorBase( s ) {}
+  /// Initialize with an error message
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Binary image of an event space, which can be read much faster than
+ * the text event files.
+ *
+ * A cache consists of a header (magic string, version, size of Real,
+ * the signature of the event type and the signature of the event
+ * reader, see EventReader::cacheSignature), the feature names of the
+ * name table by which the events were parsed, the number of events,
+ * and the events written by EventBase::writeObject.  A cache is
+ * accepted only when the header and the feature names match the
+ * current run, because events refer to features, targets and so on by
+ * their IDs.
+ * Arrays of features are stored as memory images, so a cache should
+ * be read by the same build of amis that wrote it.
+ * @see EventFormat, EventSpace
+ */
+
+class EventCache {
+public:
+  /// Version of the cache format
+  static const int VERSION = 4;
+
+private:
+  /// Upper bound of the length of a string, to detect broken caches
+  static const size_t MAX_STRING_SIZE = 1024 * 1024 * 1024;
+
+  EventReader* event_reader;
+  std::string signature;
+
+  static const std::string& magic() {
+    static const std::string m( "AMIS-EVENT-CACHE" );
+    return m;
+  }
+
+  static void writeString( objstream& os, const std::string& s ) {
+    os << static_cast< size_t >( s.size() );
+    os.write( s.data(), s.size() );
+  }
+  static std::string readString( objstream& is ) {
+    size_t size = 0;
+    is >> size;
+    if ( ! is || size > MAX_STRING_SIZE ) {
+      throw EventCacheError( "Broken event cache" );
+    }
+    std::vector< char > buf( size + 1 );
+    is.read( &buf[ 0 ], size );
+    return std::string( &buf[ 0 ], size );
+  }
+
+public:
+  /// Constructor
+  /// @param sig identifies the type of the events (data format,
+  /// feature type and so on); a cache is read only by a run with the
+  /// same signature
+  EventCache( EventReader* er, const std::string& sig )
+    : event_reader( er ), signature( sig )
+  { }
+  /// Destructor
+  virtual ~EventCache() { }
+
+  /// Write all the events of an event space
+  virtual void outputEventSpace( objstream& os,
+				 const NameTable& name_table,
+				 const EventSpace& event_space ) const {
+    AMIS_PROF1( "EventCache::outputEventSpace" );
+    writeString( os, magic() );
+    os << static_cast< int >( VERSION );
+    os << static_cast< int >( sizeof( Real ) );
+    writeString( os, signature );
+    writeString( os, event_reader->cacheSignature() );
+    size_t num_features = name_table.numFeatures();
+    os << num_features;
+    for ( size_t id = 0; id < num_features; ++id ) {
+      writeString( os, name_table.featureName( id ) );
+    }
+    size_t num_events = event_space.numEvents();
+    os << num_events;
+    for ( size_t i = 0; i < num_events; ++i ) {
+      event_space[ i ].writeObject( os );
+    }
+    if ( ! os ) {
+      throw EventCacheError( "Cannot write an event cache: " + os.fileName() );
+    }
+  }
+
+  /// Read the events of a cache into an event space
+  virtual void inputEventSpace( objstream& is,
+				const NameTable& name_table,
+				EventSpace& event_space ) const {
+    AMIS_PROF1( "EventCache::inputEventSpace" );
+    if ( readString( is ) != magic() ) {
+      throw EventCacheError( "Not an event cache: " + is.fileName() );
+    }
+    int version = 0;
+    int real_size = 0;
+    is >> version;
+    is >> real_size;
+    if ( version != VERSION ) {
+      throw EventCacheError( "Unsupported version of event cache: " + is.fileName() );
+    }
+    if ( real_size != static_cast< int >( sizeof( Real ) ) ) {
+      throw EventCacheError( "Event cache was made with a different Real type: " + is.fileName() );
+    }
+    if ( readString( is ) != signature ) {
+      throw EventCacheError( "Event cache was made for another type of events (" + signature + "): " + is.fileName() );
+    }
+    if ( readString( is ) != event_reader->cacheSignature() ) {
+      throw EventCacheError( "Event cache was made with different fixmaps, transitions or groups of targets: " + is.fileName() );
+    }
+    size_t num_features = 0;
+    is >> num_features;
+    if ( num_features != name_table.numFeatures() ) {
+      throw EventCacheError( "Event cache was made with a different model: " + is.fileName() );
+    }
+    for ( size_t id = 0; id < num_features; ++id ) {
+      if ( readString( is ) != name_table.featureName( id ) ) {
+	throw EventCacheError( "Event cache was made with a different model: " + is.fileName() );
+      }
+    }
+    size_t num_events = 0;
+    is >> num_events;
+    for ( size_t i = 0; i < num_events; ++i ) {
+      event_space.inputEventObject( event_reader, is );
+      if ( ! is ) {
+	throw EventCacheError( "Broken event cache: " + is.fileName() );
+      }
+    }
+    event_space.validate( event_reader );
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_EventCache_h_
+// end of EventCache.h
@@ -39,28 +39,39 @@ private:
   FeatureList<Feature>    history_list;
   FeatureList<Feature>    observed_list;
   FeatureID               active_target;
-  std::vector<Real> prob; // reference probability
+  FeatureID               restriction; // group of the targets, or UNKNOWN_FEATURE_ID for all
+  size_t                  num_targets;
+  std::vector<Real> prob; // reference probability, only with ReferenceProbability
 
 public:
   EventFix() 
   {
     freq_count  = 0;
     active_target = 0;
+    restriction = UNKNOWN_FEATURE_ID;
+    num_targets = 0;
   }
 
   virtual ~EventFix(){  }
 
   bool isValid() const { return true; }
 
-  size_t size() const { return prob.size(); }
+  size_t size() const { return num_targets; }
 
-  size_t numFeatureList() const { return prob.size(); }
+  size_t numFeatureList() const { return num_targets; }
 
+  /// The number of the targets scored for this event: all the targets,
+  /// or those of the group if the event is restricted
   size_t numTargets() const
   {
-    return prob.size();
+    return num_targets;
   }
 
+  bool isRestricted() const { return restriction != UNKNOWN_FEATURE_ID; }
+
+  /// The group of RestrictedTarget of the targets of this event
+  FeatureID restrictionID() const { return restriction; }
+
   size_t historySize() const { return history_list.size(); }
 
   FeatureID observedEventID() const { return active_target; }
@@ -74,7 +85,7 @@ public:
   }
   
   
-  void genObservedFeatureList( FixedTarget fixed_target,
+  void genObservedFeatureList( const FixedTarget& fixed_target,
 			       FeatureList<Feature>& to ) const {
 	
     const FeatureList<Feature>& hist_list  = getHistoryList();
@@ -85,7 +96,7 @@ public:
       FeatureID   hid   = itr->id();
       FeatureFreq freq  = itr->freq();
 		  
-      const std::vector< std::pair<FeatureID, FeatureID> >& fv = fixed_target.getFeatures( hid );
+      FixedTarget::FeatureRange fv = fixed_target.getFeatures( hid );
 		  
       for ( size_t k = 0; k < fv.size(); k++ ) {
 	FeatureID tid = fv[k].first;
@@ -100,21 +111,39 @@ public:
     to.copy_and_set( feature_vec, eventFrequency() );
   }
   
-  void add( FixedTarget fixed_target,
+  void add( const FixedTarget& fixed_target,
             int f,
 	    FeatureID tid,
             const FeatureList<Feature>& hl) {
     freq_count          = f;
     history_list  = hl;
     active_target = tid;
-    prob.resize( fixed_target.numTargets() );
+    restriction = UNKNOWN_FEATURE_ID;
+    num_targets = fixed_target.numTargets();
+    if ( ReferenceProbability ) prob.resize( num_targets );
     genObservedFeatureList( fixed_target, observed_list );
   }
 
+  /// Same as add(), but only the targets of a group are scored; tid
+  /// must be in the group
+  void add( const FixedTarget& fixed_target,
+            const RestrictedTarget& restricted_target,
+            int f,
+	    FeatureID tid,
+	    FeatureID gid,
+            const FeatureList<Feature>& hl) {
+    add( fixed_target, f, tid, hl );
+    restriction = gid;
+    num_targets = restricted_target.numTargets( gid );
+    if ( ReferenceProbability ) prob.resize( num_targets );
+  }
+
   Real eventProbability() const {
     return 1.0;
   }
 
+  /// Reference probability of the i-th target of this event (the i-th
+  /// target of the group if the event is restricted)
   Real referenceProbability( size_t i ) const {
     return prob[ i ];
   }
@@ -123,6 +152,11 @@ public:
     return history_list.featureCount();
   }
 
+  size_t computationCost() const {
+    // every history is scattered over the targets
+    return ( history_list.size() + 1 ) * numTargets();
+  }
+
   Real maxFeatureCount( void ) const {
     return history_list.featureCount();
   }
@@ -131,32 +165,47 @@ public:
 
 public:
   void readObject( objstream& is ) {
-    is >> freq_count;
+    readFrequency( is );
+    if ( is.isCompact() ) {
+      active_target = static_cast< FeatureID >( is.readVarint() );
+      // groups are written plus one, so that 0 means all the targets
+      restriction = static_cast< FeatureID >( is.readVarint() ) - 1;
+      history_list.readObject( is );
+      observed_list.readObject( is );
+      // probabilities are written only with reference distributions
+      num_targets = is.readVarint();
+      if ( ReferenceProbability ) {
+        prob.resize( num_targets );
+        if ( num_targets > 0 ) is.readBlock( &prob[ 0 ], num_targets );
+      }
+      return;
+    }
     is >> active_target;
+    is >> restriction;
+    is >> num_targets;
     history_list.readObject( is );
     observed_list.readObject( is );
-    size_t num_targets = 0;
-    is >> num_targets;
-    prob.resize( num_targets );
-    for ( std::vector< Real >::iterator it = prob.begin();
-	  it != prob.end();
-	  ++it ) {
-      is >> *it;
-    }
+    is.readArray( prob );
   }
   /// Read an object from a stream
 
   void writeObject( objstream& os ) const {
-    os << freq_count;
+    writeFrequency( os );
+    if ( os.isCompact() ) {
+      os.writeVarint( active_target );
+      os.writeVarint( static_cast< FeatureID >( restriction + 1 ) );
+      history_list.writeObject( os );
+      observed_list.writeObject( os );
+      os.writeVarint( num_targets );
+      if ( ReferenceProbability && ! prob.empty() ) os.writeBlock( &prob[ 0 ], prob.size() );
+      return;
+    }
     os << active_target;
+    os << restriction;
+    os << num_targets;
     history_list.writeObject( os );
     observed_list.writeObject( os );
-    os << prob.size();
-    for ( std::vector< Real >::const_iterator it = prob.begin();
-	  it != prob.end();
-	  ++it ) {
-      os << *it;
-    }
+    os.writeArray( prob );
   }
   /// Write an object into a stream
 };
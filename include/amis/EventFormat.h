@@ -40,6 +40,14 @@ public:
 private:
   EventReader* event_reader;
 
+  static EventBase* compactEvent( EventBase* event, EventArena* arena ) {
+    if ( arena == NULL ) return event;
+    EventBase* compact = event->compactInto( *arena );
+    if ( compact == NULL ) return event;
+    delete event;
+    return compact;
+  }
+
 public:
   /// Constructor
   EventFormat(EventReader* er)
@@ -139,6 +147,45 @@ public:
     inputEventSpaceWithProb( s1, s2, name_table, *event_space );
     }*/
 
+  /// Input the events of a tokenizer into a list instead of an event
+  /// space; the caller owns the events.  Several threads may call this
+  /// at once with different tokenizers and lists.  If an arena is
+  /// given, events are moved into it as they are read (see
+  /// EventBase::compactInto).
+  /// @return false if the input stopped before the end of the stream
+  /// (at an empty line where an event should start)
+  virtual bool inputEvents( Tokenizer& t,
+			    std::vector< EventBase* >& events,
+			    EventArena* arena = NULL ) const {
+    std::string event_name;
+    try {
+      while ( EventBase* event = event_reader->input( event_name, t ) ) {
+	events.push_back( compactEvent( event, arena ) );
+      }
+    }
+    catch ( TokenError& e ) {
+      throw IllegalEventFormatError( e.message(), t.lineNumber() );
+    }
+    return t.endOfStream();
+  }
+
+  /// Input the events of a tokenizer and their reference distribution
+  /// into a list (see inputEvents)
+  virtual bool inputEventsWithProb( Tokenizer& t1, Tokenizer& t2,
+				    std::vector< EventBase* >& events,
+				    EventArena* arena = NULL ) const {
+    std::string event_name;
+    try {
+      while ( EventBase* event = event_reader->inputWithProb( event_name, t1, t2 ) ) {
+	events.push_back( compactEvent( event, arena ) );
+      }
+    }
+    catch ( TokenError& e ) {
+      throw IllegalEventFormatError( e.message(), t1.lineNumber() );
+    }
+    return t1.endOfStream();
+  }
+
   /// Input event data and its reference distribution from input streams
   virtual void inputEventSpaceWithProb( std::istream& s1, std::istream& s2,
 					EventSpace& event_space ) const {
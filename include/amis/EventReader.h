@@ -35,10 +35,35 @@ AMIS_NAMESPACE_BEGIN
  */
 
 class EventReader {
+public:
+  /// How the events of a file are delimited, which tells where a file
+  /// can be split into parts parsed independently
+  enum EventDelimiter {
+    /// the file cannot be split
+    NO_DELIMITER,
+    /// an event is written in a line
+    LINE_DELIMITER,
+    /// an event ends with an empty line
+    EMPTY_LINE_DELIMITER
+  };
+
 protected:
   NameTable* name_table;
   FeatureWeightType feature_weight_type;
 
+  /// The length and a 32-bit FNV-1a hash of a description, which keep
+  /// the signatures of large fixmaps short
+  static std::string digest( const std::string& text )
+  {
+    unsigned int hash = 2166136261u;
+    for ( std::string::const_iterator it = text.begin(); it != text.end(); ++it ) {
+      hash = ( hash ^ static_cast< unsigned char >( *it ) ) * 16777619u;
+    }
+    OStringStream oss;
+    oss << text.size() << ':' << std::hex << hash;
+    return oss.str();
+  }
+
   Real inputLambda( Real x ) const
   {
     switch (feature_weight_type) {
@@ -58,6 +83,11 @@ public:
   virtual EventBase* inputWithProb( std::string& name, Tokenizer& t1, Tokenizer& t2 ) const = 0;
   virtual WeightAccumulator* makeAccumulator() const = 0;
   virtual void initialize() { }
+  virtual EventDelimiter eventDelimiter() const { return NO_DELIMITER; }
+  /// Description of the data other than the model to which events
+  /// refer by IDs (fixmaps, transitions and so on); an event cache is
+  /// read only by a reader with the same signature
+  virtual std::string cacheSignature() const { return std::string(); }
 
   void setFeatureNameTable(NameTable* nt)
   {
@@ -60,6 +60,11 @@ public:
     return new AmisWeightAccumulator<Feature, ParameterValue, ReferenceProbability>();
   }
 
+  EventDelimiter eventDelimiter() const
+  {
+    return EMPTY_LINE_DELIMITER;
+  }
+
   EventType* inputEvent( std::string& event_name, Tokenizer& t) const
   {
     EventType* ret = new EventType();
@@ -164,7 +169,6 @@ public:
 
 template<class Feature, class ParameterValue, bool ReferenceProbability >
 class AmisTreeEventReader : public EventReader {
-  mutable StringHash< EventTreeNodeID > node_hash;
   FeatureParser< Feature > feature_parser;
 public:
   typedef EventTree<Feature, ReferenceProbability> EventType;
@@ -181,10 +185,18 @@ public:
     return new TreeWeightAccumulator<Feature, ParameterValue, ReferenceProbability>();
   }
 
+  EventDelimiter eventDelimiter() const
+  {
+    return EMPTY_LINE_DELIMITER;
+  }
+
 
+  /// Input disjunctive node; node_hash maps the names of the nodes
+  /// of the event to their IDs
   EventTreeNodeID inputEventDisjNode(std::string& event_name, 
 				     Tokenizer& t,
-				     EventType& et ) const {
+				     EventType& et,
+				     StringHash< EventTreeNodeID >& node_hash ) const {
     std::string token;
     std::vector< EventTreeNodeID > disj_list;
     if ( ! t.nextToken( token ) ) {
@@ -220,7 +232,7 @@ public:
         case '(':
           {
             // start of EventTreeNode
-            EventTreeNodeID id = inputEventConjNode( event_name, t, et );
+            EventTreeNodeID id = inputEventConjNode( event_name, t, et, node_hash );
             disj_list.push_back( id );
             continue;
           }
@@ -240,7 +252,7 @@ public:
 	if ( it == node_hash.end() ) {
 	  throw IllegalEventFormatError( "Unknown conjunctive node in Event " + event_name + " : " + node_name, t.lineNumber() );
 	}
-	if ( et[ it->second ].isDisjunctiveNode() ) {
+	if ( et.isDisjunctiveNode( it->second ) ) {
 	  throw IllegalEventFormatError( "Daughter of a disjunctive node must be conjunctive in Event " + event_name + " : " + node_name, t.lineNumber() );
 	}
 	disj_list.push_back( it->second );
@@ -256,7 +268,8 @@ public:
   /// Input conjunctive node
   EventTreeNodeID inputEventConjNode(std::string& event_name, 
 				     Tokenizer& t,
-				     EventType& et ) const {
+				     EventType& et,
+				     StringHash< EventTreeNodeID >& node_hash ) const {
     std::string token;
     std::vector< Feature > feature_list;
     std::vector< EventTreeNodeID > daughter_list;
@@ -277,11 +290,14 @@ public:
       }
     }
     while ( true ) {
-      if ( ! t.nextToken( token , ":" ) ) {
+      const char* p;
+      size_t size;
+      if ( ! t.nextToken( p, size, ":" ) ) {
         // end of line
         throw IllegalEventFormatError( "Truncated line found in a conjunctive node in Event " + event_name, t.lineNumber() );
       }
-      else if ( token.length() == 1 ) {
+      else if ( size == 1 ) {
+	token.assign( p, size );
 	if ( t.currentDelimiter() == ':' ) {
 	  throw IllegalEventFormatError( "Symbols cannot be followed by \":\" in Event " + event_name + " : " + token, t.lineNumber() );
 	}
@@ -303,12 +319,13 @@ public:
           }
         case '{':
           // a new disjunction found
-          daughter_list.push_back( inputEventDisjNode( event_name, t, et ) );
+          daughter_list.push_back( inputEventDisjNode( event_name, t, et, node_hash ) );
           continue;
         }
       }
-      else if ( token[ 0 ] == '$' ) {
+      else if ( p[ 0 ] == '$' ) {
 	// reference to a disjunctive node
+	token.assign( p, size );
 	if ( t.currentDelimiter() == ':' ) {
 	  throw IllegalEventFormatError( "Node name cannot be followed by \":\" in Event " + event_name + " : " + token, t.lineNumber() );
 	}
@@ -317,7 +334,7 @@ public:
 	if ( it == node_hash.end() ) {
 	  throw IllegalEventFormatError( "Unknown disjunctive node in Event " + event_name + " : " + node_name, t.lineNumber() );
 	}
-	if ( ! et[ it->second ].isDisjunctiveNode() ) {
+	if ( ! et.isDisjunctiveNode( it->second ) ) {
 	  throw IllegalEventFormatError( "Daughter of a conjunctive node must be disjunctive in Event " + event_name + " : " + token, t.lineNumber() );
 	}
 	daughter_list.push_back( it->second );
@@ -326,14 +343,15 @@ public:
 	// a feature found
 	typename Feature::FeatureFreq freq = 1;
 	if ( t.currentDelimiter() == ':' ) {
+	  // the next token may move the buffer of the tokenizer under the name
+	  token.assign( p, size );
+	  p = token.data();
 	  if ( ! t.nextToken( freq ) ) {
 	    throw ( "Cannot read feature frequency in Event " + event_name, t.lineNumber() );
 	  }
 	}
-	std::string feature;
-	Tokenizer::convert( token, feature );
         try {
-          feature_list.push_back( Feature( name_table->featureID( feature ), freq ) );
+          feature_list.push_back( Feature( name_table->featureID( p, size ), freq ) );
         }
 	catch ( IllegalFeatureError& e ) {
           throw IllegalEventFormatError( e.message() + " in Event " + event_name, t.lineNumber() );
@@ -348,7 +366,8 @@ public:
   /// Input probability from stream
   bool inputProb(std::string& event_name,
 		 Tokenizer& t,
-		 EventType& event_tree ) const {
+		 EventType& event_tree,
+		 const StringHash< EventTreeNodeID >& node_hash ) const {
     if ( ! t.nextToken( event_name ) ) return false; // empty line
     std::string token;
     if ( t.nextToken( token ) ) {
@@ -367,13 +386,13 @@ public:
       if ( event_node == node_hash.end() ) {
 	throw IllegalEventFormatError( "Unknown event node " + token + " found in probability file in Event " + event_name, t.lineNumber() );
       }
-      if ( event_tree[ event_node->second ].isDisjunctiveNode() ) {
+      if ( event_tree.isDisjunctiveNode( event_node->second ) ) {
 	throw IllegalEventFormatError( "Reference probability cannot be assigned to disjunctive node " + token + " in Event " + event_name, t.lineNumber() );
       }
       if ( ! t.nextToken( prob ) ) {
 	throw IllegalEventFormatError( "Probability value not found in probability file in Event " + event_name, t.lineNumber() );
       }
-      event_tree[ event_node->second ].featureList().setReferenceProbability( this->inputLambda(prob) );
+      event_tree.setReferenceProbability( event_node->second, this->inputLambda(prob) );
       if ( t.nextToken( token ) ) {
         throw IllegalEventFormatError( "Too many tokens found in probability file in Event " + event_name, t.lineNumber() );
       }
@@ -383,6 +402,14 @@ public:
 
   /// Input an event from tokenizer
   EventType* inputEvent( std::string& event_name, Tokenizer& t ) const
+  {
+    StringHash< EventTreeNodeID > node_hash;
+    return inputEvent( event_name, t, node_hash );
+  }
+
+  /// Input an event, leaving the names of its nodes in node_hash
+  EventType* inputEvent( std::string& event_name, Tokenizer& t,
+			 StringHash< EventTreeNodeID >& node_hash ) const
   {
     EventType* ret = new EventType();
     NameTable& name_table = *this->name_table;
@@ -422,12 +449,10 @@ public:
       throw IllegalEventFormatError( "Event tree not found in Event " + event_name,
 				     t.lineNumber() );
     }
-    //node_hash.clear();
-    node_hash = StringHash< EventTreeNodeID >();
     ret->clear();
     ret->addObservedEvent( freq, fl );
     //std::cerr << "start reading tree" << std::endl;
-    inputEventDisjNode( event_name, t, *ret );
+    inputEventDisjNode( event_name, t, *ret, node_hash );
     //std::cerr << "finish reading tree" << std::endl;
     if ( t.nextToken( token ) || t.nextToken(token) ) {
       throw IllegalEventFormatError( "A token found after the event tree in Event " + event_name,
@@ -445,11 +470,12 @@ public:
 			    Tokenizer& t1,
 			    Tokenizer& t2) const
   {
-    EventType* ret = this->inputEvent( event_name, t1);
+    StringHash< EventTreeNodeID > node_hash;
+    EventType* ret = this->inputEvent( event_name, t1, node_hash );
     if ( ret == 0 ) return 0;
 
     std::string prob_event_name;
-    while ( ! inputProb( prob_event_name, t2, *ret ) ) {
+    while ( ! inputProb( prob_event_name, t2, *ret, node_hash ) ) {
       if ( t2.endOfStream() ) {
 	throw IllegalEventFormatError( "Probability file is shorter than event file", t1.lineNumber() );
       }
@@ -468,8 +494,11 @@ class AmisFixEventReader : public EventReader {
   typedef typename Feature::FeatureFreq FeatureFreq;
   std::vector<std::string> fixmap_files;
   std::string fixmap_compression;
+  std::string fix_target_layout;
+  std::vector<std::string> restriction_files;
 
   FixedTarget fixed_target;
+  RestrictedTarget restricted_target;
 
   FeatureParser< Feature > feature_parser;
 
@@ -480,8 +509,16 @@ public:
   {
     fixmap_files = property->getFixMapFileList();
     fixmap_compression = property->getFixMapFileCompression();
+    fix_target_layout = property->getFixTargetLayout();
+    restriction_files = property->getRestrictionFileList();
+    if ( fix_target_layout != "sparse" && fix_target_layout != "dense" && fix_target_layout != "auto" ) {
+      throw IllegalPropertyError( "Unknown fix target layout: " + fix_target_layout );
+    }
   }
 
+  /// The least density of a fixmap laid out densely by "auto"
+  static double autoDenseDensity() { return 0.5; }
+
   void initialize()
   {
     for (std::vector<std::string>::iterator file_it = fixmap_files.begin();
@@ -491,6 +528,23 @@ public:
 	Property::openInputStream( *file_it, fixmap_compression );
       this->initFixMap(*fixmap_file);
     }
+    for (std::vector<std::string>::iterator file_it = restriction_files.begin();
+	 file_it != restriction_files.end();
+	 ++file_it) {
+      std::auto_ptr< std::istream > restriction_file =
+	Property::openInputStream( *file_it, fixmap_compression );
+      Tokenizer t(*restriction_file);
+      this->inputRestrictedTarget(t);
+    }
+    if ( fix_target_layout == "dense"
+	 || ( fix_target_layout == "auto" && fixed_target.density() >= autoDenseDensity() ) ) {
+      if ( fixed_target.buildDenseTargets() ) {
+	AMIS_DEBUG_MESSAGE( 3, "Fixmap laid out densely: density=" << fixed_target.density() << '\n' );
+      }
+      else if ( fix_target_layout == "dense" ) {
+	AMIS_WARNING_MESSAGE( "Fixmap is kept sparse because a history has more than one feature for a target\n" );
+      }
+    }
   }
 
   EventBase* allocate() const
@@ -500,7 +554,27 @@ public:
 
   WeightAccumulator* makeAccumulator() const
   {
-    return new FixWeightAccumulator<Feature, ParameterValue, ReferenceProbability>(fixed_target);
+    return new FixWeightAccumulator<Feature, ParameterValue, ReferenceProbability>(fixed_target, restricted_target);
+  }
+
+  EventDelimiter eventDelimiter() const
+  {
+    return LINE_DELIMITER;
+  }
+
+  std::string cacheSignature() const
+  {
+    OStringStream fixmap;
+    fixed_target.writeSignature( fixmap );
+    OStringStream restriction;
+    restricted_target.writeSignature( restriction );
+    OStringStream oss;
+    oss << "targets=" << fixed_target.numTargets()
+	<< ",histories=" << fixed_target.numHistories()
+	<< ",fixmap=" << digest( fixmap.str() )
+	<< ",groups=" << restricted_target.numGroups()
+	<< ",restriction=" << digest( restriction.str() );
+    return oss.str();
   }
 
   void initFixMap( std::istream& s )
@@ -525,18 +599,40 @@ public:
       std::string history;
       if ( ! t.nextToken( history ) ) continue;
       FeatureID hid = fixed_target.registerNewHistory( history );
-      std::string target;
-      while( t.nextToken( target ) ) {
-        FeatureID tid = fixed_target.targetID( target );
-        AMIS_DEBUG_MESSAGE( 2, "target=" << target << " id=" << tid << '\n' );
-
-	std::string feature;
-        if ( ! t.nextToken( feature ) ) {
+      const char* target;
+      size_t target_size;
+      while( t.nextToken( target, target_size ) ) {
+        FeatureID tid = fixed_target.targetID( target, target_size );
+        AMIS_DEBUG_MESSAGE( 2, "target=" << std::string( target, target_size ) << " id=" << tid << '\n' );
+
+	const char* feature;
+	size_t feature_size;
+        if ( ! t.nextToken( feature, feature_size ) ) {
           throw IllegalEventFormatError( "Cannot read feature name", t.lineNumber() );
         }
-	FeatureID fid = name_table->featureID(feature);
+	FeatureID fid = name_table->featureID( feature, feature_size );
 	fixed_target.addFeatureMap( hid, tid, fid );
-        AMIS_DEBUG_MESSAGE( 2, "feature=" << feature << " id=" << fid << " lambda=" << lambda << '\n' );
+        AMIS_DEBUG_MESSAGE( 2, "feature=" << std::string( feature, feature_size ) << " id=" << fid << " lambda=" << lambda << '\n' );
+      }
+    }
+  }
+
+  /// Name of the group of all the targets in event files
+  static const char* allTargetsGroup() { return "_"; }
+
+  /// Read groups of targets: a group name followed by its targets in each line
+  void inputRestrictedTarget( Tokenizer& t )
+  {
+    while ( ! t.endOfStream() ) {
+      std::string group;
+      if ( ! t.nextToken( group ) ) continue;
+      if ( group == allTargetsGroup() ) {
+	throw IllegalEventFormatError( "Group " + group + " is reserved for all the targets", t.lineNumber() );
+      }
+      FeatureID gid = restricted_target.registerNewGroup( group );
+      std::string target;
+      while( t.nextToken( target ) ) {
+	restricted_target.addRestriction( fixed_target, gid, fixed_target.targetID( target ) );
       }
     }
   }
@@ -551,13 +647,15 @@ public:
     std::vector< std::pair<std::string, FeatureFreq> > org_vec;
     std::pair< std::string, FeatureFreq>              tmp_pair;
     
-    std::string history_feat;
+    const char* history_feat;
+    size_t size;
+    std::string buf;
     FeatureFreq val;
-    while ( feature_parser.inputFeature( t, history_feat, val ) ) {
+    while ( feature_parser.inputFeature( t, history_feat, size, buf, val ) ) {
       if ( val <= 0 ) {
         throw IllegalModelFormatError( "History value must be positive in Event " , t.lineNumber() );
       }
-      FeatureID hid = fixed_target.historyID( history_feat );
+      FeatureID hid = fixed_target.historyID( history_feat, size );
       
       hv.push_back( Feature( hid, val ) );
     }
@@ -584,12 +682,37 @@ public:
     }
     FeatureID tid = fixed_target.targetID( target );
 
+    // with restriction files, the group of the targets follows the target
+    FeatureID gid = UNKNOWN_FEATURE_ID;
+    if ( ! restriction_files.empty() ) {
+      std::string group;
+      if ( !t.nextToken( group ) ) {
+	throw IllegalEventFormatError( "AmisFixFormat: No target group", t.lineNumber() );
+      }
+      if ( group != allTargetsGroup() ) {
+	try {
+	  gid = restricted_target.groupID( group );
+	}
+	catch ( IllegalFeatureError& ) {
+	  throw IllegalEventFormatError( "AmisFixFormat: Group " + group + " not found", t.lineNumber() );
+	}
+	if ( ! restricted_target.validate( gid, tid ) ) {
+	  throw IllegalEventFormatError( "AmisFixFormat: Target " + target + " is not in group " + group, t.lineNumber() );
+	}
+      }
+    }
+
     std::vector< Feature > hv;
     inputHistoryList( t, hv ); // without registering
     //FeatureList<Feature> hl( hv, 1 );
     FeatureList<Feature> hl( hv, freq );
     
-    ret->add( fixed_target, freq, tid, hl );
+    if ( gid == UNKNOWN_FEATURE_ID ) {
+      ret->add( fixed_target, freq, tid, hl );
+    }
+    else {
+      ret->add( fixed_target, restricted_target, freq, tid, gid, hl );
+    }
     
     return ret;
   }
@@ -619,6 +742,7 @@ class AmisCRFEventReader : public EventReader {
   std::vector<std::string> transition_files;
 
   std::string transition_compression;
+  std::string transition_layout;
   FixedTarget fixed_target;
   CRFTransition crf_transition;
   FeatureParser< Feature > feature_parser;
@@ -631,7 +755,12 @@ public:
     fixmap_compression = property->getFixMapFileCompression();
     transition_files = property->getTransitionFileList();
     transition_compression = property->getTransitionFileCompression();
+    transition_layout = property->getCRFTransitionLayout();
+    if ( transition_layout != "sparse" && transition_layout != "dense" && transition_layout != "auto" ) {
+      throw IllegalPropertyError( "Unknown CRF transition layout: " + transition_layout );
+    }
   }
+
   void initialize()
   {
     for (std::vector<std::string>::iterator file_it = fixmap_files.begin();
@@ -672,18 +801,20 @@ public:
       std::string history;
       if ( ! t.nextToken( history ) ) continue;
       FeatureID hid = fixed_target.registerNewHistory( history );
-      std::string target;
-      while( t.nextToken( target ) ) {
-        FeatureID tid = fixed_target.targetID( target );
-        AMIS_DEBUG_MESSAGE( 2, "target=" << target << " id=" << tid << '\n' );
-
-	std::string feature;
-        if ( ! t.nextToken( feature ) ) {
+      const char* target;
+      size_t target_size;
+      while( t.nextToken( target, target_size ) ) {
+        FeatureID tid = fixed_target.targetID( target, target_size );
+        AMIS_DEBUG_MESSAGE( 2, "target=" << std::string( target, target_size ) << " id=" << tid << '\n' );
+
+	const char* feature;
+	size_t feature_size;
+        if ( ! t.nextToken( feature, feature_size ) ) {
           throw IllegalEventFormatError( "Cannot read feature name", t.lineNumber() );
         }
-	FeatureID fid = name_table->featureID(feature);
+	FeatureID fid = name_table->featureID( feature, feature_size );
 	fixed_target.addFeatureMap( hid, tid, fid );
-        AMIS_DEBUG_MESSAGE( 2, "feature=" << feature << " id=" << fid << " lambda=" << lambda << '\n' );
+        AMIS_DEBUG_MESSAGE( 2, "feature=" << std::string( feature, feature_size ) << " id=" << fid << " lambda=" << lambda << '\n' );
       }
     }
   }
@@ -728,6 +859,11 @@ public:
 	crf_transition.addTarget(state_id, target_id);
       }
     }
+
+    bool dense = transition_layout == "dense"
+      || ( transition_layout == "auto" && crf_transition.density() > ParameterValue::denseTransitionDensity() );
+    crf_transition.compile( dense );
+    AMIS_DEBUG_MESSAGE( 3, "Transitions compiled " << ( dense ? "densely" : "sparsely" ) << ": density=" << crf_transition.density() << '\n' );
   }
 
   EventBase* allocate() const
@@ -740,19 +876,41 @@ public:
     return new CRFWeightAccumulator<Feature, ParameterValue, ReferenceProbability>(fixed_target, crf_transition);
   }
 
+  EventDelimiter eventDelimiter() const
+  {
+    return EMPTY_LINE_DELIMITER;
+  }
+
+  std::string cacheSignature() const
+  {
+    OStringStream fixmap;
+    fixed_target.writeSignature( fixmap );
+    OStringStream transition;
+    crf_transition.writeSignature( transition );
+    OStringStream oss;
+    oss << "targets=" << fixed_target.numTargets()
+	<< ",histories=" << fixed_target.numHistories()
+	<< ",fixmap=" << digest( fixmap.str() )
+	<< ",states=" << crf_transition.numStates()
+	<< ",transition=" << digest( transition.str() );
+    return oss.str();
+  }
+
 
   /// Input a history list from tokenizer
   void inputHistoryList( Tokenizer& t, const FixedTarget& fixed_target, std::vector< Feature >& hv ) const {
     std::vector< std::pair<std::string, FeatureFreq> > org_vec;
     std::pair< std::string, FeatureFreq >              tmp_pair;
     
-    std::string history_feat;
+    const char* history_feat;
+    size_t size;
+    std::string buf;
     FeatureFreq val;
-    while ( feature_parser.inputFeature( t, history_feat, val ) ) {
+    while ( feature_parser.inputFeature( t, history_feat, size, buf, val ) ) {
       if ( val <= 0 ) {
         throw IllegalModelFormatError( "History value must be positive in Event " , t.lineNumber() );
       }
-      FeatureID hid = fixed_target.historyID( history_feat );
+      FeatureID hid = fixed_target.historyID( history_feat, size );
       
       hv.push_back( Feature( hid, val ) );
     }
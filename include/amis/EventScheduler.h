@@ -0,0 +1,283 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_EventScheduler_h_
+
+#define Amis_EventScheduler_h_
+
+#include <amis/configure.h>
+#include <amis/EventSpace.h>
+#include <amis/Thread.h>
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#else // HAVE_SYS_TIME_H
+#include <ctime>
+#endif // HAVE_SYS_TIME_H
+
+AMIS_NAMESPACE_BEGIN
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A contiguous range of events processed as a unit of work.
+ */
+
+struct EventChunk {
+  /// Position of the chunk in the event space
+  size_t id;
+  EventCount begin_event;
+  EventCount end_event;
+  size_t cost;
+};
+
+/**
+ * Busy/idle time of a thread accumulated over passes.
+ */
+
+struct ThreadUsage {
+  double busy_sec;
+  double idle_sec;
+  size_t num_chunks;
+  size_t num_stolen;
+
+  ThreadUsage() : busy_sec( 0.0 ), idle_sec( 0.0 ), num_chunks( 0 ), num_stolen( 0 ) {}
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Cost-aware scheduler of events for parallel passes over an event space.
+ *
+ * Events are grouped into contiguous chunks of roughly equal estimated
+ * cost (EventSpace::eventCost).  The chunk layout depends only on the
+ * event space, not on the number of threads.  Each thread initially
+ * owns a contiguous run of chunks of about 1/n of the total cost and
+ * processes the most expensive ones first; a thread that runs out of
+ * work steals the cheapest remaining chunk of the busiest thread.
+ */
+
+class EventScheduler {
+public:
+  /// Number of chunks the event space is divided into
+  static const size_t DEFAULT_NUM_CHUNKS = 1024;
+
+private:
+  struct Queue {
+    Mutex mutex;
+    /// Chunk IDs sorted by decreasing cost (in event order for a single thread)
+    std::vector< size_t > chunks;
+    size_t head;
+    size_t tail;
+    size_t remaining_cost;
+  };
+
+  std::vector< EventChunk > chunk_list;
+  std::vector< Queue* > queue_list;
+  std::vector< ThreadUsage > usage_list;
+  std::vector< double > pass_busy;
+  double pass_start;
+
+  EventScheduler( const EventScheduler& );
+  EventScheduler& operator=( const EventScheduler& );
+
+  void clearQueues() {
+    for ( size_t i = 0; i < queue_list.size(); ++i ) {
+      delete queue_list[ i ];
+    }
+    queue_list.clear();
+  }
+
+  struct MoreCost {
+    const std::vector< EventChunk >& chunk_list;
+    explicit MoreCost( const std::vector< EventChunk >& c ) : chunk_list( c ) {}
+    bool operator()( size_t a, size_t b ) const {
+      return chunk_list[ a ].cost > chunk_list[ b ].cost
+        || ( chunk_list[ a ].cost == chunk_list[ b ].cost && a < b );
+    }
+  };
+
+  bool steal( size_t thread_id, EventChunk& chunk ) {
+    while ( true ) {
+      size_t victim = queue_list.size();
+      size_t max_cost = 0;
+      for ( size_t i = 0; i < queue_list.size(); ++i ) {
+        if ( i == thread_id ) continue;
+        MutexLock lock( queue_list[ i ]->mutex );
+        if ( queue_list[ i ]->head < queue_list[ i ]->tail &&
+             queue_list[ i ]->remaining_cost >= max_cost ) {
+          victim = i;
+          max_cost = queue_list[ i ]->remaining_cost;
+        }
+      }
+      if ( victim == queue_list.size() ) return false;
+      Queue& q = *queue_list[ victim ];
+      MutexLock lock( q.mutex );
+      if ( q.head < q.tail ) {
+        chunk = chunk_list[ q.chunks[ --q.tail ] ];
+        q.remaining_cost -= chunk.cost;
+        ++usage_list[ thread_id ].num_stolen;
+        return true;
+      }
+      // the victim finished meanwhile; look for another one
+    }
+  }
+
+public:
+  /// Constructor
+  EventScheduler() : pass_start( 0.0 ) {}
+  /// Destructor
+  ~EventScheduler() {
+    clearQueues();
+  }
+
+  /// Current wall-clock time in seconds
+  static double wallClock() {
+#ifdef HAVE_GETTIMEOFDAY
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+#else // HAVE_GETTIMEOFDAY
+    return static_cast< double >( time( NULL ) );
+#endif // HAVE_GETTIMEOFDAY
+  }
+
+  /// Divide the event space into chunks and assign them to threads
+  void initialize( const EventSpace& event_space, size_t num_threads,
+                   size_t num_chunks = DEFAULT_NUM_CHUNKS ) {
+    if ( num_threads < 1 ) num_threads = 1;
+    if ( num_chunks < 1 ) num_chunks = 1;
+    size_t total_cost = 0;
+    for ( EventCount i = 0; i < event_space.numEvents(); ++i ) {
+      total_cost += event_space.eventCost( i );
+    }
+    size_t target_cost = std::max< size_t >( ( total_cost + num_chunks - 1 ) / num_chunks, 1 );
+
+    chunk_list.clear();
+    EventChunk chunk;
+    chunk.id = 0;
+    chunk.begin_event = 0;
+    chunk.cost = 0;
+    for ( EventCount i = 0; i < event_space.numEvents(); ++i ) {
+      chunk.cost += event_space.eventCost( i );
+      if ( chunk.cost >= target_cost || i + 1 == event_space.numEvents() ) {
+        chunk.end_event = i + 1;
+        chunk_list.push_back( chunk );
+        ++chunk.id;
+        chunk.begin_event = i + 1;
+        chunk.cost = 0;
+      }
+    }
+
+    clearQueues();
+    size_t c = 0;
+    size_t prefix_cost = 0;
+    for ( size_t t = 0; t < num_threads; ++t ) {
+      Queue* q = new Queue();
+      size_t bound = total_cost * ( t + 1 ) / num_threads;
+      while ( c < chunk_list.size() &&
+              ( t + 1 == num_threads || prefix_cost + chunk_list[ c ].cost / 2 < bound ) ) {
+        prefix_cost += chunk_list[ c ].cost;
+        q->chunks.push_back( c++ );
+      }
+      if ( num_threads > 1 ) {
+        // a single thread keeps the order of events
+        std::sort( q->chunks.begin(), q->chunks.end(), MoreCost( chunk_list ) );
+      }
+      queue_list.push_back( q );
+    }
+    usage_list.assign( num_threads, ThreadUsage() );
+    pass_busy.assign( num_threads, 0.0 );
+  }
+
+  /// Number of chunks
+  size_t numChunks() const { return chunk_list.size(); }
+  /// Get the i-th chunk
+  const EventChunk& chunk( size_t i ) const { return chunk_list[ i ]; }
+  /// Number of threads
+  size_t numThreads() const { return queue_list.size(); }
+
+  /// Restore the initial assignment before a pass
+  void startPass() {
+    for ( size_t t = 0; t < queue_list.size(); ++t ) {
+      Queue& q = *queue_list[ t ];
+      q.head = 0;
+      q.tail = q.chunks.size();
+      q.remaining_cost = 0;
+      for ( size_t i = 0; i < q.chunks.size(); ++i ) {
+        q.remaining_cost += chunk_list[ q.chunks[ i ] ].cost;
+      }
+      pass_busy[ t ] = 0.0;
+    }
+    pass_start = wallClock();
+  }
+
+  /// Take the next chunk for a thread; false when no work remains
+  bool nextChunk( size_t thread_id, EventChunk& chunk ) {
+    {
+      Queue& q = *queue_list[ thread_id ];
+      MutexLock lock( q.mutex );
+      if ( q.head < q.tail ) {
+        chunk = chunk_list[ q.chunks[ q.head++ ] ];
+        q.remaining_cost -= chunk.cost;
+        ++usage_list[ thread_id ].num_chunks;
+        return true;
+      }
+    }
+    if ( steal( thread_id, chunk ) ) {
+      ++usage_list[ thread_id ].num_chunks;
+      return true;
+    }
+    return false;
+  }
+
+  /// Record time spent by a thread on a chunk
+  void addBusyTime( size_t thread_id, double sec ) {
+    pass_busy[ thread_id ] += sec;
+  }
+
+  /// Close a pass after all threads are joined
+  void endPass() {
+    double wall = wallClock() - pass_start;
+    for ( size_t t = 0; t < usage_list.size(); ++t ) {
+      usage_list[ t ].busy_sec += pass_busy[ t ];
+      usage_list[ t ].idle_sec += std::max( wall - pass_busy[ t ], 0.0 );
+    }
+  }
+
+  /// Usage statistics of each thread
+  const std::vector< ThreadUsage >& threadUsage() const { return usage_list; }
+
+  /// Print usage statistics of each thread
+  void writeUsage( std::ostream& os ) const {
+    std::streamsize precision = os.precision();
+    for ( size_t t = 0; t < usage_list.size(); ++t ) {
+      const ThreadUsage& u = usage_list[ t ];
+      os << "Thread " << std::setw( 3 ) << t
+         << ": busy " << std::fixed << std::setprecision( 3 ) << u.busy_sec
+         << " sec, idle " << u.idle_sec
+         << " sec, " << u.num_chunks << " chunks (" << u.num_stolen << " stolen)\n";
+      os.unsetf( std::ios::fixed );
+    }
+    os.precision( precision );
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_EventScheduler_h_
+// end of EventScheduler.h
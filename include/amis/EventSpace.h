@@ -29,6 +29,21 @@ AMIS_NAMESPACE_BEGIN
 typedef size_t EventCount;
 
 
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A read position over the events of an event space, used by one
+ * thread at a time.
+ * @see EventSpace::newCursor
+ */
+
+class EventCursor {
+public:
+  virtual ~EventCursor() {}
+  /// Get the i-th event; the reference is valid until the next call
+  virtual const EventBase& operator[]( int i ) = 0;
+};
+
 //////////////////////////////////////////////////////////////////////
 
 /// <classdef>
@@ -48,6 +63,7 @@ public:
   Real   sum_event_count;
 private:
   Real max_feature_count;
+  std::vector< size_t > event_cost;
   mutable bool is_dirty;
   mutable Real event_empirical_expectation;
   WeightAccumulator* accumulator;
@@ -71,6 +87,16 @@ public:
   virtual const EventBase& operator[]( int i ) const = 0;
   /// Get the i-th event
 
+  virtual bool isConcurrentAccessible() const { return true; }
+  /// Whether several threads may read events at once, each through
+  /// its own cursor
+
+  virtual EventCursor* newCursor() const;
+  /// Make a cursor over the events, to be deleted by the caller
+
+  virtual const EventBase* const* eventArray() const { return NULL; }
+  /// Pointers to all the events in order, or NULL if events are not on memory
+
 protected:
   void updateMaxFeatureCount( Real m ) {
     if ( m > max_feature_count ) max_feature_count = m;
@@ -85,6 +111,19 @@ public:
 public:
   virtual bool inputEvent( const EventReader* , Tokenizer& t ) = 0;
   virtual bool inputEventWithProb( const EventReader* , Tokenizer& t1, Tokenizer& t2 ) = 0;
+  virtual void inputEventObject( const EventReader* , objstream& s ) = 0;
+  /// Add an event written by EventBase::writeObject
+  virtual void pushEvent( EventBase* event ) = 0;
+  /// Add an event made by EventReader::input; the event space takes
+  /// the ownership of the event
+  virtual bool usesArena() const { return false; }
+  /// Whether events are kept in an EventArena (see pushArena)
+  virtual void pushArena( const std::vector< EventBase* >& events, EventArena& arena ) {
+    throw IllegalEventError( "Events in an arena cannot be added to " + eventSpaceName() );
+  }
+  /// Add events made by EventBase::compactInto in another arena (or
+  /// made by EventReader::input, if the arena is empty); the event
+  /// space takes over the arena and the events
 
   virtual WeightAccumulator* getAccumulator()
   {
@@ -113,8 +152,14 @@ public:
     sum_event_count += eb.eventFrequency();
     num_feature_lists += eb.numFeatureList();
     max_feature_count = std::max(max_feature_count, eb.maxFeatureCount());
+    event_cost.push_back(eb.computationCost());
   }
 
+  size_t eventCost( EventCount i ) const {
+    return event_cost[ i ];
+  }
+  /// Estimated work for the i-th event (see EventBase::computationCost)
+
   virtual void validate( const EventReader* reader)
   {
     accumulator = reader->makeAccumulator();
@@ -133,19 +178,63 @@ public:
 
 
 
+/// Cursor which simply refers to the events of an event space
+class EventSpaceCursor : public EventCursor {
+  const EventSpace* event_space;
+public:
+  EventSpaceCursor( const EventSpace& es ) : event_space( &es ) {}
+  const EventBase& operator[]( int i ) {
+    return ( *event_space )[ i ];
+  }
+};
+
+inline EventCursor* EventSpace::newCursor() const {
+  return new EventSpaceCursor( *this );
+}
+
 typedef std::auto_ptr< EventSpace > EventSpacePtr;
 
 
 
 
+/**
+ * Events stored on memory.
+ * Events that support EventBase::compactInto are moved into an
+ * EventArena as they are read, so that all the events, their feature
+ * lists and their features are packed in a few large blocks in the
+ * order of input.  Other events are kept as they are allocated.
+ */
+
 class EventSpaceOnMemory : public EventSpace {//: public EventSpaceBase {
 private:
   std::vector< EventBase* > event_list;
+  EventArena arena;
+  bool compacted;
+
+protected:
+  void push( EventBase* event )
+  {
+    EventBase* compact = event->compactInto( arena );
+    if ( compact != NULL ) {
+      delete event;
+      event = compact;
+      compacted = true;
+    }
+    event_list.push_back(event);
+    this->addEvent(*event);
+  }
+  /// Push a new event to an event space
 
 public:
-  EventSpaceOnMemory( void ) {
+  EventSpaceOnMemory( void ) : compacted( false ) {
+  }
+  virtual ~EventSpaceOnMemory() {
+    if ( ! compacted ) {
+      for ( size_t i = 0; i < event_list.size(); ++i ) {
+        delete event_list[ i ];
+      }
+    }
   }
-  virtual ~EventSpaceOnMemory() {}
 
   bool inputEvent( const EventReader* reader, Tokenizer& t )
   {
@@ -153,8 +242,7 @@ public:
     EventBase* event = reader->input(event_name, t);
     if ( event != 0 ) {
     //event->inputEvent(reader, t);
-      event_list.push_back(event);
-      this->addEvent(*event);
+      this->push(event);
       return true;
     }
     else {
@@ -167,23 +255,52 @@ public:
     EventBase* event = reader->inputWithProb(event_name, t1, t2);
     if ( event != 0 ) {
     //event->inputEvent(reader, t);
-      event_list.push_back(event);
-      this->addEvent(*event);
+      this->push(event);
       return true;
     }
     else {
       return false;
     }
   }
+  void inputEventObject( const EventReader* reader, objstream& s )
+  {
+    EventBase* event = reader->allocate();
+    event->readObject( s );
+    this->push(event);
+  }
+  void pushEvent( EventBase* event )
+  {
+    this->push(event);
+  }
+  bool usesArena() const { return true; }
+  void pushArena( const std::vector< EventBase* >& events, EventArena& a )
+  {
+    if ( a.numBlocks() > 0 ) compacted = true;
+    arena.splice( a );
+    for ( size_t i = 0; i < events.size(); ++i ) {
+      event_list.push_back( events[ i ] );
+      this->addEvent( *events[ i ] );
+    }
+  }
   
   virtual const EventBase& operator[]( int i ) const
   {
     return *event_list[i];
   }
 
+  const EventBase* const* eventArray() const
+  {
+    return event_list.empty() ? NULL : &event_list[ 0 ];
+  }
+
   const std::string eventSpaceName() const {
     return "EventSpace";
   }
+
+  /// Memory holding compacted events
+  const EventArena& eventArena() const {
+    return arena;
+  }
 };
 
 
@@ -191,7 +308,17 @@ public:
 class EventSpaceOnFile : public EventSpace {
 private:
   VectorOnFile< EventBase > event_vector;
-  EventBase* workspace;
+  const EventReader* event_reader;
+
+  /// Cursor over the temporary event files
+  class Cursor : public EventCursor {
+    VectorOnFile< EventBase >::Cursor cursor;
+  public:
+    Cursor( const VectorOnFile< EventBase >& v, EventBase* workspace ) : cursor( v, workspace ) {}
+    const EventBase& operator[]( int i ) {
+      return cursor[ i ];
+    }
+  };
 
 protected:
   void push( EventBase* event )
@@ -203,7 +330,7 @@ protected:
   /// Push a new event to an event space
 
 public:
-  EventSpaceOnFile( objstream* s ) : event_vector( s ) {
+  EventSpaceOnFile( objstream* s ) : event_vector( s ), event_reader( NULL ) {
     //std::cerr << s << std::endl;
   }
   /// Constructor for EventSpaceOnFile
@@ -247,10 +374,22 @@ public:
     }
   }
 
+  void inputEventObject( const EventReader* reader, objstream& s )
+  {
+    EventBase* event = reader->allocate();
+    event->readObject( s );
+    this->push(event);
+  }
+  void pushEvent( EventBase* event )
+  {
+    this->push(event);
+  }
+
   void validate( const EventReader* reader)
   {
     EventSpace::validate(reader);
     event_vector.validate(*reader->allocate());
+    event_reader = reader;
   }
 
   const EventBase& operator[]( int i ) const
@@ -258,6 +397,17 @@ public:
     return event_vector[ i ];
   }
   /// Get the i-th event
+
+  EventCursor* newCursor() const
+  {
+    if ( event_reader == NULL ) {
+      throw VectorOnFileError( "Event space is not validated (should not happen)" );
+    }
+    return new Cursor( event_vector, event_reader->allocate() );
+  }
+  /// Each cursor decodes events into its own workspace from its own
+  /// streams; operator[] shares one workspace and must not be used by
+  /// several threads
 };
 
 
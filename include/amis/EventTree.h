@@ -19,140 +19,122 @@
 #include <amis/Event.h>
 #include <amis/FeatureList.h>
 #include <amis/objstream.h>
-#include <amis/Array.h>
 
 #include <vector>
 
 AMIS_NAMESPACE_BEGIN
 
 typedef unsigned int EventTreeNodeID;
-typedef Array< EventTreeNodeID > EventTreeNodeIDList;
 
 //////////////////////////////////////////////////////////////////////
 
 /// <classdef>
-/// <name>EventTreeNode</name>
-/// <overview>A node of an event tree</overview>
+/// <name>EventTreeNodeIDList</name>
+/// <overview>Daughters of a node of an event tree</overview>
+/// <desc>
+/// A view of a run of node IDs stored in an EventTree.
+/// </desc>
+/// <body>
+
+class EventTreeNodeIDList {
+public:
+  typedef const EventTreeNodeID* const_iterator;
+  typedef size_t size_type;
+
+private:
+  const EventTreeNodeID* head;
+  const EventTreeNodeID* tail;
+
+public:
+  EventTreeNodeIDList( const EventTreeNodeID* b, const EventTreeNodeID* e ) : head( b ), tail( e ) {}
+
+  const_iterator begin() const { return head; }
+  const_iterator end() const { return tail; }
+  size_type size() const { return tail - head; }
+  bool empty() const { return head == tail; }
+  EventTreeNodeID operator[]( size_type i ) const { return head[ i ]; }
+};
+
+/// </body>
+/// </classdef>
+
+//////////////////////////////////////////////////////////////////////
+
+/// <classdef>
+/// <name>EventTreeFeatureList</name>
+/// <overview>Features of a node of an event tree</overview>
 /// <desc>
-/// A node in an event tree (conjunctive/disjunctive).
-/// if 'feature_list' is NULL, it is a disjunctive node.
+/// A view of a run of features stored in an EventTree.
+/// It can be given to ParameterValue::exponent like a FeatureList.
 /// </desc>
 /// <body>
 
 template < class Feature >
-class EventTreeNode {
+class EventTreeFeatureList {
+public:
+  typedef typename Feature::FeatureFreq FeatureFreq;
+  typedef const Feature* const_iterator;
+  typedef size_t size_type;
+
 private:
-  bool disjunctive;
-  FeatureList< Feature > feature_list;
-  EventTreeNodeIDList daughter_list;
+  const Feature* head;
+  const Feature* tail;
+  Real prob;
 
-  public:
-  typedef typename FeatureList<Feature>::const_iterator const_iterator;
-  
-  const_iterator begin() const {
-    return feature_list->begin();
-  }
-  const_iterator end() const {
-    return feature_list->end();
-  }
-  
 public:
-  EventTreeNode() {
-    disjunctive = true;
-  }
-  EventTreeNode( const EventTreeNode< Feature >& n )
-    : daughter_list( n.daughter_list ) {
-    if ( n.disjunctive ) {
-      disjunctive = true;
-    } else {
-      disjunctive = false;
-      feature_list = FeatureList< Feature >( n.feature_list );
+  EventTreeFeatureList( const Feature* b, const Feature* e, Real p ) : head( b ), tail( e ), prob( p ) {}
+
+  const_iterator begin() const { return head; }
+  const_iterator end() const { return tail; }
+  size_type size() const { return tail - head; }
+  bool empty() const { return head == tail; }
+
+  FeatureFreq featureCount() const {
+    FeatureFreq count = 0;
+    for ( const_iterator it = begin(); it != end(); ++it ) {
+      count += it->freq();
     }
+    return count;
   }
-  EventTreeNode< Feature >& operator=( const EventTreeNode< Feature >& n ) {
-    daughter_list = n.daughter_list;
-    //if ( !disjunctive ) delete feature_list;
-    if ( n.disjunctive ) {
-      disjunctive = true;
-    } else {
-      disjunctive = false;
-      feature_list = FeatureList< Feature >( n.feature_list );
-    }
-    return (*this);
+  Real referenceProbability() const {
+    return prob;
   }
+};
 
-  EventTreeNode( const std::vector< Feature >& fl, const std::vector< EventTreeNodeID >& dl )
-    : daughter_list( dl ) {
-    // conjunctive node
-    disjunctive = false;
-    feature_list = FeatureList< Feature >( fl, 1 );
-  }
-  EventTreeNode( const std::vector< EventTreeNodeID >& dl )
-    : daughter_list( dl ) {
-    // disjunctive node
-    disjunctive = true;
-  }
-  ~EventTreeNode() {
-    //if ( feature_list != NULL ) {
-    //delete feature_list;
-    //}
-  }
+/// </body>
+/// </classdef>
+
+//////////////////////////////////////////////////////////////////////
+
+/// <classdef>
+/// <name>EventTreeNode</name>
+/// <overview>A node of an event tree</overview>
+/// <desc>
+/// A view of a node (conjunctive/disjunctive) in an event tree.
+/// A disjunctive node has no features.
+/// </desc>
+/// <body>
+
+template < class Feature >
+class EventTreeNode {
+private:
+  bool disjunctive;
+  EventTreeFeatureList< Feature > feature_list;
+  EventTreeNodeIDList daughter_list;
 
 public:
+  EventTreeNode( bool d, const EventTreeFeatureList< Feature >& fl, const EventTreeNodeIDList& dl )
+    : disjunctive( d ), feature_list( fl ), daughter_list( dl ) {}
+
   bool isDisjunctiveNode() const {
     return disjunctive;
   }
-  const FeatureList< Feature >& featureList() const {
-    return feature_list;
-  }
-  FeatureList< Feature >& featureList() {
+  const EventTreeFeatureList< Feature >& featureList() const {
     return feature_list;
   }
   const EventTreeNodeIDList& daughterList() const {
     return daughter_list;
   }
-
-public:
-  void writeObject( objstream& os ) const {
-    if ( disjunctive ) {
-      // Disjunctive node
-      os << false;
-    } else {
-      // Conjunctive node
-      os << true;
-      feature_list.writeObject( os );
-    }
-    os << static_cast< EventTreeNodeID >( daughter_list.size() );
-    for ( EventTreeNodeIDList::const_iterator it = daughter_list.begin();
-          it != daughter_list.end();
-          ++it ) {
-      os << *it;
-    }
-  }
-  void readObject( objstream& is ) {
-    bool is_conj;
-    is >> is_conj;
-    if ( is_conj ) {
-      // Conjunctive node
-      //if ( feature_list.empty() ) feature_list = FeatureList< Feature >();
-      disjunctive = false;
-      feature_list.readObject( is );
-    } else {
-      disjunctive = true;
-      //if ( !feature_list.empty() ) {
-      //feature_list = FeatureList< Feature >();
-      //}
-    }
-    EventTreeNodeID max, id;
-    is >> max;
-    daughter_list.resize( max );
-    for ( EventTreeNodeIDList::iterator it = daughter_list.begin();
-          it != daughter_list.end();
-          ++it ) {
-      is >> id;
-      *it = id;
-    }
-  }
 };
 
 /// </body>
@@ -177,6 +159,12 @@ public:
 /// so the node list is 'topological-sort'ed.
 /// When you traverse a forest in a top-down manner, you should just
 /// scan the node list from the end to the beginning.
+///
+/// Nodes are stored in separate contiguous arrays (structure of arrays):
+/// a bit for the kind of each node, offsets into the array of daughter
+/// IDs, and offsets into the array of features.  The features of node i
+/// are feature_run[ feature_offset[ i ] .. feature_offset[ i + 1 ] ),
+/// and its daughters are daughter_index[ daughter_offset[ i ] .. daughter_offset[ i + 1 ] ).
 /// </desc>
 /// <body>
 
@@ -185,36 +173,53 @@ class EventTree : public EventBase {
 public:
   typedef Feature FeatureType;
   typedef typename Feature::FeatureFreq FeatureFreq;
-  typedef typename std::vector< EventTreeNode< Feature > >::const_iterator const_iterator;
-  typedef typename std::vector< EventTreeNode< Feature > >::const_reverse_iterator const_reverse_iterator;
 
 private:
   FeatureList< Feature > observed_feature_list;
-  std::vector< EventTreeNode< Feature > > node_list;
-
-public:
-  const_iterator begin() const {
-    return node_list.begin();
-  }
-  const_iterator end() const {
-    return node_list.end();
-  }
-  const_reverse_iterator rbegin() const {
-    return node_list.rbegin();
-  }
-  const_reverse_iterator rend() const {
-    return node_list.rend();
+  std::vector< bool > disjunctive;
+  std::vector< EventTreeNodeID > daughter_offset;
+  std::vector< EventTreeNodeID > daughter_index;
+  std::vector< size_t > feature_offset;
+  std::vector< Feature > feature_run;
+  /// Reference probabilities of nodes (only with ReferenceProbability)
+  std::vector< Real > reference_prob;
+
+  template < class T >
+  static const T* head( const std::vector< T >& v ) {
+    return v.empty() ? NULL : &v[ 0 ];
+  }
+
+  void initOffsets() {
+    daughter_offset.assign( 1, 0 );
+    feature_offset.assign( 1, 0 );
+  }
+
+  EventTreeNodeID newNode( bool disj, const std::vector< EventTreeNodeID >& dl ) {
+    EventTreeNodeID new_id = disjunctive.size();
+    disjunctive.push_back( disj );
+    daughter_index.insert( daughter_index.end(), dl.begin(), dl.end() );
+    daughter_offset.push_back( daughter_index.size() );
+    if ( ReferenceProbability ) {
+      reference_prob.push_back( 1.0 );
+    }
+    return new_id;
   }
 
 public:
   EventTree() {
     freq_count = 0;
+    initOffsets();
   }
 
   void swap( EventTree< Feature, ReferenceProbability >& event ) {
     std::swap( freq_count, event.freq_count );
     observed_feature_list.swap( event.observed_feature_list );
-    node_list.swap( event.node_list );
+    disjunctive.swap( event.disjunctive );
+    daughter_offset.swap( event.daughter_offset );
+    daughter_index.swap( event.daughter_index );
+    feature_offset.swap( event.feature_offset );
+    feature_run.swap( event.feature_run );
+    reference_prob.swap( event.reference_prob );
   }
 
   Real eventProbability() const {
@@ -231,19 +236,22 @@ public:
   }
 
   EventTreeNodeID newConjunctiveNode( const std::vector< Feature >& fl, const std::vector< EventTreeNodeID >& dl ) {
-    EventTreeNodeID new_id = node_list.size();
-    node_list.push_back( EventTreeNode< Feature >( fl, dl ) );
-    return new_id;
+    feature_run.insert( feature_run.end(), fl.begin(), fl.end() );
+    feature_offset.push_back( feature_run.size() );
+    return newNode( false, dl );
   }
   EventTreeNodeID newDisjunctiveNode( const std::vector< EventTreeNodeID >& dl ) {
-    EventTreeNodeID new_id = node_list.size();
-    node_list.push_back( EventTreeNode< Feature >( dl ) );
-    return new_id;
+    feature_offset.push_back( feature_run.size() );
+    return newNode( true, dl );
   }
 
   void clear() {
     freq_count = 0;
-    node_list.resize(0);
+    disjunctive.clear();
+    daughter_index.clear();
+    feature_run.clear();
+    reference_prob.clear();
+    initOffsets();
   }
 
   const FeatureList< Feature >& observedEvent() const {
@@ -254,7 +262,7 @@ public:
   }
 
   EventTreeNodeID numEventTreeNodes() const {
-    return node_list.size();
+    return disjunctive.size();
   }
   size_t numFeatureList() const
   {
@@ -262,11 +270,50 @@ public:
     // so return # tree nodes.
     return numEventTreeNodes();
   }
-  const EventTreeNode< Feature >& operator[]( EventTreeNodeID id ) const {
-    return node_list[ id ];
+
+  /// Whether the id-th node is disjunctive
+  bool isDisjunctiveNode( EventTreeNodeID id ) const {
+    return disjunctive[ id ];
+  }
+  /// Beginning of the daughters of the id-th node
+  const EventTreeNodeID* daughterBegin( EventTreeNodeID id ) const {
+    return head( daughter_index ) + daughter_offset[ id ];
+  }
+  /// End of the daughters of the id-th node
+  const EventTreeNodeID* daughterEnd( EventTreeNodeID id ) const {
+    return head( daughter_index ) + daughter_offset[ id + 1 ];
+  }
+  /// Beginning of the features of the id-th node
+  const Feature* featureBegin( EventTreeNodeID id ) const {
+    return head( feature_run ) + feature_offset[ id ];
+  }
+  /// End of the features of the id-th node
+  const Feature* featureEnd( EventTreeNodeID id ) const {
+    return head( feature_run ) + feature_offset[ id + 1 ];
+  }
+  /// Features of the id-th node
+  EventTreeFeatureList< Feature > featureList( EventTreeNodeID id ) const {
+    return EventTreeFeatureList< Feature >( featureBegin( id ), featureEnd( id ), referenceProbability( id ) );
+  }
+  /// Reference probability of the id-th node
+  Real referenceProbability( EventTreeNodeID id ) const {
+    return ReferenceProbability ? reference_prob[ id ] : 1.0;
   }
-  EventTreeNode< Feature >& operator[]( EventTreeNodeID id ) {
-    return node_list[ id ];
+  void setReferenceProbability( EventTreeNodeID id, Real p ) {
+    if ( ReferenceProbability ) reference_prob[ id ] = p;
+  }
+
+  /// A view of the id-th node
+  EventTreeNode< Feature > operator[]( EventTreeNodeID id ) const {
+    return EventTreeNode< Feature >( isDisjunctiveNode( id ),
+                                     featureList( id ),
+                                     EventTreeNodeIDList( daughterBegin( id ), daughterEnd( id ) ) );
+  }
+
+  size_t computationCost() const
+  {
+    // inside, outside and expectation passes touch every feature and daughter
+    return feature_run.size() + daughter_index.size() + numEventTreeNodes();
   }
 
   ////////////////////////////////////////////////////////////
@@ -274,28 +321,22 @@ public:
   Real maxFeatureCount() const
   {
     std::vector< FeatureFreq > max_count_list( numEventTreeNodes() );
-    typename std::vector< EventTreeNode< Feature > >::const_iterator node = begin();
-    typename std::vector< FeatureFreq >::iterator max_count = max_count_list.begin();
-    for ( ; node != end(); ++node, ++max_count ) {
-      if ( node->isDisjunctiveNode() ) {
+    for ( EventTreeNodeID id = 0; id < numEventTreeNodes(); ++id ) {
+      FeatureFreq count;
+      if ( isDisjunctiveNode( id ) ) {
         // disjunctive node
-        FeatureFreq count = Feature::MIN_FEATURE_FREQ;
-        for ( EventTreeNodeIDList::const_iterator dtr = node->daughterList().begin();
-              dtr != node->daughterList().end();
-              ++dtr ) {
+        count = Feature::MIN_FEATURE_FREQ;
+        for ( const EventTreeNodeID* dtr = daughterBegin( id ); dtr != daughterEnd( id ); ++dtr ) {
           count = std::max( count, max_count_list[ *dtr ] );
         }
-        *max_count = count;
       } else {
         // conjunctive node
-        FeatureFreq count = node->featureList().featureCount();
-        for ( EventTreeNodeIDList::const_iterator dtr = node->daughterList().begin();
-              dtr != node->daughterList().end();
-              ++dtr ) {
+        count = featureList( id ).featureCount();
+        for ( const EventTreeNodeID* dtr = daughterBegin( id ); dtr != daughterEnd( id ); ++dtr ) {
           count += max_count_list[ *dtr ];
         }
-        *max_count = count;
       }
+      max_count_list[ id ] = count;
     }
     return max_count_list.back();
   }
@@ -317,28 +358,103 @@ public:
 
   //////////////////////////////////////////////////////////////////////
 
+private:
+  /// Write the nodes in the compact encoding: the numbers of daughters
+  /// and features of each node with the disjunctive flag, and the
+  /// daughter indices as differences
+  void writeCompactNodes( objstream& os ) const {
+    EventTreeNodeID num_nodes = numEventTreeNodes();
+    os.writeVarint( num_nodes );
+    for ( EventTreeNodeID id = 0; id < num_nodes; ++id ) {
+      os.writeVarint( static_cast< size_t >( daughter_offset[ id + 1 ] - daughter_offset[ id ] ) << 1
+                      | ( disjunctive[ id ] ? 1 : 0 ) );
+      os.writeVarint( feature_offset[ id + 1 ] - feature_offset[ id ] );
+    }
+    if ( ReferenceProbability && num_nodes > 0 ) os.writeBlock( &reference_prob[ 0 ], num_nodes );
+    EventTreeNodeID prev = 0;
+    for ( std::vector< EventTreeNodeID >::const_iterator it = daughter_index.begin();
+          it != daughter_index.end();
+          ++it ) {
+      os.writeSignedVarint( static_cast< long >( *it ) - static_cast< long >( prev ) );
+      prev = *it;
+    }
+    if ( ! feature_run.empty() ) writeFeatures( os, &feature_run[ 0 ], feature_run.size() );
+  }
+  void readCompactNodes( objstream& is ) {
+    EventTreeNodeID num_nodes = static_cast< EventTreeNodeID >( is.readVarint() );
+    if ( ! is ) return;
+    disjunctive.resize( num_nodes );
+    daughter_offset.resize( num_nodes + 1 );
+    feature_offset.resize( num_nodes + 1 );
+    reference_prob.resize( ReferenceProbability ? num_nodes : 0 );
+    for ( EventTreeNodeID id = 0; id < num_nodes; ++id ) {
+      size_t d = is.readVarint();
+      disjunctive[ id ] = ( d & 1 ) != 0;
+      daughter_offset[ id + 1 ] = daughter_offset[ id ] + static_cast< EventTreeNodeID >( d >> 1 );
+      feature_offset[ id + 1 ] = feature_offset[ id ] + is.readVarint();
+    }
+    if ( ReferenceProbability && num_nodes > 0 ) is.readBlock( &reference_prob[ 0 ], num_nodes );
+    if ( ! is ) return;
+    daughter_index.resize( daughter_offset.back() );
+    long prev = 0;
+    for ( std::vector< EventTreeNodeID >::iterator it = daughter_index.begin();
+          it != daughter_index.end();
+          ++it ) {
+      prev += is.readSignedVarint();
+      *it = static_cast< EventTreeNodeID >( prev );
+    }
+    feature_run.resize( feature_offset.back() );
+    if ( ! feature_run.empty() ) readFeatures( is, &feature_run[ 0 ], feature_run.size() );
+  }
+
 public:
+  /// Write the event; each of the node arrays is written in one block
   void writeObject( objstream& os ) const {
-    os << freq_count;
+    writeFrequency( os );
     observed_feature_list.writeObject( os );
-    os << static_cast< EventTreeNodeID >( node_list.size() );
-    for ( typename std::vector< EventTreeNode< Feature > >::const_iterator it = node_list.begin();
-          it != node_list.end();
-          ++it ) {
-      it->writeObject( os );
+    EventTreeNodeID num_nodes = numEventTreeNodes();
+    if ( os.isCompact() ) {
+      writeCompactNodes( os );
+      return;
     }
+    os << num_nodes;
+    // std::vector< bool > is not contiguous
+    if ( num_nodes > 0 ) {
+      std::vector< char > disj( disjunctive.begin(), disjunctive.end() );
+      os.writeBlock( &disj[ 0 ], num_nodes );
+      os.writeBlock( &daughter_offset[ 1 ], num_nodes );
+      os.writeBlock( &feature_offset[ 1 ], num_nodes );
+      if ( ReferenceProbability ) os.writeBlock( &reference_prob[ 0 ], num_nodes );
+    }
+    if ( ! daughter_index.empty() ) os.writeBlock( &daughter_index[ 0 ], daughter_index.size() );
+    if ( ! feature_run.empty() ) os.writeBlock( &feature_run[ 0 ], feature_run.size() );
   }
   void readObject( objstream& is ) {
-    is >> freq_count;
+    readFrequency( is );
     observed_feature_list.readObject( is );
-    EventTreeNodeID max;
-    is >> max;
-    node_list.resize( max );
-    for ( typename std::vector< EventTreeNode< Feature > >::iterator it = node_list.begin();
-          it != node_list.end();
-          ++it ) {
-      it->readObject( is );
+    if ( is.isCompact() ) {
+      readCompactNodes( is );
+      return;
+    }
+    EventTreeNodeID num_nodes = 0;
+    is >> num_nodes;
+    if ( ! is ) return;
+    std::vector< char > disj( num_nodes );
+    daughter_offset.resize( num_nodes + 1 );
+    feature_offset.resize( num_nodes + 1 );
+    reference_prob.resize( ReferenceProbability ? num_nodes : 0 );
+    if ( num_nodes > 0 ) {
+      is.readBlock( &disj[ 0 ], num_nodes );
+      is.readBlock( &daughter_offset[ 1 ], num_nodes );
+      is.readBlock( &feature_offset[ 1 ], num_nodes );
+      if ( ReferenceProbability ) is.readBlock( &reference_prob[ 0 ], num_nodes );
     }
+    if ( ! is ) return;
+    disjunctive.assign( disj.begin(), disj.end() );
+    daughter_index.resize( daughter_offset.back() );
+    if ( ! daughter_index.empty() ) is.readBlock( &daughter_index[ 0 ], daughter_index.size() );
+    feature_run.resize( feature_offset.back() );
+    if ( ! feature_run.empty() ) is.readBlock( &feature_run[ 0 ], feature_run.size() );
   }
 };
 
@@ -107,6 +107,23 @@ public:
   {
     os << feature_id;
   }
+
+  /// Write n features in the compact encoding (differences of IDs only)
+  static void writeCompact( objstream& os, const BinaryFeature* p, size_t n ) {
+    FeatureID prev = 0;
+    for ( const BinaryFeature* f = p; f != p + n; ++f ) {
+      os.writeSignedVarint( static_cast< long >( f->feature_id ) - static_cast< long >( prev ) );
+      prev = f->feature_id;
+    }
+  }
+  /// Read n features written by writeCompact
+  static void readCompact( objstream& is, BinaryFeature* p, size_t n ) {
+    long prev = 0;
+    for ( BinaryFeature* f = p; f != p + n; ++f ) {
+      prev += is.readSignedVarint();
+      f->feature_id = static_cast< FeatureID >( prev );
+    }
+  }
   
   /// comparator for sorting
   bool operator<(const BinaryFeature& f) const {
@@ -175,6 +192,25 @@ public:
     os << feature_id;
     os << feature_freq;
   }
+
+  /// Write n features in the compact encoding (differences of IDs and variable-length frequencies)
+  static void writeCompact( objstream& os, const IntegerFeature* p, size_t n ) {
+    FeatureID prev = 0;
+    for ( const IntegerFeature* f = p; f != p + n; ++f ) {
+      os.writeSignedVarint( static_cast< long >( f->feature_id ) - static_cast< long >( prev ) );
+      os.writeSignedVarint( f->feature_freq );
+      prev = f->feature_id;
+    }
+  }
+  /// Read n features written by writeCompact
+  static void readCompact( objstream& is, IntegerFeature* p, size_t n ) {
+    long prev = 0;
+    for ( IntegerFeature* f = p; f != p + n; ++f ) {
+      prev += is.readSignedVarint();
+      f->feature_id = static_cast< FeatureID >( prev );
+      f->feature_freq = static_cast< FeatureFreq >( is.readSignedVarint() );
+    }
+  }
   
   /// comparator for sorting
   bool operator<(const IntegerFeature& f) const {
@@ -246,6 +282,25 @@ public:
     os << feature_id;
     os << feature_freq;
   }
+
+  /// Write n features in the compact encoding (differences of IDs and frequencies)
+  static void writeCompact( objstream& os, const RealFeature* p, size_t n ) {
+    FeatureID prev = 0;
+    for ( const RealFeature* f = p; f != p + n; ++f ) {
+      os.writeSignedVarint( static_cast< long >( f->feature_id ) - static_cast< long >( prev ) );
+      os << f->feature_freq;
+      prev = f->feature_id;
+    }
+  }
+  /// Read n features written by writeCompact
+  static void readCompact( objstream& is, RealFeature* p, size_t n ) {
+    long prev = 0;
+    for ( RealFeature* f = p; f != p + n; ++f ) {
+      prev += is.readSignedVarint();
+      f->feature_id = static_cast< FeatureID >( prev );
+      is >> f->feature_freq;
+    }
+  }
   
   /// comparator for sorting
   bool operator<(const RealFeature& f) const {
@@ -253,6 +308,28 @@ public:
   }
 };
 
+//////////////////////////////////////////////////////////////////////
+
+/// Write n features in the encoding of the stream
+template < class Feature >
+inline void writeFeatures( objstream& os, const Feature* p, size_t n ) {
+  if ( os.isCompact() ) {
+    Feature::writeCompact( os, p, n );
+  } else {
+    os.writeBlock( p, n );
+  }
+}
+
+/// Read n features written by writeFeatures
+template < class Feature >
+inline void readFeatures( objstream& is, Feature* p, size_t n ) {
+  if ( is.isCompact() ) {
+    Feature::readCompact( is, p, n );
+  } else {
+    is.readBlock( p, n );
+  }
+}
+
 AMIS_NAMESPACE_END
 
 #endif // Feature_h_
@@ -18,6 +18,7 @@
 #include <amis/Feature.h>
 #include <amis/objstream.h>
 #include <amis/Array.h>
+#include <amis/EventArena.h>
 
 #include <vector>
 #include <algorithm>
@@ -54,6 +55,9 @@ private:
   
   Real prob;  // reference probability
 
+  /// How the probability is given in the compact encoding
+  enum { PROB_ONE = 0, PROB_ZERO = 1, PROB_WRITTEN = 2 };
+
 public:
   typedef typename Array< Feature >::const_iterator const_iterator;
  
@@ -107,6 +111,16 @@ public:
     std::swap( prob, fl.prob );
   }
   
+  /// Copy x into this list, placing the features in an arena.
+  /// This list itself must be placed in the same arena.
+  void copyToArena( const FeatureList< Feature >& x, EventArena& arena ) {
+    count = x.count;
+    prob = x.prob;
+    Feature* p = arena.allocate< Feature >( x.size() );
+    std::uninitialized_copy( x.begin(), x.end(), p );
+    features.attach( p, p + x.size() );
+  }
+
   FeatureFreq featureCount() const {
     return count;
   }
@@ -123,14 +137,41 @@ public:
   }
 
 public:
+  /// Read a list written by writeObject
   void readObject( objstream& is ) {
-    //if ( features != NULL ) deallocate( features, tail - features );
+    if ( is.isCompact() ) {
+      size_t header = is.readVarint();
+      if ( ! is ) return;
+      features.resize( header >> 2 );
+      readFeatures( is, features.begin(), features.size() );
+      count = 0;
+      for ( const_iterator it = begin(); it != end(); ++it ) {
+        count += it->freq();
+      }
+      switch ( header & 3 ) {
+      case PROB_ONE: prob = 1.0; break;
+      case PROB_ZERO: prob = 0.0; break;
+      default: is >> prob;
+      }
+      return;
+    }
     is >> count;
     features.readObject( is );
     is >> prob;
   }
 
+  /// Write the list.  In the compact encoding, the count is not written
+  /// but recomputed, and the probability is written only when it is
+  /// neither 1 nor 0, which are the only values without reference
+  /// distributions.
   void writeObject( objstream& os ) const {
+    if ( os.isCompact() ) {
+      size_t tag = ( prob == 1.0 ? PROB_ONE : prob == 0.0 ? PROB_ZERO : PROB_WRITTEN );
+      os.writeVarint( features.size() << 2 | tag );
+      writeFeatures( os, features.begin(), features.size() );
+      if ( tag == PROB_WRITTEN ) os << prob;
+      return;
+    }
     os << count;
     features.writeObject( os );
     os << prob;
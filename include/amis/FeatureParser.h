@@ -31,17 +31,16 @@ class FeatureParser {
 public:
   typedef typename Feature::FeatureFreq FeatureFreq;
 
-private:
-  mutable std::string feature;
-  mutable FeatureFreq freq;
-
 public:
-  bool inputFeature( Tokenizer& t, std::string& name, FeatureFreq& freq ) const
+  bool inputFeature( Tokenizer& t, const char*& name, size_t& size, std::string& buf, FeatureFreq& freq ) const
   {
     AMIS_PROF2( "FeatureParser::inputFeature" );
-    if ( t.nextToken( name, ":" ) ) {
+    if ( t.nextToken( name, size, ":" ) ) {
       if ( t.currentDelimiter() == ':' ) {
         AMIS_PROF2( "FeatureParser::inputFeature::extractFreq" );
+        // the next token may move the buffer of the tokenizer under the name
+        buf.assign( name, size );
+        name = buf.data();
         if ( ! t.nextToken( freq ) ) {
           throw IllegalFeatureError( "Cannot read feature frequency" );
         }
@@ -58,16 +57,35 @@ public:
       return false;
     }
   }
+  /// Input a feature without copying its name.  The name points into
+  /// the tokenizer and is valid until its next call, or into buf when a
+  /// frequency follows it.
+
+  bool inputFeature( Tokenizer& t, std::string& name, FeatureFreq& freq ) const
+  {
+    const char* p;
+    size_t size;
+    if ( inputFeature( t, p, size, name, freq ) ) {
+      if ( p != name.data() ) name.assign( p, size );
+      return true;
+    }
+    return false;
+  }
   /// Input a feature
 
+  /// Input a feature list.  The parser has no state, so several
+  /// threads may use it at once with their own tokenizers.
   void inputFeatureList( NameTable& table, Tokenizer& t, std::vector< Feature >& fl ) const {
     AMIS_PROF2( "FeatureParser::inputFeatureList" );
-    while ( inputFeature( t, feature, freq ) ) {
+    const char* feature;
+    size_t size;
+    std::string buf;
+    FeatureFreq freq;
+    while ( inputFeature( t, feature, size, buf, freq ) ) {
       AMIS_PROF2( "FeatureParser::inputFeatureList::push_back" );
-      fl.push_back( Feature( table.featureID( feature ), freq ) );
+      fl.push_back( Feature( table.featureID( feature, size ), freq ) );
     }
   }
-  /// Input a feature list
 };
 
 AMIS_NAMESPACE_END
@@ -17,6 +17,8 @@
 #include <amis/FixWeightAccumulator.h>
 #include <amis/Event.h>
 
+#include <algorithm>
+
 
 AMIS_NAMESPACE_BEGIN
 
@@ -32,12 +34,154 @@ AMIS_NAMESPACE_BEGIN
 
 template<class Feature, class ParameterValue, bool ReferenceProbability>
 class FixWeightAccumulator : public WeightAccumulator {
+  /// Weights of the features laid out as FixedTarget::denseFeatures(),
+  /// computed by prepare() and shared by an accumulator and its clones
+  struct DenseWeights {
+    std::vector<Real> weight;
+    bool ready;
+    DenseWeights() : ready(false) {}
+  };
   const FixedTarget& fixed_target;
+  const RestrictedTarget& restricted_target;
+  DenseWeights* dense;
+  bool owns_dense;
+  /// Unnormalized probabilities of the targets of an event (scratch)
+  std::vector<ParameterValue> prod;
+  /// Weights of the targets of an event in the dense path (scratch)
+  std::vector<Real> target_alpha;
+  /// A restricted event is scored over the targets of its group: the
+  /// (position in the group, feature) pairs of its histories, the start
+  /// of each history in them, and the position of each target in the
+  /// group plus one (scratch, zero except while they are collected)
+  std::vector<FixedTarget::TargetFeature> restricted_features;
+  std::vector<size_t> restricted_offset;
+  std::vector<size_t> local_target;
+  /// Position of the observed target among the targets of the current event
+  size_t observed_target;
+
+  FixWeightAccumulator(const FixedTarget& ft, const RestrictedTarget& rt, DenseWeights* d)
+    : fixed_target(ft), restricted_target(rt), dense(d), owns_dense(false), observed_target(0)
+  { }
+  FixWeightAccumulator(const FixWeightAccumulator&);
+  FixWeightAccumulator& operator=(const FixWeightAccumulator&);
+
 public:
   typedef EventFix<Feature, ReferenceProbability> EventType;
-  FixWeightAccumulator(const FixedTarget& ft)
-    : fixed_target(ft)
+  FixWeightAccumulator(const FixedTarget& ft, const RestrictedTarget& rt)
+    : fixed_target(ft), restricted_target(rt), dense(new DenseWeights), owns_dense(true), observed_target(0)
   { }
+  virtual ~FixWeightAccumulator()
+  {
+    if ( owns_dense ) delete dense;
+  }
+
+  WeightAccumulator* clone() const
+  {
+    return new FixWeightAccumulator<Feature, ParameterValue, ReferenceProbability>(fixed_target, restricted_target, dense);
+  }
+
+  /// Lay out the current weights as the dense map of fixed_target, if any
+  void prepare(const ModelBase& model)
+  {
+    dense->ready = false;
+    if ( ! ParameterValue::HAS_DENSE_EXPONENT || ! fixed_target.hasDenseTargets()
+	 || fixed_target.numHistories() == 0 ) return;
+    const ParameterSpace<ParameterValue>* parameterspace =
+      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace());
+    if ( parameterspace == NULL ) return;
+    size_t size = fixed_target.numHistories() * fixed_target.numTargets();
+    const FeatureID* features = fixed_target.denseFeatures( 0 );
+    dense->weight.resize( size );
+    for ( size_t i = 0; i < size; ++i ) {
+      dense->weight[ i ] = ( features[ i ] == UNKNOWN_FEATURE_ID
+			     ? ParameterValue::denseIdentity()
+			     : ParameterValue::denseWeight( parameterspace->getParameters()[ features[ i ] ] ) );
+    }
+    dense->ready = true;
+  }
+
+  /// Start scoring an event; returns the number of its targets and
+  /// sets observed_target
+  size_t beginEvent(const EventType& event)
+  {
+    if ( ! event.isRestricted() ) {
+      observed_target = event.observedEventID();
+      return fixed_target.numTargets();
+    }
+    // events read from a cache keep the group IDs of the run that wrote it
+    FeatureID gid = event.restrictionID();
+    if ( gid >= restricted_target.numGroups()
+	 || event.numTargets() != restricted_target.numTargets( gid )
+	 || ! restricted_target.validate( gid, event.observedEventID() ) ) {
+      OStringStream oss;
+      oss << "AmisFix event does not match group " << gid << " of the restriction files";
+      throw WeightAccumulatorError( oss.str() );
+    }
+    const FeatureID* targets = restricted_target.targets( gid );
+    size_t n = restricted_target.numTargets( gid );
+    growScratch(local_target, fixed_target.numTargets());
+    for ( size_t i = 0; i < n; ++i ) {
+      local_target[ targets[ i ] ] = i + 1;
+    }
+    observed_target = local_target[ event.observedEventID() ] - 1;
+    restricted_features.clear();
+    restricted_offset.assign( 1, 0 );
+    const FeatureList<Feature>& hist_list = event.getHistoryList();
+    for( typename FeatureList<Feature>::const_iterator itr = hist_list.begin();
+	 itr != hist_list.end();
+	 ++itr ) {
+      FixedTarget::FeatureRange fv =
+	fixed_target.getFeatures( itr->id() );
+      for ( FixedTarget::FeatureRange::const_iterator it = fv.begin();
+	    it != fv.end();
+	    ++it ) {
+	size_t local = local_target[ it->first ];
+	if ( local > 0 ) {
+	  restricted_features.push_back( FixedTarget::TargetFeature( local - 1, it->second ) );
+	}
+      }
+      restricted_offset.push_back( restricted_features.size() );
+    }
+    for ( size_t i = 0; i < n; ++i ) {
+      local_target[ targets[ i ] ] = 0;
+    }
+    return n;
+  }
+
+  /// The (target, feature) pairs of the i-th history of the event last
+  /// given to beginEvent(); targets are positions in the group if the
+  /// event is restricted
+  FixedTarget::FeatureRange historyTargets(const EventType& event, size_t i, FeatureID hid) const
+  {
+    if ( ! event.isRestricted() ) {
+      return fixed_target.getFeatures( hid );
+    }
+    const FixedTarget::TargetFeature* base = restricted_features.empty() ? NULL : &restricted_features[ 0 ];
+    return FixedTarget::FeatureRange( base + restricted_offset[ i ], base + restricted_offset[ i + 1 ] );
+  }
+
+  void collectFeatures(const EventBase& event_base,
+		       std::vector<FeatureID>& features) const
+  {
+    const EventType& event =
+      dynamic_cast<const EventType&>(event_base);
+    const FeatureList<Feature>& hist_list  = event.getHistoryList();
+    // a restricted event scores only the features of the targets in its group
+    FeatureID gid = event.restrictionID();
+    for( typename FeatureList<Feature>::const_iterator itr = hist_list.begin();
+	 itr != hist_list.end();
+	 ++itr ) {
+      FixedTarget::FeatureRange fv =
+	fixed_target.getFeatures( itr->id() );
+      for ( FixedTarget::FeatureRange::const_iterator it = fv.begin();
+	    it != fv.end();
+	    ++it ) {
+	if ( ! event.isRestricted() || restricted_target.validate( gid, it->first ) ) {
+	  features.push_back(it->second);
+	}
+      }
+    }
+  }
 
   void empiricalCount(std::vector<Real>& ee,
 		      const EventBase& event_base,
@@ -60,29 +204,53 @@ public:
 		  Real event_empirical_expectation,
 		  const ModelBase& model)
   {
-    const EventType& event =
-      dynamic_cast<const EventType&>(event_base);
-    const ParameterSpace<ParameterValue>* parameterspace =
-      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace());
+    return modelCount(me,
+		      dynamic_cast<const EventType&>(event_base),
+		      event_empirical_expectation,
+		      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace()));
+  }
 
-    size_t n = fixed_target.numTargets();
+  Real modelCountRange(std::vector<Real>& me,
+		       const EventBase* const* events,
+		       size_t num_events,
+		       Real event_empirical_expectation,
+		       const ModelBase& model)
+  {
+    if ( dense->ready ) {
+      return denseModelCountRange(me, events, num_events, event_empirical_expectation,
+				  dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace()));
+    }
+    return modelCountEach<EventType, ParameterValue>(*this, me, events, num_events,
+						     event_empirical_expectation, model);
+  }
 
-    std::vector<ParameterValue> prod(n);
+  /// Model expectation of an event of the concrete type
+  Real modelCount(std::vector<Real>& me,
+		  const EventType& event,
+		  Real event_empirical_expectation,
+		  const ParameterSpace<ParameterValue>* parameterspace)
+  {
+
+    size_t n = beginEvent(event);
+
+    growScratch(prod, n);
+    std::fill(prod.begin(), prod.begin() + n, ParameterValue());
     Real sum = 0.0;
     Real ref_sum = 0.0;
     const FeatureList<Feature>& hist_list  = event.getHistoryList();
 
+    size_t h = 0;
     for( typename FeatureList<Feature>::const_iterator itr = hist_list.begin();
          itr != hist_list.end();
-         ++itr ) {
+         ++itr, ++h ) {
       FeatureID hid = itr->id();
       typename Feature::FeatureFreq freq = itr->freq();
-      const std::vector< std::pair<FeatureID, FeatureID> >& fv =
-	fixed_target.getFeatures( hid );
+      FixedTarget::FeatureRange fv =
+	historyTargets( event, h, hid );
 
       ParameterValue::exponent_fix( parameterspace->getParameters(), fv, freq, prod);
     }
-    ParameterValue::scale_prob( prod.begin(), prod.end());
+    ParameterValue::scale_prob( prod.begin(), prod.begin() + n);
     
     for ( size_t i = 0; i < n; ++i ) {
       if ( ReferenceProbability ) {
@@ -103,14 +271,15 @@ public:
     if ( sum != 0.0 ) {
       Real inv_sum = 1.0 / sum;
       Real denom = event.eventFrequency() * inv_sum * event_empirical_expectation;
+      h = 0;
       for( typename FeatureList<Feature>::const_iterator itr = hist_list.begin();
 	   itr != hist_list.end();
-	   ++itr ) {
+	   ++itr, ++h ) {
 	FeatureID hid = itr->id();
 	typename Feature::FeatureFreq freq = itr->freq();
-	const std::vector< std::pair<FeatureID, FeatureID> >& fv =
-	  fixed_target.getFeatures( hid );
-	for ( std::vector< std::pair<FeatureID, FeatureID> >::const_iterator it = fv.begin();
+	FixedTarget::FeatureRange fv =
+	  historyTargets( event, h, hid );
+	for ( FixedTarget::FeatureRange::const_iterator it = fv.begin();
 	      it != fv.end();
 	      ++it ) {
 	  me[it->second] +=
@@ -121,7 +290,7 @@ public:
       Real ret =
 	event.eventProbability() *
 	event.eventFrequency() * event_empirical_expectation *
-        ModelBase::safe_log( prod[event.observedEventID()].getAlpha() * inv_sum * event.eventProbability() );
+        ModelBase::safe_log( prod[observed_target].getAlpha() * inv_sum * event.eventProbability() );
       return ret;
     }
     else {
@@ -133,6 +302,73 @@ public:
 
 
 
+  /// modelCountRange() over the dense weights: the targets of an event
+  /// are scored by one contiguous loop per history, and the
+  /// expectations are added through the sparse rows as in modelCount();
+  /// restricted events are left to modelCount()
+  Real denseModelCountRange(std::vector<Real>& me,
+			    const EventBase* const* events,
+			    size_t num_events,
+			    Real event_empirical_expectation,
+			    const ParameterSpace<ParameterValue>* parameterspace)
+  {
+    size_t n = fixed_target.numTargets();
+    if ( n == 0 ) return 0.0;
+    growScratch(prod, n);
+    growScratch(target_alpha, n);
+    Real log_likelihood = 0.0;
+    for ( size_t i = 0; i < num_events; ++i ) {
+      const EventType& event = static_cast<const EventType&>(*events[i]);
+      if ( event.isRestricted() ) {
+	log_likelihood += modelCount(me, event, event_empirical_expectation, parameterspace);
+	continue;
+      }
+      const FeatureList<Feature>& hist_list = event.getHistoryList();
+
+      std::fill(prod.begin(), prod.begin() + n, ParameterValue());
+      for( typename FeatureList<Feature>::const_iterator itr = hist_list.begin();
+	   itr != hist_list.end();
+	   ++itr ) {
+	ParameterValue::exponent_dense( &dense->weight[ itr->id() * n ], itr->freq(), &prod[0], n );
+      }
+      ParameterValue::scale_prob( prod.begin(), prod.begin() + n);
+
+      Real sum = 0.0;
+      for ( size_t t = 0; t < n; ++t ) {
+	if ( ReferenceProbability ) {
+	  prod[ t ] *= event.referenceProbability( t );
+	}
+	target_alpha[ t ] = prod[ t ].getAlpha();
+	sum += target_alpha[ t ];
+      }
+      if( !finite(sum) ){
+	this->incIgnored();
+	continue;
+      }
+      if ( sum == 0.0 ) continue;
+
+      Real inv_sum = 1.0 / sum;
+      Real denom = event.eventFrequency() * inv_sum * event_empirical_expectation;
+      for( typename FeatureList<Feature>::const_iterator itr = hist_list.begin();
+	   itr != hist_list.end();
+	   ++itr ) {
+	Real c = itr->freq() * denom;
+	FixedTarget::FeatureRange fv =
+	  fixed_target.getFeatures( itr->id() );
+	for ( FixedTarget::FeatureRange::const_iterator it = fv.begin();
+	      it != fv.end();
+	      ++it ) {
+	  me[it->second] += c * target_alpha[it->first];
+	}
+      }
+      log_likelihood +=
+	event.eventProbability() *
+	event.eventFrequency() * event_empirical_expectation *
+	ModelBase::safe_log( target_alpha[event.observedEventID()] * inv_sum * event.eventProbability() );
+    }
+    return log_likelihood;
+  }
+
   void perceptronUpdate(const EventBase& event_base,
 			Real step_size,
 			int iteration,
@@ -144,20 +380,22 @@ public:
     const ParameterSpace<ParameterValue>* parameterspace =
       dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace());
 
-    size_t n = fixed_target.numTargets();
+    size_t n = beginEvent(event);
 
-    std::vector<ParameterValue> prod(n);
+    growScratch(prod, n);
+    std::fill(prod.begin(), prod.begin() + n, ParameterValue());
     Real sum = 0.0;
     Real ref_sum = 0.0;
     const FeatureList<Feature>& hist_list  = event.getHistoryList();
 
+    size_t h = 0;
     for( typename FeatureList<Feature>::const_iterator itr = hist_list.begin();
          itr != hist_list.end();
-         ++itr ) {
+         ++itr, ++h ) {
       FeatureID hid = itr->id();
       typename Feature::FeatureFreq freq = itr->freq();
-      const std::vector< std::pair<FeatureID, FeatureID> >& fv =
-	fixed_target.getFeatures( hid );
+      FixedTarget::FeatureRange fv =
+	historyTargets( event, h, hid );
 
       ParameterValue::exponent_fix( parameterspace->getParameters(), fv, freq, prod);
     }
@@ -191,14 +429,15 @@ public:
       return;
     }
 
+    h = 0;
     for( typename FeatureList<Feature>::const_iterator itr = hist_list.begin();
 	 itr != hist_list.end();
-	 ++itr ) {
+	 ++itr, ++h ) {
       FeatureID hid = itr->id();
       typename Feature::FeatureFreq freq = itr->freq();
-      const std::vector< std::pair<FeatureID, FeatureID> >& fv =
-	fixed_target.getFeatures( hid );
-      for ( std::vector< std::pair<FeatureID, FeatureID> >::const_iterator it = fv.begin();
+      FixedTarget::FeatureRange fv =
+	historyTargets( event, h, hid );
+      for ( FixedTarget::FeatureRange::const_iterator it = fv.begin();
 	    it != fv.end();
 	    ++it ) {
 	if ( it->first == max_target ) {
@@ -16,6 +16,9 @@
 #include <amis/configure.h>
 #include <amis/Feature.h>
 #include <amis/ErrorBase.h>
+#include <amis/StringHash.h>
+#include <amis/StringStream.h>
+#include <string>
 #include <vector>
 #include <map>
 #include <utility>
@@ -30,69 +33,114 @@ class IllegalFixedTargetError : public ErrorBase {
   IllegalFixedTargetError( const char* s ) : ErrorBase( s ) {}
 };
 
+/**
+ * Mapping from pairs of a history and a target to features, used by
+ * AmisFix and AmisCRF.
+ *
+ * The features of the histories are kept in compressed sparse row
+ * form: one array of (target, feature) pairs ordered by history, and
+ * the offset of each history in it.  A fixmap lists the pairs of a
+ * history just after the history, so addFeatureMap() usually appends.
+ *
+ * When most of the targets have a feature with each history, the map
+ * can also be laid out densely (see buildDenseTargets()): a
+ * numHistories() x numTargets() matrix of feature IDs, with
+ * UNKNOWN_FEATURE_ID for the pairs without a feature.
+ */
+
 class FixedTarget {
+public:
+  /// A target and the feature that the target fires with a history
+  typedef std::pair< FeatureID, FeatureID > TargetFeature;
+
+  /// The (target, feature) pairs of a history
+  class FeatureRange {
+  public:
+    typedef const TargetFeature* const_iterator;
+  private:
+    const_iterator first;
+    const_iterator last;
+  public:
+    FeatureRange( const_iterator f, const_iterator l ) : first( f ), last( l ) {}
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    const TargetFeature& operator[]( size_t i ) const { return first[ i ]; }
+  };
+
 private:
-  
-  typedef std::map< FeatureID, std::string > NameMap;
-  typedef std::map< std::string, FeatureID > IDMap;
+  typedef StringIndex< FeatureID > IDMap;
 
-  NameMap target_name;
+  std::vector< std::string > target_name;
   IDMap target_id;
-  NameMap history_name;
+  std::vector< char > history_name;             // names of the histories, concatenated
+  std::vector< size_t > history_name_offset;    // start of each name in history_name
   IDMap history_id;
 
   size_t num_targets;
-  
-  std::vector< std::vector< std::pair< FeatureID, FeatureID > > > feature_map;
-  
-  std::map< std::pair< FeatureID, FeatureID>, FeatureID > feature_map2;
-  
-  std::map< FeatureID, std::pair< FeatureID, FeatureID> > feature_map3;
-  
+
+  std::vector< size_t > history_offset;         // start of each history in target_features
+  std::vector< TargetFeature > target_features;
+
+  std::vector< std::pair< FeatureID, FeatureID > > feature_owner;  // feature -> ( history, target )
+
+  std::vector< FeatureID > dense_features;      // history x target -> feature, if laid out densely
+
 public:
   FixedTarget() {
     num_targets = 0;
+    history_offset.push_back( 0 );
+    history_name_offset.push_back( 0 );
   }
   virtual ~FixedTarget() {}
 
   FeatureID registerNewTarget( const std::string& name ) {
-    FeatureID id = newTarget();
-    if ( target_id.find( name ) != target_id.end() ) {
+    FeatureID id = num_targets;
+    if ( ! target_id.insert( name, id ) ) {
       OStringStream oss;
       oss << "Target " << name << " already exists";
       throw IllegalFeatureError( oss.str() );
     }
-    target_name[ id ] = name;
-    target_id[ name ] = id;
+    newTarget();
+    target_name.push_back( name );
     return id;
   }
 
   FeatureID registerNewHistory( const std::string& name ) {
-    FeatureID id = newHistory();
-    if ( history_id.find( name ) != history_id.end() ) {
+    FeatureID id = numHistories();
+    if ( ! history_id.insert( name, id ) ) {
       OStringStream oss;
       oss << "History " << name << " already exists";
       throw IllegalFeatureError( oss.str() );
     }
-    history_name[ id ] = name;
-    history_id[ name ] = id;
+    newHistory();
+    history_name.insert( history_name.end(), name.begin(), name.end() );
+    history_name_offset.push_back( history_name.size() );
     return id;
   }
   
   void empty() {
-   feature_map.clear();
-   feature_map2.clear();
-   feature_map3.clear();
+   target_name.clear();
+   target_id.clear();
+   history_name.clear();
+   history_name_offset.assign( 1, 0 );
+   history_id.clear();
+   history_offset.assign( 1, 0 );
+   target_features.clear();
+   feature_owner.clear();
+   dense_features.clear();
    num_targets = 0;
   }
   
-  const std::vector< std::pair< FeatureID, FeatureID > >& getFeatures( FeatureID i ) const {
-    assert( i < feature_map.size() );
-    return feature_map[ i ];
+  FeatureRange getFeatures( FeatureID i ) const {
+    assert( i < numHistories() );
+    const TargetFeature* base = target_features.empty() ? NULL : &target_features[ 0 ];
+    return FeatureRange( base + history_offset[ i ], base + history_offset[ i + 1 ] );
   }
 
   void addFeatureMap( FeatureID hid, FeatureID tid, FeatureID fid ) {
-    if ( hid >= feature_map.size() ) {
+    if ( hid >= numHistories() ) {
       OStringStream oss;
       oss << "addFeatureMap() history: " << hid << " is not registered.";
       throw IllegalFixedTargetError( oss.str() );
@@ -103,98 +151,175 @@ public:
       throw IllegalFixedTargetError( oss.str() ); 
     }
     
-    std::pair< FeatureID, FeatureID > p( tid, fid );
-    feature_map[ hid ].push_back( p );
-    feature_map2[ std::pair< FeatureID, FeatureID >( hid, tid) ] = fid;
-    feature_map3[ fid ] = std::pair< FeatureID, FeatureID >( hid, tid );
+    clearDenseTargets();
+    TargetFeature p( tid, fid );
+    if ( hid + 1 == numHistories() ) {
+      target_features.push_back( p );
+    } else {
+      // a history other than the last one; shift the following histories
+      target_features.insert( target_features.begin() + history_offset[ hid + 1 ], p );
+      for ( size_t h = hid + 1; h < numHistories(); ++h ) ++history_offset[ h ];
+    }
+    ++history_offset.back();
+    if ( fid >= feature_owner.size() ) {
+      feature_owner.resize( fid + 1, std::pair< FeatureID, FeatureID >( UNKNOWN_FEATURE_ID, UNKNOWN_FEATURE_ID ) );
+    }
+    feature_owner[ fid ] = std::pair< FeatureID, FeatureID >( hid, tid );
   }
 
   size_t numTargets() const { return num_targets; }
-  size_t numHistories() const { return feature_map.size(); }
+  size_t numHistories() const { return history_offset.size() - 1; }
+
+  /// The ratio of the (history, target) pairs that have a feature
+  double density() const {
+    if ( numHistories() == 0 || num_targets == 0 ) return 0.0;
+    return static_cast< double >( target_features.size() ) / ( static_cast< double >( numHistories() ) * num_targets );
+  }
+
+  /// Lay out the map densely in addition to the sparse rows; fails
+  /// (and leaves the map sparse) if a pair has more than one feature
+  bool buildDenseTargets() {
+    dense_features.assign( numHistories() * num_targets, UNKNOWN_FEATURE_ID );
+    for ( size_t hid = 0; hid < numHistories(); ++hid ) {
+      FeatureID* row = &dense_features[ hid * num_targets ];
+      FeatureRange fv = getFeatures( hid );
+      for ( FeatureRange::const_iterator it = fv.begin(); it != fv.end(); ++it ) {
+        if ( row[ it->first ] != UNKNOWN_FEATURE_ID ) {
+          clearDenseTargets();
+          return false;
+        }
+        row[ it->first ] = it->second;
+      }
+    }
+    return true;
+  }
+
+  /// Drop the dense layout
+  void clearDenseTargets() {
+    std::vector< FeatureID >().swap( dense_features );
+  }
+
+  /// Whether the map is laid out densely
+  bool hasDenseTargets() const {
+    return ! dense_features.empty();
+  }
+
+  /// The features of a history for the targets [0, numTargets()),
+  /// valid only if hasDenseTargets()
+  const FeatureID* denseFeatures( FeatureID hid ) const {
+    assert( hasDenseTargets() && hid < numHistories() );
+    return &dense_features[ hid * num_targets ];
+  }
   
-  FeatureID newTarget()  { return num_targets++; }
+  FeatureID newTarget()  {
+    clearDenseTargets();
+    return num_targets++;
+  }
   
   FeatureID newHistory() {
+    clearDenseTargets();
     FeatureID hid = numHistories();
-    feature_map.push_back( std::vector< std::pair< FeatureID, FeatureID > >( 0 ) );
+    history_offset.push_back( history_offset.back() );
     return hid;
   }
   
   
   FeatureID featureID( FeatureID hid, FeatureID tid ) const {
-    std::map< std::pair< FeatureID, FeatureID>, FeatureID >::const_iterator itr = feature_map2.find( std::pair<FeatureID, FeatureID>( hid, tid ) );
-    if ( itr == feature_map2.end() ) {
-      OStringStream oss;
-      oss << "No feature for hid=" << hid << ", tid=" << tid;
-      throw IllegalFeatureError( oss.str() );
-    }
-    else {
-      return itr->second;
+    if ( hid < numHistories() ) {
+      // the last pair wins, as a later line of a fixmap overrides
+      FeatureRange fv = getFeatures( hid );
+      for ( size_t k = fv.size(); k > 0; --k ) {
+        if ( fv[ k - 1 ].first == tid ) return fv[ k - 1 ].second;
+      }
     }
+    OStringStream oss;
+    oss << "No feature for hid=" << hid << ", tid=" << tid;
+    throw IllegalFeatureError( oss.str() );
   }
 
   FeatureID historyID( const std::string& name ) const {
-    IDMap::const_iterator it = history_id.find( name );
-    if ( it == history_id.end() ) {
+    return historyID( name.data(), name.size() );
+  }
+  FeatureID historyID( const char* name, size_t size ) const {
+    FeatureID id;
+    if ( ! history_id.find( name, size, id ) ) {
       OStringStream oss;
-      oss << "History " << name << " not found";
+      oss << "History " << std::string( name, size ) << " not found";
       throw IllegalFeatureError( oss.str() );
     }
-    return it->second;
+    return id;
   }
 
   FeatureID targetID( const std::string& name ) const
   {
-    IDMap::const_iterator it = target_id.find( name );
-    if ( it == target_id.end() ) {
+    return targetID( name.data(), name.size() );
+  }
+  FeatureID targetID( const char* name, size_t size ) const
+  {
+    FeatureID id;
+    if ( ! target_id.find( name, size, id ) ) {
       OStringStream oss;
-      oss << "Target " << name << " not found";
+      oss << "Target " << std::string( name, size ) << " not found";
       throw IllegalFeatureError( oss.str() );
     }
-    return it->second;
+    return id;
   }
 
-  const std::string& historyName( FeatureID history_id ) const {
-    NameMap::const_iterator it = history_name.find( history_id );
-    if ( it == history_name.end() ) {
+  std::string historyName( FeatureID history_id ) const {
+    if ( history_id + 1 >= history_name_offset.size() ) {
       OStringStream oss;
       oss << "History ID " << history_id << " not found";
       throw IllegalFeatureError( oss.str() );
     }
-    return it->second;
+    return std::string( history_name.begin() + history_name_offset[ history_id ],
+                        history_name.begin() + history_name_offset[ history_id + 1 ] );
   }
 
   const std::string& targetName( FeatureID target_id ) const {
-    NameMap::const_iterator it = target_name.find( target_id );
-    if ( it == target_name.end() ) {
+    if ( target_id >= target_name.size() ) {
       OStringStream oss;
       oss << "Target ID " << target_id << " not found";
       throw IllegalFeatureError( oss.str() );
     }
-    return it->second;
+    return target_name[ target_id ];
   }
 
 
   
   const std::pair< FeatureID, FeatureID >& historyAndTargetID( FeatureID fid ) const {
-    std::map< FeatureID, std::pair< FeatureID, FeatureID> >::const_iterator itr = feature_map3.find( fid  );
-    if ( itr == feature_map3.end() ) {
+    if ( fid >= feature_owner.size() || feature_owner[ fid ].first == UNKNOWN_FEATURE_ID ) {
        OStringStream oss;
        oss << "No feature:" << fid;
        throw IllegalFeatureError( oss.str() );
     }
     else {
-      return itr->second;
+      return feature_owner[ fid ];
     }
   }
   
+  /// Write the targets and the features of the histories, which event
+  /// caches record (see EventReader::cacheSignature)
+  void writeSignature( std::ostream& os ) const {
+    for ( size_t tid = 0; tid < numTargets(); ++tid ) {
+      os << target_name[ tid ] << '\n';
+    }
+    for ( size_t hid = 0; hid < numHistories(); ++hid ) {
+      os << historyName( hid );
+      FeatureRange fv = getFeatures( hid );
+      for ( FeatureRange::const_iterator it = fv.begin(); it != fv.end(); ++it ) {
+        os << ' ' << it->first << ' ' << it->second;
+      }
+      os << '\n';
+    }
+  }
+
   public:
   // Debugging
   void debugInfo( std::ostream& ostr ) const {
     ostr << "====================\n";
-    for ( size_t hid = 0; hid < feature_map.size(); hid++ ) {
+    for ( size_t hid = 0; hid < numHistories(); hid++ ) {
       ostr << "hid=" << hid << " ";
-      const std::vector< std::pair< FeatureID, FeatureID > >& fv = getFeatures( hid );
+      FeatureRange fv = getFeatures( hid );
       for ( size_t k = 0; k < fv.size(); k++ ) {
         ostr << "[tid=" << fv[k].first << ",fid=" << fv[k].second << "] ";
       }
@@ -207,130 +332,141 @@ public:
 
 
 
-/*class RestrictedTarget {
+/**
+ * Sets of the targets allowed for AmisFix events, such as the tags of
+ * a word given by a tag dictionary.  An event refers to a group, and
+ * only the targets of the group are scored for the event.
+ *
+ * The targets of the groups are kept in compressed sparse row form as
+ * in FixedTarget.
+ */
+
+class RestrictedTarget {
 private:
-  
-  typedef std::map< FeatureID, std::string > NameMap;
-  typedef std::map< std::string, FeatureID > IDMap;
+  typedef StringIndex< FeatureID > IDMap;
 
-  NameMap group_name;
+  std::vector< std::string > group_name;
   IDMap group_id;
-  FeatureID num_groups;
 
-  std::vector< std::vector<FeatureID> > restriction;
+  std::vector< size_t > group_offset;           // start of each group in group_targets
+  std::vector< FeatureID > group_targets;
+
 public:
-  RestrictedTarget()
-  {
-    num_groups = 0;
+  RestrictedTarget() {
+    group_offset.push_back( 0 );
   }
   virtual ~RestrictedTarget() {}
 
-
-  FeatureID registerNewGroup( const std::string& name )
-  {
-    FeatureID id = newGroup();
-    if ( group_id.find( name ) != group_id.end() ) {
+  FeatureID registerNewGroup( const std::string& name ) {
+    FeatureID id = numGroups();
+    if ( ! group_id.insert( name, id ) ) {
       OStringStream oss;
-      oss << "Target " << name << " already exists";
+      oss << "Group " << name << " already exists";
       throw IllegalFeatureError( oss.str() );
     }
-    group_name[id] = name;
-    group_id[name] = id;
+    group_name.push_back( name );
+    group_offset.push_back( group_offset.back() );
     return id;
   }
 
   void empty() {
     group_name.clear();
     group_id.clear();
-    restriction.clear();
-    num_groups = 0;
+    group_offset.assign( 1, 0 );
+    group_targets.clear();
   }
   
-  void addRestriction( FixedTarget& fixed_target,
-		       FeatureID gid, FeatureID tid )
-  {
-    if ( gid >= group_name.size() ) {
+  void addRestriction( const FixedTarget& fixed_target,
+		       FeatureID gid, FeatureID tid ) {
+    if ( gid >= numGroups() ) {
       OStringStream oss;
-      oss << "addResriction() group: " << gid << " is not registered.";
+      oss << "addRestriction() group: " << gid << " is not registered.";
       throw IllegalFixedTargetError( oss.str() );
     }
     if ( tid >= fixed_target.numTargets() ) {
       OStringStream oss;
-      oss << "addResriction() target: " << tid << " is not registered.";
+      oss << "addRestriction() target: " << tid << " is not registered.";
       throw IllegalFixedTargetError( oss.str() ); 
     }
-
-    restriction[gid].push_back(tid);
-  }
-
-  bool validate( FeatureID gid, FeatureID tid ) const
-  {
-    if ( gid >= group_name.size() ) {
+    if ( validate( gid, tid ) ) {
       OStringStream oss;
-      oss << "addResriction() group: " << gid << " is not registered.";
+      oss << "Target " << fixed_target.targetName( tid ) << " appears twice in group " << group_name[ gid ];
       throw IllegalFixedTargetError( oss.str() );
     }
-    for ( size_t i = 0; i < restriction[gid].size(); ++i ) {
-      if ( restriction[gid][i] == tid ) return true;
+    if ( gid + 1 == numGroups() ) {
+      group_targets.push_back( tid );
+    } else {
+      group_targets.insert( group_targets.begin() + group_offset[ gid + 1 ], tid );
+      for ( size_t g = gid + 1; g < numGroups(); ++g ) ++group_offset[ g ];
     }
-    return false;
+    ++group_offset.back();
   }
 
-  const std::vector<FeatureID>& targets(FeatureID gid) const
-  {
-    return restriction[gid];
-  }
-
-  void addAllTarget(FixedTarget& fixed_target)
-  {
-    registerNewGroup("_");
-    FeatureID all_id = groupID("_");
-    for ( FeatureID id = 0; id < fixed_target.numTargets(); ++id ) {
-      addRestriction(fixed_target, all_id, id);
+  bool validate( FeatureID gid, FeatureID tid ) const {
+    assert( gid < numGroups() );
+    for ( size_t i = group_offset[ gid ]; i < group_offset[ gid + 1 ]; ++i ) {
+      if ( group_targets[ i ] == tid ) return true;
     }
+    return false;
   }
 
-  size_t numGroups() const
-  {
-    return num_groups;
+  /// The targets of a group; numTargets( gid ) of them
+  const FeatureID* targets( FeatureID gid ) const {
+    assert( gid < numGroups() );
+    return group_targets.empty() ? NULL : &group_targets[ 0 ] + group_offset[ gid ];
   }
-  
-  FeatureID newGroup()
-  {
-    ++num_groups;
-    restriction.resize(num_groups);
-    return num_groups-1;
+
+  size_t numTargets( FeatureID gid ) const {
+    assert( gid < numGroups() );
+    return group_offset[ gid + 1 ] - group_offset[ gid ];
   }
+
+  size_t numGroups() const { return group_offset.size() - 1; }
   
-  FeatureID groupID( const std::string& name ) const
-  {
-    IDMap::const_iterator it = group_id.find( name );
-    if ( it == group_id.end() ) {
+  FeatureID groupID( const std::string& name ) const {
+    FeatureID id;
+    if ( ! group_id.find( name, id ) ) {
       OStringStream oss;
       oss << "Group " << name << " not found";
       throw IllegalFeatureError( oss.str() );
     }
-    return it->second;
+    return id;
   }
 
-  const std::string& groupName( FeatureID group_id ) const
-  {
-    NameMap::const_iterator it = group_name.find( group_id );
-    if ( it == group_name.end() ) {
+  const std::string& groupName( FeatureID group_id ) const {
+    if ( group_id >= group_name.size() ) {
       OStringStream oss;
       oss << "Group ID " << group_id << " not found";
       throw IllegalFeatureError( oss.str() );
     }
-    return it->second;
+    return group_name[ group_id ];
   }
 
+  /// Write the groups and their targets, which event caches record
+  /// (see EventReader::cacheSignature)
+  void writeSignature( std::ostream& os ) const {
+    for ( size_t gid = 0; gid < numGroups(); ++gid ) {
+      os << group_name[ gid ];
+      for ( size_t i = group_offset[ gid ]; i < group_offset[ gid + 1 ]; ++i ) {
+        os << ' ' << group_targets[ i ];
+      }
+      os << '\n';
+    }
+  }
 
   public:
   // Debugging
   void debugInfo( std::ostream& ostr ) const {
-    ostr << "===========RestrictedTarget::debugInfo, not implemented=========\n";
+    ostr << "====================\n";
+    for ( size_t gid = 0; gid < numGroups(); gid++ ) {
+      ostr << "gid=" << gid << " " << group_name[ gid ];
+      for ( size_t i = group_offset[ gid ]; i < group_offset[ gid + 1 ]; i++ ) {
+        ostr << " tid=" << group_targets[ i ];
+      }
+      ostr << "\n";
+    }
   }
-  };*/
+};
 
 AMIS_NAMESPACE_END
 
@@ -0,0 +1,266 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_LogSumExp_h_
+
+#define Amis_LogSumExp_h_
+
+#include <amis/configure.h>
+#include <amis/Real.h>
+#include <amis/SparseKernel.h>
+
+#include <cmath>
+
+AMIS_NAMESPACE_BEGIN
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Batched log-sum-exp over values in log space, used by LambdaValue.
+ *
+ * In the EXACT mode (default) LambdaValue computes sums in log space
+ * one element at a time with the exp/log of the C library, as before.
+ * In the FAST mode a list of values is handled at once: the maximum is
+ * taken first, and exp and log1p are evaluated four at a time by
+ * polynomials (AVX2) with an error of a few ulps; results smaller than
+ * DBL_MIN are flushed to zero.  Without AVX2 the FAST mode falls back
+ * to the C library.
+ */
+
+class LogSumExp {
+public:
+  /// Accuracy of sums in log space
+  enum Mode { EXACT = 0, FAST = 1 };
+
+private:
+  static int& modeValue() {
+    static int m = EXACT;
+    return m;
+  }
+
+  static bool useVector( size_t n ) {
+    return n >= 4 && SparseKernel::level() != SparseKernel::SCALAR;
+  }
+
+  static bool distinct( const unsigned int* id ) {
+    return id[ 0 ] != id[ 1 ] && id[ 0 ] != id[ 2 ] && id[ 0 ] != id[ 3 ]
+      && id[ 1 ] != id[ 2 ] && id[ 1 ] != id[ 3 ] && id[ 2 ] != id[ 3 ];
+  }
+
+#ifdef AMIS_SIMD_X86
+  /// exp( x ) for x <= 0
+  __attribute__(( target( "avx2,fma" ) ))
+  static __m256d expNonPositive( __m256d x ) {
+    const __m256d shifter = _mm256_set1_pd( 6755399441055744.0 ); // 1.5 * 2^52
+    const __m256d log2e = _mm256_set1_pd( 1.4426950408889634074 );
+    const __m256d ln2_hi = _mm256_set1_pd( 6.93147180369123816490e-01 );
+    const __m256d ln2_lo = _mm256_set1_pd( 1.90821492927058770002e-10 );
+    // x = n * ln2 + r, |r| <= ln2 / 2
+    __m256d t = _mm256_fmadd_pd( x, log2e, shifter );
+    __m256d n = _mm256_sub_pd( t, shifter );
+    __m256d r = _mm256_fnmadd_pd( n, ln2_hi, x );
+    r = _mm256_fnmadd_pd( n, ln2_lo, r );
+    // Taylor series up to r^13 / 13!
+    __m256d p = _mm256_set1_pd( 1.0 / 6227020800.0 );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 479001600.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 39916800.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 3628800.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 362880.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 40320.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 5040.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 720.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 120.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 24.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 / 6.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 0.5 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 ) );
+    p = _mm256_fmadd_pd( p, r, _mm256_set1_pd( 1.0 ) );
+    // 2^n from the low bits of t
+    __m256i e = _mm256_slli_epi64( _mm256_add_epi64( _mm256_castpd_si256( t ), _mm256_set1_epi64x( 1023 ) ), 52 );
+    p = _mm256_mul_pd( p, _mm256_castsi256_pd( e ) );
+    // below the range of normalized numbers (and -inf)
+    return _mm256_blendv_pd( p, _mm256_setzero_pd(),
+                             _mm256_cmp_pd( x, _mm256_set1_pd( -708.0 ), _CMP_LT_OQ ) );
+  }
+
+  /// log( 1 + y ) for 0 <= y <= 1
+  __attribute__(( target( "avx2,fma" ) ))
+  static __m256d log1pUnit( __m256d y ) {
+    // log( 1 + y ) = 2 atanh( s ) (+ log 2 for large y), |s| <= 3 - 2 sqrt( 2 )
+    __m256d big = _mm256_cmp_pd( y, _mm256_set1_pd( 0.41421356237309504880 ), _CMP_GT_OQ );
+    __m256d num = _mm256_blendv_pd( y, _mm256_sub_pd( y, _mm256_set1_pd( 1.0 ) ), big );
+    __m256d den = _mm256_add_pd( y, _mm256_blendv_pd( _mm256_set1_pd( 2.0 ), _mm256_set1_pd( 3.0 ), big ) );
+    __m256d s = _mm256_div_pd( num, den );
+    __m256d s2 = _mm256_mul_pd( s, s );
+    __m256d p = _mm256_set1_pd( 2.0 / 21.0 );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 19.0 ) );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 17.0 ) );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 15.0 ) );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 13.0 ) );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 11.0 ) );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 9.0 ) );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 7.0 ) );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 5.0 ) );
+    p = _mm256_fmadd_pd( p, s2, _mm256_set1_pd( 2.0 / 3.0 ) );
+    p = _mm256_mul_pd( _mm256_mul_pd( p, s2 ), s );
+    p = _mm256_fmadd_pd( s, _mm256_set1_pd( 2.0 ), p );
+    return _mm256_add_pd( p, _mm256_and_pd( big, _mm256_set1_pd( 0.69314718055994530942 ) ) );
+  }
+
+  /// log( exp( a ) + exp( b ) )
+  __attribute__(( target( "avx2,fma" ) ))
+  static __m256d logAddExp( __m256d a, __m256d b ) {
+    __m256d hi = _mm256_max_pd( a, b );
+    __m256d lo = _mm256_min_pd( a, b );
+    __m256d ret = _mm256_add_pd( hi, log1pUnit( expNonPositive( _mm256_sub_pd( lo, hi ) ) ) );
+    // both are zero in log space
+    return _mm256_blendv_pd( ret, hi, _mm256_cmp_pd( hi, _mm256_set1_pd( -REAL_INF ), _CMP_LE_OQ ) );
+  }
+
+  __attribute__(( target( "avx2,fma" ) ))
+  static size_t sumExpAVX2( const double* x, const unsigned int* id, size_t n, double shift, double& sum ) {
+    __m256d acc = _mm256_setzero_pd();
+    __m256d m = _mm256_set1_pd( shift );
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m256d v = SparseKernel::gather4( x, _mm_loadu_si128( reinterpret_cast< const __m128i* >( id + i ) ) );
+      acc = _mm256_add_pd( acc, expNonPositive( _mm256_sub_pd( v, m ) ) );
+    }
+    __m128d s = _mm_add_pd( _mm256_castpd256_pd128( acc ), _mm256_extractf128_pd( acc, 1 ) );
+    sum = _mm_cvtsd_f64( _mm_add_sd( s, _mm_unpackhi_pd( s, s ) ) );
+    return i;
+  }
+
+  __attribute__(( target( "avx2,fma" ) ))
+  static size_t addEachAVX2( double* x, const unsigned int* id, size_t n, double v ) {
+    __m256d a = _mm256_set1_pd( v );
+    double out[ 4 ];
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      const unsigned int* d = id + i;
+      if ( ! distinct( d ) ) break;
+      __m128i idx = _mm_loadu_si128( reinterpret_cast< const __m128i* >( d ) );
+      _mm256_storeu_pd( out, logAddExp( SparseKernel::gather4( x, idx ), a ) );
+      x[ d[ 0 ] ] = out[ 0 ]; x[ d[ 1 ] ] = out[ 1 ]; x[ d[ 2 ] ] = out[ 2 ]; x[ d[ 3 ] ] = out[ 3 ];
+    }
+    return i;
+  }
+
+  __attribute__(( target( "avx2,fma" ) ))
+  static size_t incQuotientEachAVX2( double* x, const double* divisor, const unsigned int* id, size_t n,
+                                     double v, double zero_value ) {
+    const __m256d zero = _mm256_set1_pd( zero_value );
+    __m256d q = _mm256_set1_pd( v );
+    double out[ 4 ];
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      const unsigned int* d = id + i;
+      if ( ! distinct( d ) ) break;
+      __m128i idx = _mm_loadu_si128( reinterpret_cast< const __m128i* >( d ) );
+      __m256d div = SparseKernel::gather4( divisor, idx );
+      __m256d cur = SparseKernel::gather4( x, idx );
+      __m256d ret = logAddExp( cur, _mm256_sub_pd( q, div ) );
+      // a divisor of zero probability leaves the value unchanged
+      ret = _mm256_blendv_pd( ret, cur, _mm256_cmp_pd( div, zero, _CMP_LE_OQ ) );
+      _mm256_storeu_pd( out, ret );
+      x[ d[ 0 ] ] = out[ 0 ]; x[ d[ 1 ] ] = out[ 1 ]; x[ d[ 2 ] ] = out[ 2 ]; x[ d[ 3 ] ] = out[ 3 ];
+    }
+    return i;
+  }
+#endif // AMIS_SIMD_X86
+
+public:
+  /// Current mode
+  static int mode() {
+    return modeValue();
+  }
+  /// Set the mode; must be called before estimation starts
+  static void setMode( int m ) {
+    modeValue() = m;
+  }
+
+  /// log( exp( a ) + exp( b ) ) in the fast mode
+  static Real logAddExp( Real a, Real b ) {
+    Real hi = std::max( a, b );
+    if ( hi <= -REAL_INF ) return hi;
+    return hi + log1p( exp( std::min( a, b ) - hi ) );
+  }
+
+  /// log( sum( exp( x[ *it ] ) ) ) over it in [first, last)
+  static Real sum( const Real* x, const unsigned int* first, const unsigned int* last ) {
+    Real scale = -REAL_INF;
+    for ( const unsigned int* it = first; it != last; ++it ) {
+      scale = std::max( scale, x[ *it ] );
+    }
+    if ( scale <= -REAL_INF ) return -REAL_INF;
+    size_t n = last - first;
+    size_t i = 0;
+    Real s = 0.0;
+#ifdef AMIS_SIMD_X86
+    if ( useVector( n ) ) i = sumExpAVX2( x, first, n, scale, s );
+#endif // AMIS_SIMD_X86
+    for ( ; i < n; ++i ) {
+      s += exp( x[ first[ i ] ] - scale );
+    }
+    return log( s ) + scale;
+  }
+
+  /// x[ *it ] = log( exp( x[ *it ] ) + exp( v ) ) for it in [first, last)
+  static void addEach( Real* x, const unsigned int* first, const unsigned int* last, Real v ) {
+    if ( v <= -REAL_INF ) return;
+    size_t n = last - first;
+    size_t i = 0;
+#ifdef AMIS_SIMD_X86
+    if ( useVector( n ) ) i = addEachAVX2( x, first, n, v );
+#endif // AMIS_SIMD_X86
+    for ( ; i < n; ++i ) {
+      x[ first[ i ] ] = logAddExp( x[ first[ i ] ], v );
+    }
+  }
+
+  /// x[ *it ] = log( exp( x[ *it ] ) + exp( v - divisor[ *it ] ) ) for
+  /// it in [first, last) whose divisor is above zero_value
+  static void incQuotientEach( Real* x, const Real* divisor,
+                               const unsigned int* first, const unsigned int* last,
+                               Real v, Real zero_value ) {
+    size_t n = last - first;
+    size_t i = 0;
+#ifdef AMIS_SIMD_X86
+    if ( useVector( n ) ) i = incQuotientEachAVX2( x, divisor, first, n, v, zero_value );
+#endif // AMIS_SIMD_X86
+    for ( ; i < n; ++i ) {
+      if ( divisor[ first[ i ] ] > zero_value ) {
+        x[ first[ i ] ] = logAddExp( x[ first[ i ] ], v - divisor[ first[ i ] ] );
+      }
+    }
+  }
+
+  /// Maximum of [first, last), or -inf for an empty range
+  static Real max( const Real* first, const Real* last ) {
+    Real m0 = -REAL_INF, m1 = -REAL_INF, m2 = -REAL_INF, m3 = -REAL_INF;
+    for ( ; first + 4 <= last; first += 4 ) {
+      m0 = std::max( first[ 0 ], m0 );
+      m1 = std::max( first[ 1 ], m1 );
+      m2 = std::max( first[ 2 ], m2 );
+      m3 = std::max( first[ 3 ], m3 );
+    }
+    for ( ; first != last; ++first ) {
+      m0 = std::max( *first, m0 );
+    }
+    return std::max( std::max( m0, m1 ), std::max( m2, m3 ) );
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_LogSumExp_h_
+// end of LogSumExp.h
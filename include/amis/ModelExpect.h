@@ -19,67 +19,419 @@
 #include <amis/Real.h>
 #include <amis/ModelBase.h>
 #include <amis/EventSpace.h>
+#include <amis/EventScheduler.h>
+#include <amis/LogStream.h>
 #include <functional>
+#include <algorithm>
+#include <cmath>
 
 AMIS_NAMESPACE_BEGIN
 
 //////////////////////////////////////////////////////////////////////
 
 /**
- * Empirical expectation of features
+ * Add x to sum with Neumaier's compensated summation.
+ * The lost low-order part is accumulated in c; the result is sum + c.
+ */
+
+inline void compensatedAdd( Real& sum, Real& c, Real x ) {
+  Real t = sum + x;
+  if ( std::fabs( sum ) >= std::fabs( x ) ) {
+    c += ( sum - t ) + x;
+  } else {
+    c += ( x - t ) + sum;
+  }
+  sum = t;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Partial sums of model expectations for each chunk of events.
+ * The features of chunk c are feature_list[ offset[ c ] .. offset[ c + 1 ] ),
+ * sorted and unique, and value[ k ] holds the sum for feature_list[ k ].
+ */
+
+struct ChunkExpect {
+  std::vector< size_t > offset;
+  std::vector< FeatureID > feature_list;
+  std::vector< Real > value;
+  std::vector< Real > log_likelihood;
+};
+
+/**
+ * A worker computing model expectations for chunks of events
+ * given by an EventScheduler.
+ * Each worker owns its accumulator, its expectation buffer and, when
+ * the events are not on memory, its cursor over the events,
+ * so that workers never write to shared data.
+ * When chunk_expect is given, the sums of each chunk are moved
+ * from the buffer to chunk_expect, which makes the result independent
+ * of the assignment of chunks to workers.  A sum left in the buffer
+ * means that WeightAccumulator::collectFeatures missed a feature, and
+ * is reported by WeightAccumulatorError.
+ */
+
+class ModelExpectThread : public Thread {
+public:
+  const ModelBase* model;
+  EventSpace* event_space;
+  EventCursor* cursor;
+  EventScheduler* scheduler;
+  size_t thread_id;
+  WeightAccumulator* accumulator;
+  std::vector< Real >* expectation;
+  ChunkExpect* chunk_expect;
+  Real event_empirical_expectation;
+  Real log_likelihood;
+
+public:
+  /// Constructor
+  ModelExpectThread()
+    : model( NULL ), event_space( NULL ), cursor( NULL ), scheduler( NULL ), thread_id( 0 ),
+      accumulator( NULL ), expectation( NULL ), chunk_expect( NULL ),
+      event_empirical_expectation( 0.0 ), log_likelihood( 0.0 )
+  {}
+  /// Destructor
+  virtual ~ModelExpectThread() {
+    delete cursor;
+  }
+
+protected:
+  void run() {
+    log_likelihood = 0.0;
+    expectation->assign( model->numFeatures(), 0.0 );
+    accumulator->clearIgnored();
+    EventChunk chunk;
+    while ( scheduler->nextChunk( thread_id, chunk ) ) {
+      double start = EventScheduler::wallClock();
+      Real chunk_log_likelihood = 0.0;
+      const EventBase* const* events = event_space->eventArray();
+      if ( events != NULL ) {
+        // events on memory: one virtual call for the whole chunk
+        chunk_log_likelihood =
+          accumulator->modelCountRange( *expectation, events + chunk.begin_event, chunk.end_event - chunk.begin_event,
+                                        event_empirical_expectation, *model );
+      }
+      else {
+        for ( EventCount i = chunk.begin_event; i < chunk.end_event; ++i ) {
+          AMIS_DEBUG_MESSAGE( 5, "Event " << i << "\n" );
+          chunk_log_likelihood +=
+            accumulator->modelCount( *expectation, (*cursor)[ i ], event_empirical_expectation, *model );
+        }
+      }
+      if ( chunk_expect != NULL ) {
+        std::vector< Real >& e = *expectation;
+        for ( size_t k = chunk_expect->offset[ chunk.id ]; k < chunk_expect->offset[ chunk.id + 1 ]; ++k ) {
+          FeatureID f = chunk_expect->feature_list[ k ];
+          chunk_expect->value[ k ] = e[ f ];
+          e[ f ] = 0.0;
+        }
+        chunk_expect->log_likelihood[ chunk.id ] = chunk_log_likelihood;
+      }
+      else {
+        log_likelihood += chunk_log_likelihood;
+      }
+      scheduler->addBusyTime( thread_id, EventScheduler::wallClock() - start );
+    }
+    if ( chunk_expect != NULL ) {
+      checkMoved();
+    }
+  }
+
+  /// Check that every sum in the buffer was moved to chunk_expect
+  void checkMoved() const {
+    const std::vector< Real >& e = *expectation;
+    for ( size_t f = 0; f < e.size(); ++f ) {
+      if ( e[ f ] != 0.0 ) {
+        OStringStream os;
+        os << "Model expectation of feature " << f
+           << " is missing from the partial sums of chunks (not listed by collectFeatures)";
+        throw WeightAccumulatorError( os.str() );
+      }
+    }
+  }
+};
+
+/**
+ * A worker summing up the partial sums of chunks for a range of features.
+ * The sums are taken in the order of chunks, so the result does not
+ * depend on how the features are divided among the workers.
+ */
+
+class ChunkReduceThread : public Thread {
+public:
+  const ChunkExpect* chunk_expect;
+  std::vector< Real >* expectation;
+  std::vector< Real >* compensation;
+  FeatureID feature_begin;
+  FeatureID feature_end;
+
+public:
+  /// Constructor
+  ChunkReduceThread()
+    : chunk_expect( NULL ), expectation( NULL ), compensation( NULL ),
+      feature_begin( 0 ), feature_end( 0 )
+  {}
+  /// Destructor
+  virtual ~ChunkReduceThread() {}
+
+protected:
+  void run() {
+    std::vector< Real >& e = *expectation;
+    std::vector< Real >& comp = *compensation;
+    std::fill( comp.begin() + feature_begin, comp.begin() + feature_end, 0.0 );
+    const std::vector< FeatureID >& feature_list = chunk_expect->feature_list;
+    for ( size_t c = 0; c + 1 < chunk_expect->offset.size(); ++c ) {
+      size_t k = std::lower_bound( feature_list.begin() + chunk_expect->offset[ c ],
+                                   feature_list.begin() + chunk_expect->offset[ c + 1 ],
+                                   feature_begin ) - feature_list.begin();
+      for ( ; k < chunk_expect->offset[ c + 1 ] && feature_list[ k ] < feature_end; ++k ) {
+        FeatureID f = feature_list[ k ];
+        compensatedAdd( e[ f ], comp[ f ], chunk_expect->value[ k ] );
+      }
+    }
+    for ( FeatureID f = feature_begin; f < feature_end; ++f ) {
+      e[ f ] += comp[ f ];
+    }
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Model expectation of features.
+ *
+ * In the fast reduction mode, the buffers of the workers are summed
+ * up in the order of workers.  The result then depends on the number
+ * of threads and on how the chunks were stolen.
+ * In the deterministic reduction mode, the partial sums of each chunk
+ * are kept apart and summed up in the order of chunks with compensated
+ * summation.  Since the chunk layout depends only on the event space,
+ * the result is bit-identical for any number of threads.
  */
 
 class ModelExpect : public std::vector<Real> {
 public:
+  /// Number of chunks in the deterministic mode.
+  /// Fewer chunks than the default share more features, which keeps
+  /// the partial sums small at the cost of coarser load balancing.
+  static const size_t DETERMINISTIC_NUM_CHUNKS = 128;
+
   const ModelBase* model;
   EventSpace* event_space;
 
+private:
+  /// Number of threads requested
+  int num_threads;
+  /// Workers (the first one uses the accumulator of the event space)
+  std::vector< ModelExpectThread* > workers;
+  /// Expectation buffers of the second and later workers
+  std::vector< std::vector< Real > > thread_expectation;
+  /// Distribution of events to the workers
+  EventScheduler scheduler;
+  /// Whether to reduce partial sums in a fixed order
+  bool deterministic;
+  /// Partial sums of chunks (deterministic mode)
+  ChunkExpect chunk_expect;
+  /// Compensation terms of compensated summation (deterministic mode)
+  std::vector< Real > compensation;
+  /// Workers summing up the partial sums (deterministic mode)
+  std::vector< ChunkReduceThread* > reducers;
+
+  void clearWorkers() {
+    for ( size_t i = 0; i < workers.size(); ++i ) {
+      if ( i > 0 ) delete workers[ i ]->accumulator;
+      delete workers[ i ];
+    }
+    workers.clear();
+    for ( size_t i = 0; i < reducers.size(); ++i ) {
+      delete reducers[ i ];
+    }
+    reducers.clear();
+    thread_expectation.clear();
+    chunk_expect = ChunkExpect();
+    compensation.clear();
+  }
+
+  /// Collect the features of each chunk
+  void initChunkExpect() {
+    WeightAccumulator* accumulator = event_space->getAccumulator();
+    std::vector< FeatureID > features;
+    chunk_expect.offset.assign( 1, 0 );
+    for ( size_t c = 0; c < scheduler.numChunks(); ++c ) {
+      features.clear();
+      const EventChunk& chunk = scheduler.chunk( c );
+      for ( EventCount i = chunk.begin_event; i < chunk.end_event; ++i ) {
+        accumulator->collectFeatures( (*event_space)[ i ], features );
+      }
+      std::sort( features.begin(), features.end() );
+      features.erase( std::unique( features.begin(), features.end() ), features.end() );
+      chunk_expect.feature_list.insert( chunk_expect.feature_list.end(), features.begin(), features.end() );
+      chunk_expect.offset.push_back( chunk_expect.feature_list.size() );
+    }
+    chunk_expect.value.assign( chunk_expect.feature_list.size(), 0.0 );
+    chunk_expect.log_likelihood.assign( scheduler.numChunks(), 0.0 );
+    compensation.assign( model->numFeatures(), 0.0 );
+    size_t n = workers.size();
+    for ( size_t i = 0; i < n; ++i ) {
+      reducers.push_back( new ChunkReduceThread() );
+      ChunkReduceThread& r = *reducers[ i ];
+      r.chunk_expect = &chunk_expect;
+      r.expectation = this;
+      r.compensation = &compensation;
+      r.feature_begin = size() * i / n;
+      r.feature_end = size() * ( i + 1 ) / n;
+    }
+    AMIS_DEBUG_MESSAGE( 3, "Partial sums of " << scheduler.numChunks() << " chunks: "
+                        << chunk_expect.feature_list.size() << " values\n" );
+  }
+
+  /// Sum up the partial sums of chunks in the order of chunks
+  Real reduceChunks() {
+    for ( size_t i = 0; i < reducers.size(); ++i ) {
+      reducers[ i ]->start();
+    }
+    for ( size_t i = 0; i < reducers.size(); ++i ) {
+      reducers[ i ]->join();
+    }
+    Real log_likelihood = 0.0;
+    Real log_likelihood_c = 0.0;
+    for ( size_t c = 0; c < scheduler.numChunks(); ++c ) {
+      compensatedAdd( log_likelihood, log_likelihood_c, chunk_expect.log_likelihood[ c ] );
+    }
+    return log_likelihood + log_likelihood_c;
+  }
+
+  void initWorkers() {
+    clearWorkers();
+    size_t n = num_threads > 1 ? num_threads : 1;
+    if ( ! Thread::isParallel() || ! event_space->isConcurrentAccessible() ) {
+      if ( n > 1 ) {
+        AMIS_WARNING_MESSAGE( "Model expectation is computed by a single thread because "
+                              << ( Thread::isParallel() ? "the event space does not allow concurrent access" : "amis was built without --enable-parallel" )
+                              << '\n' );
+      }
+      n = 1;
+    }
+    size_t num_chunks = deterministic ? DETERMINISTIC_NUM_CHUNKS : EventScheduler::DEFAULT_NUM_CHUNKS;
+    scheduler.initialize( *event_space, n, num_chunks );
+    if ( n > scheduler.numChunks() ) {
+      n = std::max< size_t >( scheduler.numChunks(), 1 );
+      scheduler.initialize( *event_space, n, num_chunks );
+    }
+    thread_expectation.resize( n - 1 );
+    for ( size_t i = 0; i < n; ++i ) {
+      workers.push_back( new ModelExpectThread() );
+      ModelExpectThread& w = *workers[ i ];
+      w.model = model;
+      w.event_space = event_space;
+      if ( event_space->eventArray() == NULL ) {
+        // e.g. events on files: each worker reads by its own cursor
+        w.cursor = event_space->newCursor();
+      }
+      w.scheduler = &scheduler;
+      w.thread_id = i;
+      w.accumulator = ( i == 0 ? event_space->getAccumulator() : event_space->getAccumulator()->clone() );
+      w.expectation = ( i == 0 ? static_cast< std::vector< Real >* >( this ) : &thread_expectation[ i - 1 ] );
+    }
+    if ( deterministic ) {
+      initChunkExpect();
+      for ( size_t i = 0; i < n; ++i ) {
+        workers[ i ]->chunk_expect = &chunk_expect;
+      }
+    }
+  }
+
+  ModelExpect( const ModelExpect& );
+  ModelExpect& operator=( const ModelExpect& );
+
 public:
   /// Constructor
   ModelExpect()
   {
     model = NULL;
     event_space = NULL;
+    num_threads = 1;
+    deterministic = false;
   }
   /// Destructor
-  virtual ~ModelExpect() {}
+  virtual ~ModelExpect()
+  {
+    clearWorkers();
+  }
 
 public:
+  /// Set the number of threads (effective at the next initialize)
+  void setNumThreads( int n ) {
+    num_threads = n;
+  }
+  /// Select the deterministic reduction mode (effective at the next initialize)
+  void setDeterministic( bool d ) {
+    deterministic = d;
+  }
   /// Initialize with a model and an event space
   void initialize( const ModelBase* init_model, EventSpace* init_event_space ) {
     model = init_model;
     event_space = init_event_space;
     assign( model->numFeatures(), 0.0 );
+    initWorkers();
   }
-  /// Set empirical expectations of features
+  /// Set model expectations of features, and return the log-likelihood
   Real setModelExpectation()
   {
-    Real log_likelihood = 0.0;
     AMIS_DEBUG_MESSAGE( 5, "Start setModelExpectation" );
-    this->assign(this->size(), 0.0);
-
-    
-    event_space->getAccumulator()->clearIgnored();
-    for( EventCount i = 0; i < event_space->numEvents(); ++i ) {
-      AMIS_DEBUG_MESSAGE( 5, "Event " << i << "\n" );
-      const EventBase& event = (*event_space)[ i ];
-      log_likelihood +=
-	event_space->getAccumulator()->modelCount(*this, event,
-						  event_space->eventEmpiricalExpectation(),
-						  *model);
+    Real event_ee = event_space->eventEmpiricalExpectation();
+    scheduler.startPass();
+    workers[ 0 ]->accumulator->prepare( *model );
+    for ( size_t i = 0; i < workers.size(); ++i ) {
+      workers[ i ]->event_empirical_expectation = event_ee;
+      workers[ i ]->start();
     }
-    if ( event_space->getAccumulator()->numIgnored() > 0 ) {
-      AMIS_WARNING_MESSAGE(event_space->getAccumulator()->numIgnored() << " events are ignored because of infinite weight sum\n");
+    for ( size_t i = 0; i < workers.size(); ++i ) {
+      workers[ i ]->join();
     }
-    AMIS_DEBUG_MESSAGE( 5, "END 1st for loop\n" );
+    scheduler.endPass();
 
-    //std::cerr << std::endl;
+    Real log_likelihood = 0.0;
+    size_t num_ignored = 0;
+    if ( deterministic ) {
+      // all buffers are left zero; sum up the chunks
+      log_likelihood = reduceChunks();
+    }
+    else {
+      // reduction in the order of workers
+      log_likelihood = workers[ 0 ]->log_likelihood;
+      for ( size_t i = 1; i < workers.size(); ++i ) {
+        const std::vector< Real >& e = thread_expectation[ i - 1 ];
+        for ( size_t j = 0; j < size(); ++j ) {
+          (*this)[ j ] += e[ j ];
+        }
+        log_likelihood += workers[ i ]->log_likelihood;
+      }
+    }
+    for ( size_t i = 0; i < workers.size(); ++i ) {
+      num_ignored += workers[ i ]->accumulator->numIgnored();
+    }
+    if ( num_ignored > 0 ) {
+      AMIS_WARNING_MESSAGE(num_ignored << " events are ignored because of infinite weight sum\n");
+    }
     AMIS_DEBUG_MESSAGE( 5, "END setModelExpectation( void )\n" );
 
     //std::cerr << "log_likelihood = " << log_likelihood << std::endl;
     return log_likelihood;
   }
 
+  /// Number of threads actually used
+  size_t numWorkers() const {
+    return workers.size();
+  }
+
+  /// Print busy/idle time of each thread
+  void writeThreadUsage( std::ostream& os ) const {
+    scheduler.writeUsage( os );
+  }
+
   virtual void debugInfo( std::ostream& ostr ) const
   {
     for ( std::vector< Real >::const_iterator it = this->begin();
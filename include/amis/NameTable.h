@@ -17,6 +17,7 @@
 #include <amis/StringStream.h>
 #include <amis/Feature.h>
 #include <amis/DynamicCast.h>
+#include <amis/StringHash.h>
 #include <string>
 #include <vector>
 #include <memory>
@@ -26,7 +27,7 @@ AMIS_NAMESPACE_BEGIN
 class NameTable {
 protected:
   typedef amis_hash_map< FeatureID, std::string > NameMap;
-  typedef amis_hash_map< std::string, FeatureID > IDMap;
+  typedef StringIndex< FeatureID > IDMap;
   NameMap feature_name;
   IDMap feature_id;
 
@@ -56,8 +57,8 @@ public:
   }
   virtual FeatureID featureID( const std::string& name, bool unk_on_not_found = false )
   {
-    IDMap::const_iterator it = feature_id.find( name );
-    if ( it == feature_id.end() ) {
+    FeatureID id;
+    if ( ! feature_id.find( name, id ) ) {
       if( unk_on_not_found ) {
         return UNKNOWN_FEATURE_ID;
       }
@@ -67,7 +68,16 @@ public:
         throw IllegalFeatureError( oss.str() );
       }
     }
-    return it->second;
+    return id;
+  }
+  /// Look up n characters, e.g. a token of Tokenizer, without making a
+  /// string.  A name not registered is passed to the virtual featureID()
+  /// above, so that a derived table can handle it.
+  FeatureID featureID( const char* name, size_t size, bool unk_on_not_found = false )
+  {
+    FeatureID id;
+    if ( feature_id.find( name, size, id ) ) return id;
+    return featureID( std::string( name, size ), unk_on_not_found );
   }
   
   virtual void registerNewFeature( const std::string& name, FeatureID id ) {
@@ -76,13 +86,12 @@ public:
       oss << "Feature ID " << id << " already exists";
       throw IllegalFeatureError( oss.str() );
     }
-    if ( feature_id.find( name ) != feature_id.end() ) {
+    if ( ! feature_id.insert( name, id ) ) {
       OStringStream oss;
       oss << "Feature " << name << " already exists";
       throw IllegalFeatureError( oss.str() );
     }
     feature_name[ id ] = name;
-    feature_id[ name ] = id;
   }
   
   /*  virtual void importName( const NameTableBase& name_table_base, const std::vector< FeatureID >& fids ) {
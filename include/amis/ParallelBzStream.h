@@ -0,0 +1,594 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_ParallelBzStream_h_
+
+#define Amis_ParallelBzStream_h_
+
+#include <amis/configure.h>
+#include <amis/ErrorBase.h>
+#include <amis/BzStream.h>
+#include <amis/Thread.h>
+#include <deque>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+AMIS_NAMESPACE_BEGIN
+
+#ifdef AMIS_BZLIB //////////////////////////////////////////////////////////////////////
+
+/**
+ * Input buffer that decodes the blocks of a bzip2 stream on several
+ * threads.
+ *
+ * The blocks of bzip2 are compressed independently, and each starts
+ * with a 48-bit magic number at an arbitrary bit position.  The
+ * reading thread finds the blocks by the magic number, makes each of
+ * them a complete bzip2 stream of one block, and passes it to the
+ * decoding threads; the decoded blocks are delivered in the original
+ * order.  Concatenated streams, as written by parallel compressors,
+ * are read to the end.
+ *
+ * The magic numbers may also appear inside compressed data (with
+ * probability of 2^-48 per bit).  A block cut at such a match fails to
+ * decode, as does the rest of the block after it; underflow() then
+ * decodes them again as one block, as lbzip2 does.  An end-of-stream
+ * magic number ends a block only when the stream CRC follows it, or
+ * when it is followed by the end of the input or another stream.
+ * Errors are thrown by underflow() after the text of the blocks before
+ * the error is consumed.
+ */
+
+class IParallelBzStreamBuf : public std::streambuf {
+public:
+  /// Type of size
+  typedef size_t size_type;
+  /// Type of data
+  typedef char char_type;
+  /// Size of compressed data read at once
+  static const size_type READ_SIZE = 1024 * 1024;
+  /// The number of blocks decoded ahead by each thread
+  static const size_type BLOCKS_PER_THREAD = 2;
+
+private:
+  typedef unsigned long bits_type;  // holds 32 bits
+
+  static const bits_type BLOCK_MAGIC_HIGH = 0x3141;
+  static const bits_type BLOCK_MAGIC_LOW = 0x59265359;
+  static const bits_type END_MAGIC_HIGH = 0x1772;
+  static const bits_type END_MAGIC_LOW = 0x45385090;
+  static const bits_type MASK_16 = 0xffff;
+  static const bits_type MASK_32 = 0xffffffff;
+
+  /// A block to be decoded
+  struct Block {
+    std::vector< char_type > compressed;  // a bzip2 stream of one block
+    size_type num_bits;  // bits of the block in the stream, from its magic number
+    bits_type crc;
+    size_type stream;  // index of the stream the block belongs to
+    std::vector< char_type > text;
+    size_type text_size;
+    bool done;
+    int status;  // BZ_STREAM_END on success
+    Block() : num_bits( 0 ), crc( 0 ), stream( 0 ), text_size( 0 ), done( false ), status( BZ_OK ) {}
+  };
+
+  /// Writes bits from the most significant one
+  class BitWriter {
+  private:
+    std::vector< char_type >& out;
+    bits_type pending;
+    int num_pending;
+  public:
+    explicit BitWriter( std::vector< char_type >& o ) : out( o ), pending( 0 ), num_pending( 0 ) {}
+    void put( bits_type value, int n ) {
+      for ( int i = n - 1; i >= 0; --i ) {
+        pending = ( pending << 1 ) | ( ( value >> i ) & 1 );
+        if ( ++num_pending == 8 ) {
+          out.push_back( static_cast< char_type >( pending & 0xff ) );
+          pending = 0;
+          num_pending = 0;
+        }
+      }
+    }
+    void flush() {
+      if ( num_pending > 0 ) put( 0, 8 - num_pending );
+    }
+  };
+
+  class DecodeThread : public Thread {
+  private:
+    IParallelBzStreamBuf* buf;
+  public:
+    explicit DecodeThread( IParallelBzStreamBuf* b ) : buf( b ) {}
+  protected:
+    void run() { buf->decodeBlocks(); }
+  };
+
+  std::istream& in_stream;
+
+  // compressed data; bit positions below are relative to data[ 0 ]
+  std::vector< unsigned char > data;
+  bool end_of_input;
+  size_type position;       // start of the next unit (stream header or block)
+  bool in_stream_body;      // whether a stream header has been read
+  char_type level;          // block size of the current stream ('1'-'9')
+  bool seen_stream;
+  size_type num_streams;
+  bits_type stream_crc;     // combined CRC of the blocks cut from the current stream
+
+  // blocks in the order of the stream; the front is being read
+  std::deque< Block* > blocks;
+  std::deque< Block* > queue;  // blocks waiting for a decoding thread
+  size_type max_blocks;
+  bool reading_front;
+  std::string input_error;  // an error in cutting blocks, thrown after the blocks before it
+
+  Mutex mutex;
+  Condition changed;
+  bool closed;
+  std::vector< DecodeThread* > threads;
+
+  // bit offsets at which a magic number has the byte as its first
+  // (second) whole byte; bits 0-7 for blocks and 8-15 for the end of a stream
+  unsigned int first_byte_mask[ 256 ];
+  unsigned int second_byte_mask[ 256 ];
+
+  IParallelBzStreamBuf( const IParallelBzStreamBuf& );
+  IParallelBzStreamBuf& operator=( const IParallelBzStreamBuf& );
+
+  /// Body of the decoding threads
+  void decodeBlocks() {
+    while ( true ) {
+      Block* block;
+      {
+        MutexLock lock( mutex );
+        while ( ! closed && queue.empty() ) {
+          changed.wait( mutex );
+        }
+        if ( closed ) return;
+        block = queue.front();
+        queue.pop_front();
+      }
+      int status = decode( *block );
+      MutexLock lock( mutex );
+      block->done = true;
+      block->status = status;
+      changed.broadcast();
+    }
+  }
+
+  /// Decode a bzip2 stream of one block; returns the status of bzlib
+  static int decode( Block& block ) {
+    bz_stream bz;
+    bz.bzalloc = NULL;
+    bz.bzfree = NULL;
+    bz.opaque = NULL;
+    int status = BZ2_bzDecompressInit( &bz, 0, 0 );
+    if ( status != BZ_OK ) return status;
+    bz.next_in = &block.compressed[ 0 ];
+    bz.avail_in = block.compressed.size();
+    // the size of a block before the initial run-length encoding
+    block.text.resize( ( block.compressed[ 3 ] - '0' ) * 100000 + 1024 );
+    block.text_size = 0;
+    while ( status == BZ_OK ) {
+      if ( block.text_size == block.text.size() ) {
+        block.text.resize( block.text.size() * 2 );
+      }
+      bz.next_out = &block.text[ block.text_size ];
+      bz.avail_out = block.text.size() - block.text_size;
+      status = BZ2_bzDecompress( &bz );
+      block.text_size = block.text.size() - bz.avail_out;
+      if ( status == BZ_OK && bz.avail_in == 0 && bz.avail_out > 0 ) {
+        status = BZ_DATA_ERROR;  // truncated
+      }
+    }
+    BZ2_bzDecompressEnd( &bz );
+    if ( status == BZ_STREAM_END ) {
+      std::vector< char_type >().swap( block.compressed );
+    }
+    // a failed block is kept for joining with the next one
+    return status;
+  }
+
+  /// Copy n bits from the bit position of the data
+  static void copyBits( BitWriter& writer, const std::vector< char_type >& from, size_type bit, size_type n ) {
+    for ( size_type end = bit + n; bit < end; ++bit ) {
+      writer.put( ( static_cast< unsigned char >( from[ bit / 8 ] ) >> ( 7 - bit % 8 ) ) & 1, 1 );
+    }
+  }
+
+  /// Upper bound of the bits of a block; its at most 100k-900k symbols
+  /// take less than 10 bits each, so 16 bits per symbol leave a margin
+  static size_type maxBlockBits( char_type level ) {
+    return ( level - '0' ) * 100000 * 16 + 1024 * 1024;
+  }
+
+  /// Append the bits of the next block to a block that failed to decode
+  static void join( Block& block, const Block& next ) {
+    std::vector< char_type > joined;
+    joined.reserve( ( block.num_bits + next.num_bits ) / 8 + 20 );
+    joined.insert( joined.end(), block.compressed.begin(), block.compressed.begin() + 4 );
+    BitWriter writer( joined );
+    copyBits( writer, block.compressed, 32, block.num_bits );
+    copyBits( writer, next.compressed, 32, next.num_bits );
+    writer.put( END_MAGIC_HIGH, 16 );
+    writer.put( END_MAGIC_LOW, 32 );
+    writer.put( block.crc, 32 );
+    writer.flush();
+    block.compressed.swap( joined );
+    block.num_bits += next.num_bits;
+  }
+
+  /// Read more compressed data; returns false at the end of the input
+  bool readMore() {
+    if ( end_of_input ) return false;
+    // discard the data before the current unit
+    size_type discard = position / 8;
+    if ( discard > 0 ) {
+      data.erase( data.begin(), data.begin() + discard );
+      position -= discard * 8;
+    }
+    size_type size = data.size();
+    data.resize( size + READ_SIZE );
+    in_stream.read( reinterpret_cast< char* >( &data[ size ] ), READ_SIZE );
+    size_type count = in_stream.gcount();
+    data.resize( size + count );
+    if ( count == 0 ) end_of_input = true;
+    return count > 0;
+  }
+
+  /// Make sure that n bits from the current unit are in the buffer
+  bool ensure( size_type n ) {
+    while ( position + n > data.size() * 8 ) {
+      if ( ! readMore() ) return false;
+    }
+    return true;
+  }
+
+  /// n bits (at most 32) at the bit position
+  bits_type getBits( size_type bit, int n ) const {
+    bits_type value = 0;
+    for ( int i = 0; i < n; ++i, ++bit ) {
+      value = ( value << 1 ) | ( ( data[ bit / 8 ] >> ( 7 - bit % 8 ) ) & 1 );
+    }
+    return value;
+  }
+
+  /// 8 bits of a magic number from the t-th bit
+  static unsigned int magicByte( bits_type high, bits_type low, int t ) {
+    unsigned int c = 0;
+    for ( int i = t; i < t + 8; ++i ) {
+      c = ( c << 1 ) | ( i < 16 ? ( high >> ( 15 - i ) ) & 1 : ( low >> ( 47 - i ) ) & 1 );
+    }
+    return c;
+  }
+
+  /// Index the first two whole bytes of the magic numbers at every bit offset
+  void initMagicTable() {
+    for ( int c = 0; c < 256; ++c ) {
+      first_byte_mask[ c ] = 0;
+      second_byte_mask[ c ] = 0;
+    }
+    for ( int shift = 0; shift < 8; ++shift ) {
+      int t = ( 8 - shift ) % 8;  // the first whole byte starts at the t-th bit of the magic number
+      first_byte_mask[ magicByte( BLOCK_MAGIC_HIGH, BLOCK_MAGIC_LOW, t ) ] |= 1 << shift;
+      second_byte_mask[ magicByte( BLOCK_MAGIC_HIGH, BLOCK_MAGIC_LOW, t + 8 ) ] |= 1 << shift;
+      first_byte_mask[ magicByte( END_MAGIC_HIGH, END_MAGIC_LOW, t ) ] |= 1 << ( shift + 8 );
+      second_byte_mask[ magicByte( END_MAGIC_HIGH, END_MAGIC_LOW, t + 8 ) ] |= 1 << ( shift + 8 );
+    }
+  }
+
+  /// Find the next block or end-of-stream magic number from the bit position
+  size_type findMagic( size_type bit ) {
+    size_type i = bit / 8;
+    while ( true ) {
+      // a magic number that starts in bytes before i + 6 is in the buffer
+      for ( ; i + 6 < data.size(); ++i ) {
+        unsigned int mask = first_byte_mask[ data[ i ] ];
+        if ( mask == 0 ) continue;
+        mask &= second_byte_mask[ data[ i + 1 ] ];
+        for ( int m = 0; mask != 0; ++m, mask >>= 1 ) {
+          if ( ( mask & 1 ) == 0 ) continue;
+          int shift = m % 8;
+          size_type start = i * 8 - ( 8 - shift ) % 8;
+          if ( i == 0 && shift > 0 ) continue;
+          if ( start < bit ) continue;
+          bits_type high = m < 8 ? BLOCK_MAGIC_HIGH : END_MAGIC_HIGH;
+          bits_type low = m < 8 ? BLOCK_MAGIC_LOW : END_MAGIC_LOW;
+          if ( getBits( start, 16 ) == high && getBits( start + 16, 32 ) == low ) {
+            return start;
+          }
+        }
+      }
+      size_type offset = position;
+      if ( ! readMore() ) throw BzStreamError( "Unexpected end of bzip2 stream" );
+      i -= ( offset - position ) / 8;
+      bit -= offset - position;
+    }
+  }
+
+  /// Whether a magic number at the offset from the current unit ends the
+  /// block; an end-of-stream magic number is checked by what follows it
+  bool isEndOfBlock( size_type offset, bits_type combined_crc ) {
+    if ( getBits( position + offset, 16 ) == BLOCK_MAGIC_HIGH ) return true;
+    if ( ! ensure( offset + 80 ) ) return false;
+    if ( getBits( position + offset + 48, 32 ) == combined_crc ) return true;
+    // the CRC does not match when the stream has a block cut inside compressed data
+    size_type next = ( position + offset + 80 + 7 ) / 8 * 8 - position;
+    if ( ! ensure( next + 32 ) ) return position + next == data.size() * 8;
+    const unsigned char* header = &data[ ( position + next ) / 8 ];
+    return header[ 0 ] == 'B' && header[ 1 ] == 'Z' && header[ 2 ] == 'h' &&
+      header[ 3 ] >= '1' && header[ 3 ] <= '9';
+  }
+
+  /// Cut the next block out of the input; returns NULL at the end
+  Block* nextBlock() {
+    while ( true ) {
+      if ( ! in_stream_body ) {
+        // a stream header "BZh1"-"BZh9" at a byte boundary
+        if ( ! ensure( 32 ) ) {
+          if ( position / 8 == data.size() || seen_stream ) return NULL;  // trailing garbage is ignored as bzip2 does
+          throw BzStreamError( "Not a bzip2 stream" );
+        }
+        const unsigned char* header = &data[ position / 8 ];
+        if ( header[ 0 ] != 'B' || header[ 1 ] != 'Z' || header[ 2 ] != 'h' ||
+             header[ 3 ] < '1' || header[ 3 ] > '9' ) {
+          if ( seen_stream ) return NULL;
+          throw BzStreamError( "Not a bzip2 stream" );
+        }
+        level = header[ 3 ];
+        position += 32;
+        in_stream_body = true;
+        seen_stream = true;
+        ++num_streams;
+        stream_crc = 0;
+      }
+      if ( ! ensure( 80 ) ) throw BzStreamError( "Unexpected end of bzip2 stream" );
+      bits_type high = getBits( position, 16 );
+      bits_type low = getBits( position + 16, 32 );
+      if ( high == END_MAGIC_HIGH && low == END_MAGIC_LOW ) {
+        // end of a stream: magic, combined CRC, and padding to a byte boundary
+        position = ( position + 80 + 7 ) / 8 * 8;
+        in_stream_body = false;
+        continue;
+      }
+      if ( high != BLOCK_MAGIC_HIGH || low != BLOCK_MAGIC_LOW ) {
+        throw BzStreamError( "Broken bzip2 stream" );
+      }
+      bits_type crc = getBits( position + 48, 32 );
+      bits_type combined_crc = ( ( ( stream_crc << 1 ) | ( stream_crc >> 31 ) ) ^ crc ) & MASK_32;
+      size_type offset = findMagic( position + 80 ) - position;
+      while ( ! isEndOfBlock( offset, combined_crc ) ) {
+        offset = findMagic( position + offset + 1 ) - position;
+      }
+      size_type end = position + offset;
+      stream_crc = combined_crc;
+      Block* block = new Block();
+      block->num_bits = end - position;
+      block->crc = crc;
+      block->stream = num_streams;
+      std::vector< char_type >& out = block->compressed;
+      out.reserve( ( end - position ) / 8 + 20 );
+      out.push_back( 'B' );
+      out.push_back( 'Z' );
+      out.push_back( 'h' );
+      out.push_back( level );
+      // copy the bits of the block to a byte boundary
+      size_type first = position / 8;
+      int shift = position % 8;
+      size_type num_bytes = ( end - position ) / 8;
+      out.resize( 4 + num_bytes );
+      for ( size_type i = 0; i < num_bytes; ++i ) {
+        unsigned int c = data[ first + i ] << shift;
+        if ( shift > 0 ) c |= data[ first + i + 1 ] >> ( 8 - shift );
+        out[ 4 + i ] = static_cast< char_type >( c & 0xff );
+      }
+      BitWriter writer( out );
+      int rest = ( end - position ) % 8;
+      writer.put( getBits( position + num_bytes * 8, rest ), rest );
+      // the combined CRC of a stream of one block is the CRC of the block
+      writer.put( END_MAGIC_HIGH, 16 );
+      writer.put( END_MAGIC_LOW, 32 );
+      writer.put( crc, 32 );
+      writer.flush();
+      position = end;
+      return block;
+    }
+  }
+
+  /// Cut blocks until max_blocks are being decoded
+  void fillBlocks() {
+    while ( input_error.empty() && blocks.size() < max_blocks ) {
+      Block* block = NULL;
+      try {
+        block = nextBlock();
+      }
+      catch ( BzStreamError& e ) {
+        input_error = e.message();
+        return;
+      }
+      if ( block == NULL ) return;
+      MutexLock lock( mutex );
+      blocks.push_back( block );
+      queue.push_back( block );
+      changed.broadcast();
+    }
+  }
+
+  /// Decode a failed block joined with the next blocks of the stream
+  /// that failed as well; throws the error of the block when it still fails
+  void joinBlocks( Block* block ) {
+    int status = block->status;
+    while ( block->status != BZ_STREAM_END ) {
+      fillBlocks();
+      if ( blocks.size() < 2 ) break;
+      Block* next = blocks[ 1 ];
+      {
+        MutexLock lock( mutex );
+        while ( ! next->done ) {
+          changed.wait( mutex );
+        }
+      }
+      // a block that decodes is not the rest of the failed block
+      if ( next->status == BZ_STREAM_END || next->stream != block->stream ||
+           block->num_bits + next->num_bits > maxBlockBits( block->compressed[ 3 ] ) ) break;
+      join( *block, *next );
+      {
+        MutexLock lock( mutex );
+        blocks.erase( blocks.begin() + 1 );
+      }
+      delete next;
+      block->status = decode( *block );
+    }
+    if ( block->status != BZ_STREAM_END ) throw BzStreamError( IBzStreamBuf::errorMessage( status ) );
+  }
+
+  void stopThreads() {
+    {
+      MutexLock lock( mutex );
+      closed = true;
+      changed.broadcast();
+    }
+    for ( size_type i = 0; i < threads.size(); ++i ) {
+      threads[ i ]->join();
+      delete threads[ i ];
+    }
+    threads.clear();
+  }
+
+public:
+  /// Whether blocks can be decoded concurrently in this build
+  static bool isAvailable() {
+    return Thread::isParallel();
+  }
+
+  /// Constructor with an input stream and the number of decoding threads
+  explicit IParallelBzStreamBuf( std::istream& is, size_type num_threads )
+    : in_stream( is ), end_of_input( false ), position( 0 ),
+      in_stream_body( false ), level( '9' ), seen_stream( false ),
+      num_streams( 0 ), stream_crc( 0 ),
+      max_blocks( ( num_threads > 0 ? num_threads : 1 ) * BLOCKS_PER_THREAD + 1 ),
+      reading_front( false ), closed( false ) {
+    initMagicTable();
+    try {
+      for ( size_type i = 0; i < ( num_threads > 0 ? num_threads : 1 ); ++i ) {
+        threads.push_back( new DecodeThread( this ) );
+        threads.back()->start();
+      }
+    }
+    catch ( ... ) {
+      stopThreads();
+      throw;
+    }
+  }
+  /// Destructor
+  virtual ~IParallelBzStreamBuf() {
+    stopThreads();
+    for ( std::deque< Block* >::iterator it = blocks.begin(); it != blocks.end(); ++it ) {
+      delete *it;
+    }
+  }
+
+public:
+  /// Called when the current block is consumed
+  int underflow() {
+    if ( reading_front ) {
+      MutexLock lock( mutex );
+      delete blocks.front();
+      blocks.pop_front();
+      reading_front = false;
+    }
+    std::streambuf::setg( NULL, NULL, NULL );
+    fillBlocks();
+    if ( blocks.empty() ) {
+      if ( ! input_error.empty() ) throw BzStreamError( input_error );
+      return EOF;
+    }
+    Block* block = blocks.front();
+    {
+      MutexLock lock( mutex );
+      while ( ! block->done ) {
+        changed.wait( mutex );
+      }
+    }
+    reading_front = true;
+    if ( block->status != BZ_STREAM_END ) joinBlocks( block );
+    if ( block->text_size == 0 ) return underflow();
+    std::streambuf::setg( &block->text[ 0 ], &block->text[ 0 ], &block->text[ 0 ] + block->text_size );
+    return static_cast< unsigned char >( block->text[ 0 ] );
+  }
+};
+
+#else // AMIS_BZLIB //////////////////////////////////////////////////////////////////////
+
+class IParallelBzStreamBuf : public std::streambuf {
+public:
+  typedef size_t size_type;
+  typedef char char_type;
+
+  static bool isAvailable() {
+    return false;
+  }
+
+  explicit IParallelBzStreamBuf( std::istream&, size_type ) {
+    throw BzStreamUnsupportedError( "bzlib not supported" );
+  }
+  virtual ~IParallelBzStreamBuf() {
+  }
+};
+
+#endif // AMIS_BZLIB //////////////////////////////////////////////////////////////////////
+
+/**
+ * Input stream for uncompressing bzip2 on several threads
+ */
+
+class IParallelBzStream : public std::istream {
+private:
+  IParallelBzStreamBuf ib_buf;
+public:
+  /// Constructor with an input stream and the number of threads
+  IParallelBzStream( std::istream& is, size_t num_threads )
+    : std::istream( NULL ), ib_buf( is, num_threads ) {
+    init( &ib_buf );
+  }
+  /// Destructor
+  virtual ~IParallelBzStream() {
+  }
+};
+
+/**
+ * Input stream for bzip2 files uncompressed on several threads
+ */
+
+class IParallelBzFStream : public std::istream {
+private:
+  std::ifstream fs;
+  IParallelBzStreamBuf ib_buf;
+public:
+  /// Constructor with a file name and the number of threads
+  IParallelBzFStream( const std::string& name, size_t num_threads )
+    : std::istream( NULL ), fs( name.c_str() ), ib_buf( fs, num_threads ) {
+    init( &ib_buf );
+  }
+  /// Destructor
+  virtual ~IParallelBzFStream() {
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_ParallelBzStream_h_
+// end of ParallelBzStream.h
@@ -0,0 +1,506 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_ParallelEventInput_h_
+
+#define Amis_ParallelEventInput_h_
+
+#include <amis/configure.h>
+#include <amis/ErrorBase.h>
+#include <amis/EventArena.h>
+#include <amis/EventFormat.h>
+#include <amis/EventReader.h>
+#include <amis/EventSpace.h>
+#include <amis/Property.h>
+#include <amis/Thread.h>
+#include <amis/Tokenizer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+AMIS_NAMESPACE_BEGIN
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Notification of an event file which cannot be read
+ */
+
+class EventInputError : public ErrorBase {
+public:
+  EventInputError( const std::string& s ) : ErrorBase( s ) {}
+  /// Initialize with an error message
+  EventInputError( const char* s ) : ErrorBase( s ) {}
+  /// Initialize with an error message
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Stream buffer reading characters in memory without copying them
+ */
+
+class CharArrayBuf : public std::streambuf {
+public:
+  /// Constructor
+  CharArrayBuf( const char* begin, size_t size ) {
+    char* p = const_cast< char* >( begin );
+    setg( p, p, p + size );
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Splitter of an event file into chunks at boundaries of events.
+ * A chunk starts at the beginning of an event, so that each chunk can
+ * be parsed by its own tokenizer.  With EMPTY_LINE_DELIMITER, a chunk
+ * starts at a non-empty line following an empty line (a line of white
+ * spaces and/or a comment), and with LINE_DELIMITER, at any non-empty
+ * line.  A line following an escaped line end is never the start of a
+ * chunk.  With NO_DELIMITER, the whole file makes one chunk.
+ */
+
+class EventChunkReader {
+private:
+  std::istream& stream;
+  std::string name;
+  EventReader::EventDelimiter delimiter;
+  size_t chunk_size;
+  std::vector< char > buffer;
+  bool end_of_stream;
+  int line_number;
+
+  static bool isEmptyLine( const char* begin, const char* end ) {
+    for ( ; begin != end; ++begin ) {
+      if ( *begin == '#' ) return true;
+      if ( *begin != ' ' && *begin != '\t' && *begin != '\r' ) return false;
+    }
+    return true;
+  }
+
+  static bool isEscapedLineEnd( const char* begin, const char* end ) {
+    if ( end != begin && *( end - 1 ) == '\r' ) --end;
+    return end != begin && *( end - 1 ) == '\\';
+  }
+
+  void fill() {
+    size_t size = buffer.size();
+    buffer.resize( size + chunk_size );
+    stream.read( &buffer[ size ], chunk_size );
+    buffer.resize( size + stream.gcount() );
+    if ( stream.bad() ) {
+      // a read error must not look like a short file
+      throw EventInputError( "Cannot read input file " + name );
+    }
+    if ( ! stream ) end_of_stream = true;
+  }
+
+public:
+  /// Constructor
+  /// @param s the stream of an event file
+  /// @param n the name of the file, for error messages
+  /// @param d the delimiter of events
+  /// @param size the size of a chunk in bytes
+  EventChunkReader( std::istream& s, const std::string& n, EventReader::EventDelimiter d, size_t size )
+    : stream( s ), name( n ), delimiter( d ), chunk_size( std::max< size_t >( size, 1 ) ),
+      buffer(), end_of_stream( false ), line_number( 0 )
+  {}
+  /// Destructor
+  virtual ~EventChunkReader() {}
+
+  /// Read the next chunk.  The chunk ends at the first start of an
+  /// event after chunk_size bytes, or, when max_events > 0, before the
+  /// (max_events + 1)-th event.
+  /// @param first_line the line number at the beginning of the chunk
+  /// @param num_events the number of events starting in the chunk
+  /// @return false at the end of the stream
+  bool nextChunk( std::vector< char >& chunk, int& first_line, size_t& num_events,
+                  size_t max_events = 0 ) {
+    first_line = line_number;
+    num_events = 0;
+    int num_lines = 0;
+    bool prev_empty = true;
+    bool prev_escaped = false;
+    size_t pos = 0;
+    size_t split = 0;
+    while ( true ) {
+      const char* eol = NULL;
+      if ( pos < buffer.size() ) {
+        eol = static_cast< const char* >( std::memchr( &buffer[ pos ], '\n', buffer.size() - pos ) );
+      }
+      if ( eol == NULL ) {
+        if ( ! end_of_stream ) {
+          fill();
+          continue;
+        }
+        split = buffer.size();
+        break;
+      }
+      const char* line = &buffer[ pos ];
+      bool empty = isEmptyLine( line, eol );
+      bool event_start = ! prev_escaped && ! empty && *line != '\r'
+        && ( delimiter == EventReader::LINE_DELIMITER
+             || ( delimiter == EventReader::EMPTY_LINE_DELIMITER && prev_empty ) );
+      if ( event_start ) {
+        if ( num_events > 0 && ( max_events > 0 ? num_events >= max_events : pos >= chunk_size ) ) {
+          split = pos;
+          break;
+        }
+        ++num_events;
+      }
+      prev_empty = empty && ! prev_escaped;
+      prev_escaped = isEscapedLineEnd( line, eol );
+      ++num_lines;
+      pos += eol - line + 1;
+    }
+    if ( split == 0 ) return false;
+    std::vector< char > rest( buffer.begin() + split, buffer.end() );
+    buffer.resize( split );
+    chunk.swap( buffer );
+    buffer.swap( rest );
+    line_number += num_lines;
+    return true;
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A part of an event file (and of its reference distribution) and
+ * the events parsed from it
+ */
+
+struct EventTextChunk {
+  /// Size of the blocks of an arena; smaller than usual not to waste
+  /// the rest of the last block of each chunk
+  static const size_t ARENA_BLOCK_SIZE = 256 * 1024;
+
+  /// Index of the file
+  size_t file;
+  std::vector< char > text;
+  int first_line;
+  /// Whether the chunk has reference distributions
+  bool with_reference;
+  std::vector< char > reference_text;
+  int reference_first_line;
+  std::vector< EventBase* > events;
+  /// Arena of the events, if they are compacted
+  EventArena arena;
+  /// Whether the input stopped before the end of the chunk
+  bool stopped;
+  bool failed;
+  std::string error;
+
+  EventTextChunk()
+    : file( 0 ), first_line( 0 ), with_reference( false ), reference_first_line( 0 ),
+      arena( ARENA_BLOCK_SIZE ), stopped( false ), failed( false )
+  {}
+  /// Destructor
+  ~EventTextChunk() {
+    if ( arena.numBlocks() == 0 ) {
+      for ( size_t i = 0; i < events.size(); ++i ) {
+        delete events[ i ];
+      }
+    }
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A worker parsing chunks given by a shared counter.
+ * Each chunk is read by its own tokenizer into its own list of events,
+ * so workers share only the reader and the name table, which are not
+ * modified while events are parsed.
+ */
+
+class EventChunkInputThread : public Thread {
+public:
+  const EventFormat* format;
+  /// Whether events are compacted into the arenas of the chunks
+  bool compact;
+  std::vector< EventTextChunk* >* chunks;
+  Mutex* mutex;
+  /// Next chunk to be parsed (shared by the workers)
+  size_t* next_chunk;
+
+public:
+  /// Constructor
+  EventChunkInputThread()
+    : format( NULL ), compact( false ), chunks( NULL ), mutex( NULL ), next_chunk( NULL )
+  {}
+  /// Destructor
+  virtual ~EventChunkInputThread() {}
+
+protected:
+  void inputChunk( EventTextChunk& chunk ) {
+    CharArrayBuf buf( chunk.text.empty() ? NULL : &chunk.text[ 0 ], chunk.text.size() );
+    std::istream s( &buf );
+    Tokenizer t( s );
+    t.setLineNumber( chunk.first_line );
+    if ( ! chunk.with_reference ) {
+      chunk.stopped = ! format->inputEvents( t, chunk.events, compact ? &chunk.arena : NULL );
+    }
+    else {
+      CharArrayBuf reference_buf( chunk.reference_text.empty() ? NULL : &chunk.reference_text[ 0 ],
+                                  chunk.reference_text.size() );
+      std::istream reference_s( &reference_buf );
+      Tokenizer reference_t( reference_s );
+      reference_t.setLineNumber( chunk.reference_first_line );
+      chunk.stopped = ! format->inputEventsWithProb( t, reference_t, chunk.events,
+                                                     compact ? &chunk.arena : NULL );
+    }
+  }
+
+  void run() {
+    while ( true ) {
+      size_t i = 0;
+      {
+        MutexLock lock( *mutex );
+        if ( *next_chunk >= chunks->size() ) return;
+        i = ( *next_chunk )++;
+      }
+      EventTextChunk& chunk = *( *chunks )[ i ];
+      try {
+        inputChunk( chunk );
+      }
+      catch ( ErrorBase& e ) {
+        chunk.failed = true;
+        chunk.error = e.message();
+      }
+      catch ( std::exception& e ) {
+        chunk.failed = true;
+        chunk.error = e.what();
+      }
+      catch ( ... ) {
+        chunk.failed = true;
+        chunk.error = "Unknown exception while reading events";
+      }
+    }
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Input of event files by several threads.
+ * The files are split into chunks at boundaries of events (see
+ * EventChunkReader), and the chunks are parsed concurrently.  The
+ * events are added to the event space in the order of the files and
+ * the chunks, so that the event space, including its statistics, is
+ * the same as the one made by reading the files one by one.  When the
+ * input of a chunk stops at an empty event, the rest of the file is
+ * ignored as the sequential input does.  Chunks are processed in
+ * batches of BATCH_PER_THREAD chunks per thread, which bounds the
+ * memory for the text and the parsed events waiting to be added.
+ *
+ * With reference distributions, a chunk of a reference file holds the
+ * same number of events as the chunk of the event file.
+ */
+
+class ParallelEventInput {
+public:
+  /// Size of a chunk in bytes
+  static const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+  /// Number of chunks in a batch for each thread
+  static const size_t BATCH_PER_THREAD = 2;
+
+private:
+  EventReader* event_reader;
+  EventFormat format;
+  size_t num_threads;
+  std::string compression;
+
+  /// The file being split into chunks
+  struct FileInput {
+    size_t file;
+    /// Whether no more chunks are read from the file
+    bool finished;
+    std::auto_ptr< std::istream > event_stream;
+    std::auto_ptr< std::istream > reference_stream;
+    std::auto_ptr< EventChunkReader > event_chunks;
+    std::auto_ptr< EventChunkReader > reference_chunks;
+
+    FileInput() : file( 0 ), finished( false ) {}
+  };
+
+  static void deleteChunks( std::vector< EventTextChunk* >& chunks ) {
+    for ( size_t i = 0; i < chunks.size(); ++i ) {
+      delete chunks[ i ];
+    }
+    chunks.clear();
+  }
+
+  /// Wait for the workers that are running, ignoring their errors;
+  /// used before the chunks and the workers are deleted on an error
+  static void joinWorkers( std::vector< EventChunkInputThread* >& workers ) {
+    for ( size_t i = 0; i < workers.size(); ++i ) {
+      try {
+        workers[ i ]->join();
+      }
+      catch ( ... ) {
+      }
+    }
+  }
+
+  static void deleteWorkers( std::vector< EventChunkInputThread* >& workers ) {
+    for ( size_t i = 0; i < workers.size(); ++i ) {
+      delete workers[ i ];
+    }
+    workers.clear();
+  }
+
+  void openFile( FileInput& input, size_t i,
+                 const std::vector< std::string >& event_files,
+                 const std::vector< std::string >* reference_files ) {
+    input.file = i;
+    input.finished = false;
+    input.reference_chunks.reset();
+    input.reference_stream.reset();
+    input.event_chunks.reset();
+    input.event_stream = Property::openInputStream( event_files[ i ], compression );
+    if ( ! *input.event_stream ) {
+      throw EventInputError( "Cannot open input file " + event_files[ i ] );
+    }
+    EventReader::EventDelimiter delimiter = event_reader->eventDelimiter();
+    input.event_chunks.reset( new EventChunkReader( *input.event_stream, event_files[ i ], delimiter, CHUNK_SIZE ) );
+    if ( reference_files != NULL ) {
+      input.reference_stream = Property::openInputStream( ( *reference_files )[ i ], "raw" );
+      if ( ! *input.reference_stream ) {
+        throw EventInputError( "Cannot open input file " + ( *reference_files )[ i ] );
+      }
+      input.reference_chunks.reset( new EventChunkReader( *input.reference_stream, ( *reference_files )[ i ],
+                                                         delimiter, CHUNK_SIZE ) );
+    }
+  }
+
+  /// Read the next chunk of the files
+  EventTextChunk* nextChunk( FileInput& input,
+                             const std::vector< std::string >& event_files,
+                             const std::vector< std::string >* reference_files ) {
+    while ( true ) {
+      if ( input.event_chunks.get() == NULL || input.finished ) {
+        size_t next = input.event_chunks.get() == NULL ? 0 : input.file + 1;
+        if ( next >= event_files.size() ) return NULL;
+        openFile( input, next, event_files, reference_files );
+      }
+      std::auto_ptr< EventTextChunk > chunk( new EventTextChunk() );
+      chunk->file = input.file;
+      size_t num_events = 0;
+      if ( input.event_chunks->nextChunk( chunk->text, chunk->first_line, num_events ) ) {
+        if ( reference_files != NULL ) {
+          chunk->with_reference = true;
+          size_t num_reference_events = 0;
+          input.reference_chunks->nextChunk( chunk->reference_text, chunk->reference_first_line,
+                                             num_reference_events, std::max< size_t >( num_events, 1 ) );
+        }
+        return chunk.release();
+      }
+      input.finished = true;
+    }
+  }
+
+public:
+  /// Constructor
+  /// @param n the number of threads
+  /// @param c the compression format of the event files
+  ParallelEventInput( EventReader* er, size_t n, const std::string& c )
+    : event_reader( er ), format( er ), num_threads( std::max< size_t >( n, 1 ) ), compression( c )
+  {}
+  /// Destructor
+  virtual ~ParallelEventInput() {}
+
+  /// Input the events of files into an event space
+  /// @param reference_files reference distributions of event_files
+  /// (the same number of files), or NULL
+  void inputEventSpace( const std::vector< std::string >& event_files,
+                        const std::vector< std::string >* reference_files,
+                        EventSpace& event_space ) {
+    AMIS_PROF1( "ParallelEventInput::inputEventSpace" );
+    size_t batch_size = num_threads * BATCH_PER_THREAD;
+    Mutex mutex;
+    size_t next_chunk = 0;
+    std::vector< EventTextChunk* > chunks;
+    std::vector< EventChunkInputThread* > workers;
+    for ( size_t i = 0; i < num_threads; ++i ) {
+      workers.push_back( new EventChunkInputThread() );
+      workers[ i ]->format = &format;
+      workers[ i ]->compact = event_space.usesArena();
+      workers[ i ]->chunks = &chunks;
+      workers[ i ]->mutex = &mutex;
+      workers[ i ]->next_chunk = &next_chunk;
+    }
+    FileInput input;
+    // files whose input stopped at an empty event
+    std::vector< bool > stopped( event_files.size(), false );
+    try {
+      while ( true ) {
+        while ( chunks.size() < batch_size ) {
+          EventTextChunk* chunk = nextChunk( input, event_files, reference_files );
+          if ( chunk == NULL ) break;
+          chunks.push_back( chunk );
+        }
+        if ( chunks.empty() ) break;
+        next_chunk = 0;
+        size_t n = std::min( num_threads, chunks.size() );
+        for ( size_t i = 0; i < n; ++i ) {
+          workers[ i ]->start();
+        }
+        for ( size_t i = 0; i < n; ++i ) {
+          workers[ i ]->join();
+        }
+        for ( size_t i = 0; i < chunks.size(); ++i ) {
+          EventTextChunk& chunk = *chunks[ i ];
+          if ( stopped[ chunk.file ] ) continue;
+          if ( chunk.failed ) {
+            throw EventInputError( chunk.error );
+          }
+          AMIS_DEBUG_MESSAGE( 3, chunk.events.size() << " events from line " << chunk.first_line + 1 << " of " << event_files[ chunk.file ] << '\n' );
+          if ( event_space.usesArena() ) {
+            event_space.pushArena( chunk.events, chunk.arena );
+          }
+          else {
+            for ( size_t j = 0; j < chunk.events.size(); ++j ) {
+              event_space.pushEvent( chunk.events[ j ] );
+            }
+          }
+          chunk.events.clear();
+          if ( chunk.stopped ) {
+            stopped[ chunk.file ] = true;
+            if ( input.file == chunk.file ) input.finished = true;
+          }
+        }
+        deleteChunks( chunks );
+      }
+    }
+    catch ( ... ) {
+      joinWorkers( workers );
+      deleteChunks( chunks );
+      deleteWorkers( workers );
+      throw;
+    }
+    deleteWorkers( workers );
+    event_space.validate( event_reader );
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_ParallelEventInput_h_
+// end of ParallelEventInput.h
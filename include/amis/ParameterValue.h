@@ -17,6 +17,8 @@
 #include <amis/configure.h>
 #include <amis/Profile.h>
 #include <amis/Real.h>
+#include <amis/SparseKernel.h>
+#include <amis/LogSumExp.h>
 #include <map>
 #include <vector>
 #include <iostream>
@@ -113,7 +115,7 @@ public:
     }
   }
 
-  bool isZero() {
+  bool isZero() const {
     return lambda <= Limits::LOG_PROB_ZERO;
   }
 
@@ -137,7 +139,23 @@ public:
   /// Set the value to the summation of alphas corresponding to the members of index_list
   template < class Vector, class ID >
   void accumulate( const Vector& map_list, const std::vector< ID >& index_list ) {
-    accumulate( map_list, index_list.begin(), index_list.end() );
+    const ID* begin = index_list.empty() ? NULL : &index_list[ 0 ];
+    accumulate( map_list, begin, begin + index_list.size() );
+  }
+  /// The same for a dense vector of lambdas, by LogSumExp in the fast mode
+  void accumulate( const std::vector< LambdaValue >& map_list, const unsigned int* begin, const unsigned int* end ) {
+    if ( LogSumExp::mode() == LogSumExp::FAST && begin != end ) {
+      lambda = LogSumExp::sum( &map_list[ 0 ].lambda, begin, end );
+      return;
+    }
+    accumulate< std::vector< LambdaValue >, const unsigned int* >( map_list, begin, end );
+  }
+  void accumulate( const LambdaValue* map_list, const unsigned int* begin, const unsigned int* end ) {
+    if ( LogSumExp::mode() == LogSumExp::FAST && begin != end ) {
+      lambda = LogSumExp::sum( &map_list->lambda, begin, end );
+      return;
+    }
+    accumulate< const LambdaValue*, const unsigned int* >( map_list, begin, end );
   }
   template < class Vector, class InputIterator >
   void accumulate( const Vector& map_list, InputIterator begin, InputIterator end ) {
@@ -159,23 +177,84 @@ public:
     lambda = log( sum ) + scale;
   }
 
+  /// Divide the values in [p, end) of a vector by the largest one
   template<class Iter>
   static void scale_prob(Iter p, Iter end) {
-    Real max_weight = -REAL_INF;
-    for ( Iter i = p; i != end; ++ i) {
-      max_weight = std::max(i->getValue(), max_weight);
+    if ( p == end ) return;
+    Real* first = &p->lambda;
+    Real* last = first + ( end - p );
+    Real max_weight = LogSumExp::max( first, last );
+    for( ; first != last; ++first ) {
+      *first -= max_weight;
+    }
+  }
+
+  /// v[ *it ] += x for each it in [first, last)
+  template < class Vector, class InputIterator >
+  static void addEach( Vector& v, InputIterator first, InputIterator last, const LambdaValue& x ) {
+    for ( ; first != last; ++first ) {
+      v[ *first ] += x;
+    }
+  }
+  template < class Vector, class ID >
+  static void addEach( Vector& v, const std::vector< ID >& index_list, const LambdaValue& x ) {
+    const ID* first = index_list.empty() ? NULL : &index_list[ 0 ];
+    addEach( v, first, first + index_list.size(), x );
+  }
+  static void addEach( std::vector< LambdaValue >& v, const unsigned int* first, const unsigned int* last, const LambdaValue& x ) {
+    if ( LogSumExp::mode() == LogSumExp::FAST && first != last ) {
+      LogSumExp::addEach( &v[ 0 ].lambda, first, last, x.lambda );
+      return;
     }
-    for( ; p != end; ++p ) {
-      p->initValue(p->getValue() - max_weight );
+    addEach< std::vector< LambdaValue >, const unsigned int* >( v, first, last, x );
+  }
+  static void addEach( LambdaValue* v, const unsigned int* first, const unsigned int* last, const LambdaValue& x ) {
+    if ( LogSumExp::mode() == LogSumExp::FAST && first != last ) {
+      LogSumExp::addEach( &v->lambda, first, last, x.lambda );
+      return;
     }
+    addEach< LambdaValue*, const unsigned int* >( v, first, last, x );
   }
 
-  template < class ParameterSpace, class FeatureList >
-  static Real exponent( const ParameterSpace& parameterspace, const FeatureList& fl ) {
+  /// v[ *it ].incQuotient( x, divisor[ *it ] ) for each it in [first, last)
+  /// whose divisor is not zero
+  template < class Vector, class InputIterator >
+  static void incQuotientEach( Vector& v, const Vector& divisor,
+                               InputIterator first, InputIterator last, const LambdaValue& x ) {
+    for ( ; first != last; ++first ) {
+      if ( ! divisor[ *first ].isZero() ) {
+        v[ *first ].incQuotient( x, divisor[ *first ] );
+      }
+    }
+  }
+  static void incQuotientEach( std::vector< LambdaValue >& v, const std::vector< LambdaValue >& divisor,
+                               const unsigned int* first, const unsigned int* last, const LambdaValue& x ) {
+    if ( LogSumExp::mode() == LogSumExp::FAST && first != last ) {
+      LogSumExp::incQuotientEach( &v[ 0 ].lambda, &divisor[ 0 ].lambda, first, last, x.lambda, Limits::LOG_PROB_ZERO );
+      return;
+    }
+    incQuotientEach< std::vector< LambdaValue >, const unsigned int* >( v, divisor, first, last, x );
+  }
+
+  /// sum of lambda * freq over the features
+  template < class ParameterSpace, class Iterator >
+  static Real featureDot( const ParameterSpace& parameterspace, Iterator first, Iterator last ) {
     Real sum = 0.0;
-    for ( typename FeatureList::const_iterator feature = fl.begin(); feature != fl.end(); ++feature ) {
-      sum += parameterspace[feature->id()].getLambda() * feature->freq();
+    for ( ; first != last; ++first ) {
+      sum += parameterspace[first->id()].getLambda() * first->freq();
     }
+    return sum;
+  }
+  /// The same for a dense vector of parameters, by SparseKernel
+  template < class Iterator >
+  static Real featureDot( const std::vector< LambdaValue >& parameterspace, Iterator first, Iterator last ) {
+    if ( first == last ) return 0.0;
+    return SparseKernel::dot( &parameterspace[0].lambda, parameterspace.size(), first, last );
+  }
+
+  template < class ParameterSpace, class FeatureList >
+  static Real exponent( const ParameterSpace& parameterspace, const FeatureList& fl ) {
+    Real sum = featureDot( parameterspace, fl.begin(), fl.end() );
     if( !finite( sum ) && sum > 0.0 ) {
       sum = Limits::MAX_EXPONENT;
     }
@@ -193,25 +272,56 @@ public:
     }
   }
 
-  template < class Vector >
-  static Real scale_weight( Vector& fp, Vector& sw)
-  {
-    // do nothing
-    /*Real scale = -REAL_INF;
-    for ( typename Vector::const_iterator it = fp.begin();
-	  it != fp.end();
-	  ++it ) {
-      if ( it->lambda > scale ) {
-	scale = it->lambda;
-      }
+  /// Dense rows of weights (see FixWeightAccumulator) hold lambda, and
+  /// 0 for the targets without a feature
+  static const bool HAS_DENSE_EXPONENT = true;
+  static Real denseWeight( const LambdaValue& x ) { return x.lambda; }
+  static Real denseIdentity() { return 0.0; }
+
+  /// exponent_fix() for a dense row of weights over the targets [0, n)
+  template < class FeatureFreq >
+  static void exponent_dense( const Real* weight, FeatureFreq freq, LambdaValue* prod, size_t n ) {
+    Real* p = &prod->lambda;
+    for ( size_t i = 0; i < n; ++i ) {
+      p[ i ] += weight[ i ] * freq;
+    }
+  }
+
+  /// Rows of CRFTable are multiplied by transition matrices in the
+  /// linear domain, which the fast mode of LogSumExp allows
+  static bool denseTransition() { return LogSumExp::mode() == LogSumExp::FAST; }
+  /// The density of transitions above which they are compiled densely
+  /// by default; a matrix replaces an exp per transition with an exp per state
+  static double denseTransitionDensity() { return 0.1; }
+  /// The row [x, x + n) in the linear domain, divided by exp( shift )
+  static const Real* linearRow( const LambdaValue* x, size_t n, Real* work, Real& shift ) {
+    shift = LogSumExp::max( &x->lambda, &x->lambda + n );
+    if ( shift <= -REAL_INF ) shift = 0.0;
+    for ( size_t i = 0; i < n; ++i ) {
+      work[ i ] = exp( x[ i ].lambda - shift );
     }
-    if ( scale <= -REAL_INF ) return;
+    return work;
+  }
+  /// Set the value v * exp( shift ) given in the linear domain
+  void initLinear( Real v, Real shift ) {
+    lambda = log( v ) + shift;
+  }
 
-    for ( size_t i = 0; i < fp.size(); ++i ) {
+  /// Divide the values in [fp, fp + n), and those in [sw, sw + n)
+  /// unless sw is NULL, by the largest value in fp; return its log
+  static Real scale_weight( LambdaValue* fp, LambdaValue* sw, size_t n )
+  {
+    Real scale = LogSumExp::max( &fp->lambda, &fp->lambda + n );
+    if ( scale <= -REAL_INF || !finite( scale ) ) return 0.0;
+    for ( size_t i = 0; i < n; ++i ) {
       fp[i].lambda -= scale;
-      sw[i].lambda -= scale;
-      }*/
-    return 1.0;
+    }
+    if ( sw != NULL ) {
+      for ( size_t i = 0; i < n; ++i ) {
+	sw[i].lambda -= scale;
+      }
+    }
+    return scale;
   }
 
   /// Same as +=
@@ -258,6 +368,10 @@ public:
   }
 };
 
+// exponent_dense and linearRow read an array of LambdaValue as an array of
+// Real through &x->lambda, so the class must hold nothing but the Real
+typedef char LambdaValueLayout[ sizeof( LambdaValue ) == sizeof( Real ) ? 1 : -1 ];
+
 /// Print the value
 inline std::ostream& operator<<( std::ostream& os, const LambdaValue& x ) {
   os << x.getValue();
@@ -346,7 +460,7 @@ public:
     alpha += arg1.alpha / arg2.alpha;
   }
 
-  bool isZero() {
+  bool isZero() const {
     return alpha <= Limits::PROB_ZERO;
   }
 
@@ -384,12 +498,48 @@ public:
   template<class Iter>
   static void scale_prob(Iter , Iter ) { }
 
-  template < class ParameterSpace, class FeatureList >
-  static Real exponent( const ParameterSpace& parameterspace, const FeatureList& fl ) {
+  /// v[ *it ] += x for each it in [first, last)
+  template < class Vector, class InputIterator >
+  static void addEach( Vector& v, InputIterator first, InputIterator last, const AlphaValue& x ) {
+    for ( ; first != last; ++first ) {
+      v[ *first ] += x;
+    }
+  }
+  template < class Vector, class ID >
+  static void addEach( Vector& v, const std::vector< ID >& index_list, const AlphaValue& x ) {
+    addEach( v, index_list.begin(), index_list.end(), x );
+  }
+
+  /// v[ *it ].incQuotient( x, divisor[ *it ] ) for each it in [first, last)
+  /// whose divisor is not zero
+  template < class Vector, class InputIterator >
+  static void incQuotientEach( Vector& v, const Vector& divisor,
+                               InputIterator first, InputIterator last, const AlphaValue& x ) {
+    for ( ; first != last; ++first ) {
+      if ( ! divisor[ *first ].isZero() ) {
+        v[ *first ].incQuotient( x, divisor[ *first ] );
+      }
+    }
+  }
+
+  /// product of alpha ^ freq over the features
+  template < class ParameterSpace, class Iterator >
+  static Real featureProduct( const ParameterSpace& parameterspace, Iterator first, Iterator last ) {
     Real prod = 1.0;
-    for ( typename FeatureList::const_iterator feature = fl.begin(); feature != fl.end(); ++feature ) {
-      prod *= power( parameterspace[feature->id()].getAlpha(), feature->freq() );
+    for ( ; first != last; ++first ) {
+      prod *= power( parameterspace[first->id()].getAlpha(), first->freq() );
     }
+    return prod;
+  }
+  /// The same for binary features and a dense vector of parameters, by SparseKernel
+  static Real featureProduct( const std::vector< AlphaValue >& parameterspace, const BinaryFeature* first, const BinaryFeature* last ) {
+    if ( first == last ) return 1.0;
+    return SparseKernel::product( &parameterspace[0].alpha, parameterspace.size(), first, last );
+  }
+
+  template < class ParameterSpace, class FeatureList >
+  static Real exponent( const ParameterSpace& parameterspace, const FeatureList& fl ) {
+    Real prod = featureProduct( parameterspace, fl.begin(), fl.end() );
     if ( ! finite( prod ) ) {
       prod = exp( Limits::MAX_EXPONENT );
     }
@@ -410,26 +560,66 @@ public:
     }
   }
 
-  template < class Vector >
-  static Real scale_weight( Vector& fp, Vector& sw)
+  /// Dense rows of weights (see FixWeightAccumulator) hold alpha, and
+  /// 1 for the targets without a feature
+  static const bool HAS_DENSE_EXPONENT = true;
+  static Real denseWeight( const AlphaValue& x ) { return x.alpha; }
+  static Real denseIdentity() { return 1.0; }
+
+  /// exponent_fix() for a dense row of weights over the targets [0, n)
+  template < class FeatureFreq >
+  static void exponent_dense( const Real* weight, FeatureFreq freq, AlphaValue* prod, size_t n ) {
+    Real* p = &prod->alpha;
+    if ( freq == 1 ) {
+      for ( size_t i = 0; i < n; ++i ) {
+        p[ i ] *= weight[ i ];
+      }
+    } else {
+      for ( size_t i = 0; i < n; ++i ) {
+        if ( weight[ i ] != 1.0 ) p[ i ] *= power( weight[ i ], freq );
+      }
+    }
+  }
+
+  /// Rows of CRFTable are multiplied by transition matrices
+  static bool denseTransition() { return true; }
+  /// The density of transitions above which they are compiled densely
+  /// by default; the matrix pays off at a higher density without the
+  /// vector loops of DenseKernel
+  static double denseTransitionDensity() {
+    return SparseKernel::level() == SparseKernel::SCALAR ? 0.75 : 0.5;
+  }
+  /// The row [x, x + n) in the linear domain, divided by exp( shift )
+  static const Real* linearRow( const AlphaValue* x, size_t, Real*, Real& shift ) {
+    shift = 0.0;
+    return &x->alpha;
+  }
+  /// Set the value v * exp( shift ) given in the linear domain
+  void initLinear( Real v, Real ) {
+    alpha = v;
+  }
+
+  /// Divide the values in [fp, fp + n), and those in [sw, sw + n)
+  /// unless sw is NULL, by the largest value in fp; return its log
+  static Real scale_weight( AlphaValue* fp, AlphaValue* sw, size_t n )
   {
     Real scale = 0.0;
-    for ( typename Vector::const_iterator it = fp.begin();
-	  it != fp.end();
-	  ++it ) {
-      if ( it->alpha > scale ) {
-	scale = it->alpha;
+    for ( size_t i = 0; i < n; ++i ) {
+      if ( fp[i].alpha > scale ) {
+	scale = fp[i].alpha;
       }
     }
-    if ( scale <= 0.0 || !finite(scale) ) return 1.0;
+    if ( scale <= 0.0 || !finite(scale) ) return 0.0;
 
-    for ( size_t i = 0; i < fp.size(); ++i ) {
+    for ( size_t i = 0; i < n; ++i ) {
       fp[i].alpha /= scale;
     }
-    for ( size_t i = 0; i < sw.size(); ++i ) {
-      sw[i].alpha /= scale;
+    if ( sw != NULL ) {
+      for ( size_t i = 0; i < n; ++i ) {
+	sw[i].alpha /= scale;
+      }
     }
-    return scale;
+    return log( scale );
   }
 
 
@@ -470,6 +660,10 @@ public:
   }
 };
 
+// exponent_dense and linearRow read an array of AlphaValue as an array of
+// Real through &x->alpha, so the class must hold nothing but the Real
+typedef char AlphaValueLayout[ sizeof( AlphaValue ) == sizeof( Real ) ? 1 : -1 ];
+
 /// Print the value
 inline std::ostream& operator<<( std::ostream& os, const AlphaValue& x ) {
   os << x.getValue();
@@ -488,6 +682,356 @@ inline AlphaValue quotient( const AlphaValue arg1, const AlphaValue arg2 ) {
   return ret;
 }
 
+/// Alpha value with an extended exponent: the value is mantissa * 2^scale.
+/// Products and sums are computed on the mantissa as in AlphaValue, and the
+/// mantissa is renormalized only when it leaves [2^-384, 2^384].  The scale
+/// is always a multiple of SCALE_STEP, so that values of ordinary magnitude
+/// share the scale 0 and are added without alignment.
+class ScaledAlphaValue {
+private:
+  Real mantissa;
+  int scale;
+
+  enum { SCALE_STEP = 256 };
+
+  static Real upperMantissa() {
+    static const Real upper = ldexp( 1.0, 384 );
+    return upper;
+  }
+  static Real lowerMantissa() {
+    static const Real lower = ldexp( 1.0, -384 );
+    return lower;
+  }
+
+  /// Renormalize when the mantissa is outside [2^-384, 2^384]
+  void checkRange() {
+    if ( mantissa > upperMantissa() || mantissa < lowerMantissa() ) {
+      normalize();
+    }
+  }
+  /// Move a multiple of 2^256 from the mantissa into the scale, which
+  /// brings the mantissa into [2^-129, 2^128)
+  void normalize() {
+    if ( mantissa == 0.0 || ! finite( mantissa ) ) return;
+    int e;
+    frexp( mantissa, &e );
+    int shift = ( e + SCALE_STEP / 2 ) / SCALE_STEP;
+    if ( e + SCALE_STEP / 2 < 0 && ( e + SCALE_STEP / 2 ) % SCALE_STEP != 0 ) --shift;
+    shift *= SCALE_STEP;
+    mantissa = ldexp( mantissa, -shift );
+    scale += shift;
+  }
+
+  /// Add a value of a different scale
+  void addAligned( const ScaledAlphaValue& x ) {
+    if ( x.mantissa == 0.0 ) return;
+    if ( mantissa == 0.0 ) {
+      *this = x;
+    }
+    else if ( scale > x.scale ) {
+      mantissa += ldexp( x.mantissa, x.scale - scale );
+    }
+    else {
+      mantissa = ldexp( mantissa, scale - x.scale ) + x.mantissa;
+      scale = x.scale;
+    }
+  }
+
+  /// Multiply by a parameter raised to the frequency of a feature
+  /// (by squaring, in O(log freq) multiplications)
+  void multPower( const ScaledAlphaValue& p, int freq ) {
+    if ( freq < 0 ) {
+      multPower( p, static_cast< Real >( freq ) );
+      return;
+    }
+    ScaledAlphaValue x( p );
+    for ( ; freq > 0; freq >>= 1 ) {
+      if ( freq & 1 ) *this *= x;
+      if ( freq > 1 ) x *= x;
+    }
+  }
+  /// p ^ 0 is 1 even for a zero parameter, as pow( 0, 0 ) in AlphaValue
+  void multPower( const ScaledAlphaValue& p, Real freq ) {
+    if ( freq == 0.0 ) return;
+    ScaledAlphaValue x;
+    x.initLambda( p.getLambda() * freq );
+    *this *= x;
+  }
+
+public:
+  /// Constructor
+
+  static Real defaultValue()
+  {
+    return 1.0;
+  }
+
+  ScaledAlphaValue()
+    : mantissa( 1.0 ), scale( 0 )
+  {
+  }
+
+  explicit ScaledAlphaValue(const Real& l)
+  {
+    initLambda( l );
+  }
+
+  /// Get value
+  Real getLambda() const {
+    return log( mantissa ) + scale * M_LN2;
+  }
+
+  Real safeGetLambda() const {
+    Real ret = getLambda();
+    return ( finite( ret ) ? ret : Limits::LOG_PROB_ZERO );
+  }
+
+  Real getAlpha() const {
+    return scale == 0 ? mantissa : ldexp( mantissa, scale );
+  }
+
+  /// The value is compared and checked in log space, as in LambdaValue
+  Real getValue() const {
+    return getLambda();
+  }
+
+  /// Clear the value
+  void clear() {
+    mantissa = 0.0;
+    scale = 0;
+  }
+
+  void initValue( Real v ) {
+    initLambda( v );
+  }
+  void initValue( const ScaledAlphaValue& v ) {
+    *this = v;
+  }
+  void initAlpha( Real a ) {
+    mantissa = a;
+    scale = 0;
+    checkRange();
+  }
+  /// Initialize the value with lambda
+  void initLambda( Real l ) {
+    if ( ! finite( l ) ) {
+      mantissa = exp( l );
+      scale = 0;
+      return;
+    }
+    Real step = floor( l / ( SCALE_STEP * M_LN2 ) + 0.5 );
+    scale = static_cast< int >( step ) * SCALE_STEP;
+    mantissa = exp( l - scale * M_LN2 );
+  }
+
+  void ensureSafeValue(Real max_val, Real small_val) {
+    if( !finite( mantissa ) ) {
+      AMIS_DEBUG_MESSAGE(2, "model expect value is not finite\n");
+      initAlpha( max_val );
+    }
+    else if( mantissa == 0.0) {
+      AMIS_DEBUG_MESSAGE(2, "model expect value is zero\n" );
+      initAlpha( small_val );
+    }
+  }
+
+  void incQuotient( ScaledAlphaValue arg1, ScaledAlphaValue arg2 ) {
+    arg1.mantissa /= arg2.mantissa;
+    arg1.scale -= arg2.scale;
+    arg1.checkRange();
+    *this += arg1;
+  }
+
+  bool isZero() const {
+    return ! ( mantissa > 0.0 );
+  }
+
+  /// set reciprocal number
+  void reciprocal() {
+    mantissa = 1.0 / mantissa;
+    scale = -scale;
+  }
+
+  /// Same as *=
+  ScaledAlphaValue& operator*=( ScaledAlphaValue x ) {
+    mantissa *= x.mantissa;
+    scale += x.scale;
+    checkRange();
+    return *this;
+  }
+
+  /// Same as *=
+  ScaledAlphaValue& operator*=( Real x ) {
+    mantissa *= x;
+    checkRange();
+    return *this;
+  }
+
+  /// Set the value to the summation of alphas corresponding to the members of index_list
+  template < class Vector, class ID >
+  void accumulate( const Vector& map_list, const std::vector< ID >& index_list ) {
+    accumulate( map_list, index_list.begin(), index_list.end() );
+  }
+  template < class Vector, class InputIterator >
+  void accumulate( const Vector& map_list, InputIterator begin, InputIterator end ) {
+    ScaledAlphaValue a;
+    a.clear();
+    for ( InputIterator it = begin; it != end; ++it ) {
+      a += map_list[ *it ];
+    }
+    a.checkRange();
+    *this = a;
+  }
+
+  /// Divide the values in [p, end) by a common power of two, so that
+  /// getAlpha() of the largest one does not overflow
+  template<class Iter>
+  static void scale_prob(Iter p, Iter end) {
+    int max_scale = INT_MIN;
+    bool uniform = true;
+    for ( Iter it = p; it != end; ++it ) {
+      if ( it->mantissa == 0.0 ) continue;
+      if ( max_scale != INT_MIN && it->scale != max_scale ) uniform = false;
+      max_scale = std::max( max_scale, it->scale );
+    }
+    if ( max_scale == INT_MIN || ( uniform && max_scale == 0 ) ) return;
+    for ( ; p != end; ++p ) {
+      p->mantissa = ldexp( p->mantissa, p->scale - max_scale );
+      p->scale = 0;
+    }
+  }
+
+  /// v[ *it ] += x for each it in [first, last)
+  template < class Vector, class InputIterator >
+  static void addEach( Vector& v, InputIterator first, InputIterator last, const ScaledAlphaValue& x ) {
+    for ( ; first != last; ++first ) {
+      v[ *first ] += x;
+    }
+  }
+  template < class Vector, class ID >
+  static void addEach( Vector& v, const std::vector< ID >& index_list, const ScaledAlphaValue& x ) {
+    addEach( v, index_list.begin(), index_list.end(), x );
+  }
+
+  /// v[ *it ].incQuotient( x, divisor[ *it ] ) for each it in [first, last)
+  /// whose divisor is not zero
+  template < class Vector, class InputIterator >
+  static void incQuotientEach( Vector& v, const Vector& divisor,
+                               InputIterator first, InputIterator last, const ScaledAlphaValue& x ) {
+    for ( ; first != last; ++first ) {
+      if ( ! divisor[ *first ].isZero() ) {
+        v[ *first ].incQuotient( x, divisor[ *first ] );
+      }
+    }
+  }
+
+  /// product of alpha ^ freq over the features
+  template < class ParameterSpace, class FeatureList >
+  static ScaledAlphaValue exponent( const ParameterSpace& parameterspace, const FeatureList& fl ) {
+    ScaledAlphaValue prod;
+    for ( typename FeatureList::const_iterator it = fl.begin(); it != fl.end(); ++it ) {
+      prod.multPower( parameterspace[it->id()], it->freq() );
+    }
+    return prod;
+  }
+
+  template < class ParameterSpace, class FeatureList, class FeatureFreq, class Vector >
+  static void exponent_fix( const ParameterSpace& parameterspace, const FeatureList& fv, FeatureFreq& freq, Vector& prod)
+  {
+    for ( typename FeatureList::const_iterator it = fv.begin();
+	  it != fv.end();
+	  ++it ) {
+      prod[it->first].multPower( parameterspace[it->second], freq );
+    }
+  }
+
+  /// Dense rows lose the range of scaled values, so FixWeightAccumulator
+  /// keeps the sparse path; these are the same in lambda
+  static const bool HAS_DENSE_EXPONENT = false;
+  static Real denseWeight( const ScaledAlphaValue& x ) { return x.getLambda(); }
+  static Real denseIdentity() { return 0.0; }
+
+  template < class FeatureFreq >
+  static void exponent_dense( const Real* weight, FeatureFreq freq, ScaledAlphaValue* prod, size_t n ) {
+    for ( size_t i = 0; i < n; ++i ) {
+      if ( weight[ i ] != 0.0 ) prod[ i ].multPower( ScaledAlphaValue( weight[ i ] ), freq );
+    }
+  }
+
+  /// Transition matrices of plain reals lose the range of scaled
+  /// values, so CRFTable keeps the sparse path
+  static bool denseTransition() { return false; }
+  static double denseTransitionDensity() { return 2.0; }
+  static const Real* linearRow( const ScaledAlphaValue* x, size_t n, Real* work, Real& shift ) {
+    shift = -REAL_INF;
+    for ( size_t i = 0; i < n; ++i ) {
+      shift = std::max( shift, x[ i ].getLambda() );
+    }
+    if ( shift <= -REAL_INF ) shift = 0.0;
+    for ( size_t i = 0; i < n; ++i ) {
+      work[ i ] = exp( x[ i ].getLambda() - shift );
+    }
+    return work;
+  }
+  void initLinear( Real v, Real shift ) {
+    initLambda( log( v ) + shift );
+  }
+
+  static Real scale_weight( ScaledAlphaValue* , ScaledAlphaValue* , size_t )
+  {
+    // the range of the values is wide enough
+    return 0.0;
+  }
+
+  /// Same as +=
+  ScaledAlphaValue& operator+=( const ScaledAlphaValue& x ) {
+    if ( scale == x.scale ) {
+      mantissa += x.mantissa;
+    }
+    else {
+      addAligned( x );
+    }
+    return *this;
+  }
+  /// Same as +=
+  ScaledAlphaValue& operator+=( const Real& x ) {
+    ScaledAlphaValue a;
+    a.initAlpha( x );
+    return *this += a;
+  }
+
+  ScaledAlphaValue& incLambda( const Real& x ) {
+    return *this *= ScaledAlphaValue( x );
+  }
+
+  ScaledAlphaValue& multLambda( const Real& x ) {
+    initLambda( getLambda() * x );
+    return *this;
+  }
+
+  friend ScaledAlphaValue quotient( const ScaledAlphaValue arg1, const ScaledAlphaValue arg2 );
+};
+
+/// Print the value
+inline std::ostream& operator<<( std::ostream& os, const ScaledAlphaValue& x ) {
+  os << x.getValue();
+  return os;
+}
+
+inline ScaledAlphaValue product( const ScaledAlphaValue arg1, const ScaledAlphaValue arg2 ) {
+  ScaledAlphaValue ret( arg1 );
+  ret *= arg2;
+  return ret;
+}
+
+inline ScaledAlphaValue quotient( const ScaledAlphaValue arg1, const ScaledAlphaValue arg2 ) {
+  ScaledAlphaValue ret( arg1 );
+  ret.mantissa /= arg2.mantissa;
+  ret.scale -= arg2.scale;
+  ret.checkRange();
+  return ret;
+}
+
 AMIS_NAMESPACE_END
 
 #endif // Amis_ParameterValue_h_
@@ -0,0 +1,266 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_PipeStream_h_
+
+#define Amis_PipeStream_h_
+
+#include <amis/configure.h>
+#include <amis/ErrorBase.h>
+#include <amis/Thread.h>
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+AMIS_NAMESPACE_BEGIN
+
+/**
+ * This class signals an error in the source of a pipe stream
+ */
+class PipeStreamError : public ErrorBase {
+public:
+  /// Initialize with an error message
+  explicit PipeStreamError( const std::string& s ) : ErrorBase( s ) {}
+  /// Initialize with an error message
+  explicit PipeStreamError( const char* s ) : ErrorBase( s ) {}
+  /// Destructor
+  virtual ~PipeStreamError() {}
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Input buffer that reads a source stream on a separate thread.
+ * The thread reads large blocks of the source (typically a
+ * decompressing stream) into a ring of buffers, while the reader of
+ * this buffer consumes the blocks already filled.  Decompression and
+ * tokenization thus run concurrently.
+ *
+ * An error of the source is thrown by underflow() after the data read
+ * before the error are consumed.
+ *
+ * The reading thread waits for a free block, so this class requires
+ * "--enable-parallel"; see isAvailable().
+ */
+
+class IPipeStreamBuf : public std::streambuf {
+public:
+  /// Type of size
+  typedef size_t size_type;
+  /// Type of data
+  typedef char char_type;
+  /// Default size of a block
+  static const size_type DEFAULT_BLOCK_SIZE = 1024 * 1024;
+  /// Default number of blocks
+  static const size_type DEFAULT_NUM_BLOCKS = 4;
+
+private:
+  class ReaderThread : public Thread {
+  private:
+    IPipeStreamBuf* pipe;
+  public:
+    explicit ReaderThread( IPipeStreamBuf* p ) : pipe( p ) {}
+  protected:
+    void run() { pipe->produce(); }
+  };
+
+  std::auto_ptr< std::istream > source;
+  size_type block_size;
+  std::vector< char_type* > blocks;
+  std::vector< size_type > block_sizes;
+
+  Mutex mutex;
+  Condition changed;
+  size_type num_produced;   // blocks filled by the reader thread
+  size_type num_consumed;   // blocks handed to the consumer
+  size_type num_released;   // blocks the consumer has finished with
+  bool finished;
+  bool closed;
+  bool failed;
+  std::string error_message;
+
+  ReaderThread reader;
+
+  /// Read a block from the source; count holds the size read so far
+  /// even when the source throws an error
+  void readBlock( char_type* block, size_type& count ) {
+    std::streambuf* buf = source->rdbuf();
+    while ( count < block_size ) {
+      std::streamsize available = buf->in_avail();
+      if ( available <= 0 ) {
+        if ( buf->sgetc() == EOF ) return;
+        continue;
+      }
+      count += buf->sgetn( block + count, std::min( static_cast< size_type >( available ), block_size - count ) );
+    }
+  }
+
+  /// Body of the reader thread
+  void produce() {
+    size_type index = 0;
+    size_type count = 0;  // the size of blocks[ index ] not yet published
+    bool error = false;
+    std::string message;
+    try {
+      while ( true ) {
+        {
+          MutexLock lock( mutex );
+          if ( count > 0 ) {
+            block_sizes[ index ] = count;
+            ++num_produced;
+            count = 0;
+            changed.broadcast();
+          }
+          while ( ! closed && num_produced - num_released == blocks.size() ) {
+            changed.wait( mutex );
+          }
+          if ( closed ) break;
+          index = num_produced % blocks.size();
+        }
+        // the block is not visible to the consumer until num_produced is incremented
+        readBlock( blocks[ index ], count );
+        if ( count == 0 ) break;
+      }
+    }
+    catch ( ErrorBase& e ) {
+      error = true;
+      message = e.message();
+    }
+    catch ( std::exception& e ) {
+      error = true;
+      message = e.what();
+    }
+    catch ( ... ) {
+      error = true;
+      message = "Unknown error in the source of a pipe stream";
+    }
+    MutexLock lock( mutex );
+    if ( count > 0 ) {
+      // the data read before an error are delivered before the error
+      block_sizes[ index ] = count;
+      ++num_produced;
+    }
+    failed = error;
+    error_message = message;
+    finished = true;
+    changed.broadcast();
+  }
+
+  static size_type checkNumBlocks( size_type n ) {
+    if ( n < 2 ) throw PipeStreamError( "A pipe stream requires at least 2 blocks" );
+    return n;
+  }
+
+  IPipeStreamBuf( const IPipeStreamBuf& );
+  IPipeStreamBuf& operator=( const IPipeStreamBuf& );
+
+public:
+  /// Whether a pipe stream can be used in this build
+  static bool isAvailable() {
+    return Thread::isParallel();
+  }
+
+  /// Constructor; the buffer takes the ownership of the source stream.
+  /// At least two blocks are required, one read by the consumer while
+  /// the thread fills the other.
+  explicit IPipeStreamBuf( std::auto_ptr< std::istream > s,
+                           size_type b = DEFAULT_BLOCK_SIZE,
+                           size_type n = DEFAULT_NUM_BLOCKS )
+    : source( s ), block_size( b > 0 ? b : DEFAULT_BLOCK_SIZE ),
+      blocks( checkNumBlocks( n ), NULL ), block_sizes( blocks.size(), 0 ),
+      num_produced( 0 ), num_consumed( 0 ), num_released( 0 ),
+      finished( false ), closed( false ), failed( false ),
+      reader( this ) {
+    for ( size_type i = 0; i < blocks.size(); ++i ) {
+      blocks[ i ] = new char_type[ block_size ];
+    }
+    try {
+      reader.start();
+    }
+    catch ( ... ) {
+      for ( size_type i = 0; i < blocks.size(); ++i ) {
+        delete [] blocks[ i ];
+      }
+      throw;
+    }
+  }
+  /// Destructor; stops the reader thread even if the source is not read to the end
+  virtual ~IPipeStreamBuf() {
+    {
+      MutexLock lock( mutex );
+      closed = true;
+      changed.broadcast();
+    }
+    try {
+      reader.join();
+    }
+    catch ( ThreadError& ) {
+      // not reached: produce() keeps every error for underflow()
+    }
+    for ( size_type i = 0; i < blocks.size(); ++i ) {
+      delete [] blocks[ i ];
+    }
+  }
+
+public:
+  /// Called when the current block is consumed
+  int underflow() {
+    MutexLock lock( mutex );
+    if ( num_consumed > num_released ) {
+      // give the current block back to the reader thread
+      ++num_released;
+      changed.broadcast();
+    }
+    while ( num_consumed == num_produced && ! finished ) {
+      changed.wait( mutex );
+    }
+    if ( num_consumed == num_produced ) {
+      std::streambuf::setg( NULL, NULL, NULL );
+      if ( failed ) throw PipeStreamError( error_message );
+      return EOF;
+    }
+    size_type index = num_consumed % blocks.size();
+    ++num_consumed;
+    std::streambuf::setg( blocks[ index ], blocks[ index ], blocks[ index ] + block_sizes[ index ] );
+    return static_cast< unsigned char >( *blocks[ index ] );
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Input stream that reads another stream on a separate thread
+ */
+
+class IPipeStream : public std::istream {
+private:
+  IPipeStreamBuf pipe_buf;
+public:
+  /// Constructor with a source stream, the size and the number of blocks
+  explicit IPipeStream( std::auto_ptr< std::istream > s,
+                        size_t b = IPipeStreamBuf::DEFAULT_BLOCK_SIZE,
+                        size_t n = IPipeStreamBuf::DEFAULT_NUM_BLOCKS )
+    : std::istream( NULL ), pipe_buf( s, b, n ) {
+    init( &pipe_buf );
+  }
+  /// Destructor
+  virtual ~IPipeStream() {
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_PipeStream_h_
+// end of PipeStream.h
@@ -23,6 +23,7 @@
 #include <amis/EventReaderLauncher.h>
 #include <amis/EstimatorLauncher.h>
 #include <amis/GaussianPriorLauncher.h>
+#include <amis/LogSumExp.h>
 //#include <amis/StatisticsLauncher.h>
 //#include <amis/EstimatorStateLauncher.h>
 #include <amis/DataFormat.h>
@@ -89,6 +90,7 @@ private:
   static PropertyItemVector< std::string > model_file_list;
   static PropertyItemVector< std::string > event_file_list;
   static PropertyItemVector< std::string > fixmap_file_list;
+  static PropertyItemVector< std::string > restriction_file_list;
   static PropertyItemVector< std::string > transition_file_list;
   
   //static PropertyItem< bool > event_file_bz2;
@@ -96,7 +98,11 @@ private:
   static PropertyItem< std::string > model_file_compression;
   static PropertyItem< std::string > output_file_compression;
   static PropertyItem< std::string > fixmap_file_compression;
+  static PropertyItem< std::string > fix_target_layout;
   static PropertyItem< std::string > transition_file_compression;
+  static PropertyItem< std::string > crf_transition_layout;
+  static PropertyItem< int > decompression_buffers;
+  static PropertyItem< int > decompression_buffer_size;
 
   static PropertyItemVector< std::string > reference_file_list;
   static PropertyItem< std::string > output_file;
@@ -111,7 +117,12 @@ private:
   static PropertyItem< int > prec;
   static PropertyItem< bool > event_on_file;
   static PropertyItem< std::string > event_on_file_name;
+  static PropertyItem< std::string > event_on_file_encoding;
+  static PropertyItem< std::string > event_cache;
+  static PropertyItem< std::string > write_event_cache;
   static PropertyItem< int > num_threads;
+  static PropertyItem< std::string > reduction;
+  static PropertyItem< std::string > log_sum_exp;
   static PropertyItem< bool > till_convergence;
   static PropertyItem< bool > suppress_message;
   static PropertyItem< std::string > variance_type;
@@ -295,6 +306,10 @@ public:
     return prefixByRootDir( fixmap_file_list.getValue() );
   }
 
+  std::vector< std::string > getRestrictionFileList() const {
+    return prefixByRootDir( restriction_file_list.getValue() );
+  }
+
   std::vector< std::string > getTransitionFileList() const {
     return prefixByRootDir( transition_file_list.getValue() );
   }
@@ -314,9 +329,21 @@ public:
   std::string getFixMapFileCompression() const {
     return fixmap_file_compression.getValue();
   }
+  std::string getFixTargetLayout() const {
+    return fix_target_layout.getValue();
+  }
   std::string getTransitionFileCompression() const {
     return transition_file_compression.getValue();
   }
+  std::string getCRFTransitionLayout() const {
+    return crf_transition_layout.getValue();
+  }
+  int getDecompressionBuffers() const {
+    return decompression_buffers.getValue();
+  }
+  int getDecompressionBufferSize() const {
+    return decompression_buffer_size.getValue();
+  }
 
 
 
@@ -401,9 +428,24 @@ public:
     }
     return event_on_file_stream;
   }
+  const std::string& getEventOnFileEncoding() const {
+    return event_on_file_encoding.getValue();
+  }
+  std::string getEventCache() const {
+    return event_cache.getValue().empty() ? std::string() : prefixByRootDir( event_cache.getValue() );
+  }
+  std::string getWriteEventCache() const {
+    return write_event_cache.getValue().empty() ? std::string() : prefixByRootDir( write_event_cache.getValue() );
+  }
   int getNumThreads() const {
     return num_threads.getValue();
   }
+  const std::string& getReduction() const {
+    return reduction.getValue();
+  }
+  const std::string& getLogSumExp() const {
+    return log_sum_exp.getValue();
+  }
   bool getTillConvergence() const {
     return till_convergence.getValue();
   }
@@ -448,7 +490,11 @@ public:
   virtual EventSpacePtr newEventSpace() throw( IllegalPropertyError ) {
     try {
       if ( isEventOnFile() ) {
+	if ( getEventOnFileEncoding() != "raw" && getEventOnFileEncoding() != "compact" ) {
+	  throw IllegalPropertyError( "Unknown event-on-file encoding: " + getEventOnFileEncoding() );
+	}
 	objstream* os = eventOnFileStream();
+	os->setCompact( getEventOnFileEncoding() == "compact" );
 	return EventSpacePtr( new EventSpaceOnFile( os ) );
       }
       else {
@@ -491,12 +537,20 @@ public:
     }
     }*/
   virtual EstimatorPtr newEstimator() throw( IllegalPropertyError ) {
+    if ( getReduction() != "fast" && getReduction() != "deterministic" ) {
+      throw IllegalPropertyError( "Unknown reduction: " + getReduction() );
+    }
+    if ( getLogSumExp() != "exact" && getLogSumExp() != "fast" ) {
+      throw IllegalPropertyError( "Unknown log-sum-exp: " + getLogSumExp() );
+    }
+    LogSumExp::setMode( getLogSumExp() == "fast" ? LogSumExp::FAST : LogSumExp::EXACT );
     try {
       EstimatorPtr estimator =
       estimator_launcher.launch( EstimatorIdentifier( getEstimationAlgorithm() ),
 				 this );
               estimator->setSuppressMessage( getSuppressMessage() );
               estimator->setTillConvergence( getTillConvergence() );
+              estimator->setDeterministicReduction( getReduction() == "deterministic" );
               return estimator;
     } catch ( IllegalLauncherItemError& ) {
       std::string args( getFeatureType() + ',' + getModelType() + ',' + getEventType() );
@@ -0,0 +1,327 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_SparseKernel_h_
+
+#define Amis_SparseKernel_h_
+
+#include <amis/configure.h>
+#include <amis/Real.h>
+#include <amis/Feature.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Vector kernels need GCC's target attributes and x86 gathers
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) ) && \
+    ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) ) && \
+    ! defined( AMIS_USE_LONG_DOUBLE ) && ! defined( AMIS_NO_SIMD )
+#define AMIS_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+AMIS_NAMESPACE_BEGIN
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Kernels over a list of features and a dense array of weights.
+ *
+ * dot() computes sum( weight[ id ] * freq ), which is the inner loop of
+ * LambdaValue::exponent, and product() computes prod( weight[ id ] ) for
+ * binary features (AlphaValue::exponent).  On x86 processors with AVX2
+ * or AVX-512, which are detected at run time, the weights are loaded by
+ * gather instructions; otherwise, and for short lists, a scalar loop is
+ * used.  The vector kernels add the terms in a different order from the
+ * scalar loop, so results may differ in the last bits between machines.
+ * The environment variable AMIS_SIMD=none|avx2|avx512 caps the level.
+ */
+
+class SparseKernel {
+public:
+  /// Instruction sets used by the kernels
+  enum Level { SCALAR = 0, AVX2 = 1, AVX512 = 2 };
+  /// Lists shorter than this are processed by the scalar loop
+  /// (gathers do not pay for their setup on shorter lists)
+  static const size_t MIN_VECTOR_LENGTH = 64;
+  /// Gathers take signed 32-bit indices
+  static const size_t MAX_VECTOR_WEIGHTS = 0x7fffffff;
+
+private:
+  static int detectLevel() {
+    int l = SCALAR;
+#ifdef AMIS_SIMD_X86
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) ) {
+      l = AVX2;
+      if ( __builtin_cpu_supports( "avx512f" ) ) l = AVX512;
+    }
+    const char* env = std::getenv( "AMIS_SIMD" );
+    if ( env != NULL ) {
+      if ( std::strcmp( env, "none" ) == 0 ) l = SCALAR;
+      else if ( std::strcmp( env, "avx2" ) == 0 && l > AVX2 ) l = AVX2;
+    }
+#endif // AMIS_SIMD_X86
+    return l;
+  }
+
+#ifdef AMIS_SIMD_X86
+public:
+  /// w[ idx[ k ] ] for each of the four lanes.  The unmasked gather
+  /// intrinsics leave their source operand undefined, which GCC reports
+  /// as a read of an uninitialized value; a masked gather of all lanes
+  /// over a zero source does the same without the warning.
+  __attribute__(( target( "avx2" ) ))
+  static __m256d gather4( const double* w, __m128i idx ) {
+    return _mm256_mask_i32gather_pd( _mm256_setzero_pd(), w, idx,
+                                     _mm256_castsi256_pd( _mm256_set1_epi64x( -1 ) ), 8 );
+  }
+  /// w[ idx[ k ] ] for each of the eight lanes (see gather4)
+  __attribute__(( target( "avx512f" ) ))
+  static __m512d gather8( const double* w, __m256i idx ) {
+    return _mm512_mask_i32gather_pd( _mm512_setzero_pd(), static_cast< __mmask8 >( 0xff ), idx, w, 8 );
+  }
+
+private:
+  // The layouts below are read directly by the vector loads
+  typedef char BinaryFeatureLayout[ sizeof( BinaryFeature ) == sizeof( FeatureID ) ? 1 : -1 ];
+  typedef char IntegerFeatureLayout[ sizeof( IntegerFeature ) == 2 * sizeof( FeatureID ) ? 1 : -1 ];
+  typedef char RealFeatureLayout[ sizeof( RealFeature ) == 2 * sizeof( double ) ? 1 : -1 ];
+
+  __attribute__(( target( "avx2" ) ))
+  static double hsum( __m256d v ) {
+    __m128d s = _mm_add_pd( _mm256_castpd256_pd128( v ), _mm256_extractf128_pd( v, 1 ) );
+    return _mm_cvtsd_f64( _mm_add_sd( s, _mm_unpackhi_pd( s, s ) ) );
+  }
+  __attribute__(( target( "avx2" ) ))
+  static double hprod( __m256d v ) {
+    __m128d s = _mm_mul_pd( _mm256_castpd256_pd128( v ), _mm256_extractf128_pd( v, 1 ) );
+    return _mm_cvtsd_f64( _mm_mul_sd( s, _mm_unpackhi_pd( s, s ) ) );
+  }
+  // The AVX-512 intrinsics that take no source operand (reduce, cast,
+  // extract, convert, permute) are built on an undefined one in GCC and
+  // have the same problem as the gathers, so zero-masked forms are used
+  __attribute__(( target( "avx512f" ) ))
+  static double hsum( __m512d v ) {
+    const __mmask8 all = static_cast< __mmask8 >( 0xf );
+    return hsum( _mm256_add_pd( _mm512_maskz_extractf64x4_pd( all, v, 0 ),
+                                _mm512_maskz_extractf64x4_pd( all, v, 1 ) ) );
+  }
+  __attribute__(( target( "avx512f" ) ))
+  static __m256i lowerHalf( __m512i v ) {
+    return _mm512_maskz_extracti64x4_epi64( static_cast< __mmask8 >( 0xf ), v, 0 );
+  }
+  /// The upper eight 32-bit integers of v as doubles
+  __attribute__(( target( "avx512f" ) ))
+  static __m512d upperToDouble( __m512i v ) {
+    return _mm512_maskz_cvtepi32_pd( static_cast< __mmask8 >( 0xff ),
+                                     _mm512_maskz_extracti64x4_epi64( static_cast< __mmask8 >( 0xf ), v, 1 ) );
+  }
+
+  __attribute__(( target( "avx2,fma" ) ))
+  static double dotAVX2( const double* w, const BinaryFeature* f, size_t n ) {
+    const int* id = reinterpret_cast< const int* >( f );
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8 ) {
+      acc0 = _mm256_add_pd( acc0, gather4( w, _mm_loadu_si128( reinterpret_cast< const __m128i* >( id + i ) ) ) );
+      acc1 = _mm256_add_pd( acc1, gather4( w, _mm_loadu_si128( reinterpret_cast< const __m128i* >( id + i + 4 ) ) ) );
+    }
+    if ( i + 4 <= n ) {
+      acc0 = _mm256_add_pd( acc0, gather4( w, _mm_loadu_si128( reinterpret_cast< const __m128i* >( id + i ) ) ) );
+      i += 4;
+    }
+    double sum = hsum( _mm256_add_pd( acc0, acc1 ) );
+    for ( ; i < n; ++i ) sum += w[ f[ i ].id() ];
+    return sum;
+  }
+
+  __attribute__(( target( "avx2,fma" ) ))
+  static double dotAVX2( const double* w, const IntegerFeature* f, size_t n ) {
+    // (id, freq) pairs -> ids in the lower half, freqs in the upper half
+    const __m256i split = _mm256_setr_epi32( 0, 2, 4, 6, 1, 3, 5, 7 );
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8 ) {
+      __m256i v0 = _mm256_permutevar8x32_epi32( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( f + i ) ), split );
+      __m256i v1 = _mm256_permutevar8x32_epi32( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( f + i + 4 ) ), split );
+      acc0 = _mm256_fmadd_pd( gather4( w, _mm256_castsi256_si128( v0 ) ),
+                              _mm256_cvtepi32_pd( _mm256_extracti128_si256( v0, 1 ) ), acc0 );
+      acc1 = _mm256_fmadd_pd( gather4( w, _mm256_castsi256_si128( v1 ) ),
+                              _mm256_cvtepi32_pd( _mm256_extracti128_si256( v1, 1 ) ), acc1 );
+    }
+    if ( i + 4 <= n ) {
+      __m256i v0 = _mm256_permutevar8x32_epi32( _mm256_loadu_si256( reinterpret_cast< const __m256i* >( f + i ) ), split );
+      acc0 = _mm256_fmadd_pd( gather4( w, _mm256_castsi256_si128( v0 ) ),
+                              _mm256_cvtepi32_pd( _mm256_extracti128_si256( v0, 1 ) ), acc0 );
+      i += 4;
+    }
+    double sum = hsum( _mm256_add_pd( acc0, acc1 ) );
+    for ( ; i < n; ++i ) sum += w[ f[ i ].id() ] * f[ i ].freq();
+    return sum;
+  }
+
+  __attribute__(( target( "avx2,fma" ) ))
+  static double dotAVX2( const double* w, const RealFeature* f, size_t n ) {
+    // two (id, pad, freq) records per load; gather ids and freqs of four
+    const __m256i pick = _mm256_setr_epi32( 0, 4, 2, 6, 0, 4, 2, 6 );
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      __m256d a = _mm256_loadu_pd( reinterpret_cast< const double* >( f + i ) );
+      __m256d b = _mm256_loadu_pd( reinterpret_cast< const double* >( f + i + 2 ) );
+      __m256d freq = _mm256_permute4x64_pd( _mm256_unpackhi_pd( a, b ), 0xD8 );
+      __m256i id = _mm256_permutevar8x32_epi32( _mm256_castpd_si256( _mm256_unpacklo_pd( a, b ) ), pick );
+      acc = _mm256_fmadd_pd( gather4( w, _mm256_castsi256_si128( id ) ), freq, acc );
+    }
+    double sum = hsum( acc );
+    for ( ; i < n; ++i ) sum += w[ f[ i ].id() ] * f[ i ].freq();
+    return sum;
+  }
+
+  __attribute__(( target( "avx2" ) ))
+  static double productAVX2( const double* w, const BinaryFeature* f, size_t n ) {
+    const int* id = reinterpret_cast< const int* >( f );
+    __m256d acc = _mm256_set1_pd( 1.0 );
+    size_t i = 0;
+    for ( ; i + 4 <= n; i += 4 ) {
+      acc = _mm256_mul_pd( acc, gather4( w, _mm_loadu_si128( reinterpret_cast< const __m128i* >( id + i ) ) ) );
+    }
+    double prod = hprod( acc );
+    for ( ; i < n; ++i ) prod *= w[ f[ i ].id() ];
+    return prod;
+  }
+
+  __attribute__(( target( "avx512f" ) ))
+  static double dotAVX512( const double* w, const BinaryFeature* f, size_t n ) {
+    const int* id = reinterpret_cast< const int* >( f );
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for ( ; i + 16 <= n; i += 16 ) {
+      acc0 = _mm512_add_pd( acc0, gather8( w, _mm256_loadu_si256( reinterpret_cast< const __m256i* >( id + i ) ) ) );
+      acc1 = _mm512_add_pd( acc1, gather8( w, _mm256_loadu_si256( reinterpret_cast< const __m256i* >( id + i + 8 ) ) ) );
+    }
+    acc0 = _mm512_add_pd( acc0, acc1 );
+    if ( i < n ) {
+      // the tail is gathered under a mask
+      __mmask8 m = static_cast< __mmask8 >( ( 1u << std::min< size_t >( n - i, 8 ) ) - 1 );
+      __m256i idx = lowerHalf( _mm512_maskz_loadu_epi32( m, id + i ) );
+      acc0 = _mm512_add_pd( acc0, _mm512_mask_i32gather_pd( _mm512_setzero_pd(), m, idx, w, 8 ) );
+      i += 8;
+      if ( i < n ) {
+        m = static_cast< __mmask8 >( ( 1u << ( n - i ) ) - 1 );
+        idx = lowerHalf( _mm512_maskz_loadu_epi32( m, id + i ) );
+        acc0 = _mm512_add_pd( acc0, _mm512_mask_i32gather_pd( _mm512_setzero_pd(), m, idx, w, 8 ) );
+      }
+    }
+    return hsum( acc0 );
+  }
+
+  __attribute__(( target( "avx512f" ) ))
+  static double dotAVX512( const double* w, const IntegerFeature* f, size_t n ) {
+    const __m512i split = _mm512_setr_epi32( 0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15 );
+    __m512d acc = _mm512_setzero_pd();
+    size_t i = 0;
+    for ( ; i + 8 <= n; i += 8 ) {
+      __m512i v = _mm512_maskz_permutexvar_epi32( static_cast< __mmask16 >( 0xffff ), split, _mm512_loadu_si512( f + i ) );
+      acc = _mm512_fmadd_pd( gather8( w, lowerHalf( v ) ),
+                             upperToDouble( v ), acc );
+    }
+    if ( i < n ) {
+      __mmask16 m = static_cast< __mmask16 >( ( 1u << ( 2 * ( n - i ) ) ) - 1 );
+      __m512i v = _mm512_maskz_permutexvar_epi32( static_cast< __mmask16 >( 0xffff ), split, _mm512_maskz_loadu_epi32( m, f + i ) );
+      __mmask8 m8 = static_cast< __mmask8 >( ( 1u << ( n - i ) ) - 1 );
+      acc = _mm512_fmadd_pd( _mm512_mask_i32gather_pd( _mm512_setzero_pd(), m8, lowerHalf( v ), w, 8 ),
+                             upperToDouble( v ), acc );
+    }
+    return hsum( acc );
+  }
+
+  template < class Feature >
+  static double dotVector( const double* w, const Feature* f, size_t n ) {
+    return level() == AVX512 ? dotAVX512( w, f, n ) : dotAVX2( w, f, n );
+  }
+  static double dotVector( const double* w, const RealFeature* f, size_t n ) {
+    return dotAVX2( w, f, n );
+  }
+#endif // AMIS_SIMD_X86
+
+  template < class Iterator >
+  static Real dotScalar( const Real* w, Iterator first, Iterator last ) {
+    Real sum = 0.0;
+    for ( ; first != last; ++first ) {
+      sum += w[ first->id() ] * first->freq();
+    }
+    return sum;
+  }
+
+  template < class Feature >
+  static Real dotDispatch( const Real* w, size_t num_weights, const Feature* first, const Feature* last ) {
+#ifdef AMIS_SIMD_X86
+    size_t n = last - first;
+    if ( n >= MIN_VECTOR_LENGTH && num_weights <= MAX_VECTOR_WEIGHTS && level() != SCALAR ) {
+      return dotVector( w, first, n );
+    }
+#endif // AMIS_SIMD_X86
+    return dotScalar( w, first, last );
+  }
+
+public:
+  /// Instruction set chosen for this process
+  static int level() {
+    static const int l = detectLevel();
+    return l;
+  }
+  /// Name of an instruction set
+  static const char* levelName( int l ) {
+    return l == AVX512 ? "avx512" : ( l == AVX2 ? "avx2" : "none" );
+  }
+
+  /// sum( w[ id ] * freq ) over [first, last); w has num_weights elements
+  template < class Iterator >
+  static Real dot( const Real* w, size_t, Iterator first, Iterator last ) {
+    return dotScalar( w, first, last );
+  }
+  static Real dot( const Real* w, size_t num_weights, const BinaryFeature* first, const BinaryFeature* last ) {
+    return dotDispatch( w, num_weights, first, last );
+  }
+  static Real dot( const Real* w, size_t num_weights, const IntegerFeature* first, const IntegerFeature* last ) {
+    return dotDispatch( w, num_weights, first, last );
+  }
+  static Real dot( const Real* w, size_t num_weights, const RealFeature* first, const RealFeature* last ) {
+    return dotDispatch( w, num_weights, first, last );
+  }
+
+  /// prod( w[ id ] ) over binary features in [first, last); w has num_weights elements
+  static Real product( const Real* w, size_t num_weights, const BinaryFeature* first, const BinaryFeature* last ) {
+#ifdef AMIS_SIMD_X86
+    size_t n = last - first;
+    if ( n >= MIN_VECTOR_LENGTH && num_weights <= MAX_VECTOR_WEIGHTS && level() != SCALAR ) {
+      return productAVX2( w, first, n );
+    }
+#endif // AMIS_SIMD_X86
+    Real prod = 1.0;
+    for ( ; first != last; ++first ) {
+      prod *= w[ first->id() ];
+    }
+    return prod;
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_SparseKernel_h_
+// end of SparseKernel.h
@@ -14,13 +14,135 @@
 #define Amis_StringHash_h_
 
 #include <amis/configure.h>
+#include <cstring>
 #include <string>
+#include <vector>
 
 AMIS_NAMESPACE_BEGIN
 
 template < class Obj >
 class StringHash : public amis_hash_map< std::string, Obj > {};
 
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Hash table from strings to IDs, looked up by a range of characters.
+ * The strings are kept in one pool of characters and the table is
+ * probed linearly, so that a lookup usually touches one entry and one
+ * string, and a token in the buffer of Tokenizer is found without
+ * making a std::string.
+ */
+
+template < class ID >
+class StringIndex {
+private:
+  struct Entry {
+    size_t hash;
+    size_t offset;
+    size_t size;
+    ID id;
+  };
+
+  static const size_t EMPTY = static_cast< size_t >( -1 );
+  static const size_t INITIAL_TABLE_SIZE = 16;
+
+  std::vector< Entry > table;
+  std::vector< char > pool;
+  size_t num_strings;
+
+  static size_t hashString( const char* s, size_t n ) {
+    // FNV-1a
+    size_t h = static_cast< size_t >( 2166136261UL );
+    for ( size_t i = 0; i < n; ++i ) {
+      h ^= static_cast< unsigned char >( s[ i ] );
+      h *= static_cast< size_t >( 16777619UL );
+    }
+    return h;
+  }
+
+  const Entry* findEntry( const char* s, size_t n, size_t h ) const {
+    if ( table.empty() ) return NULL;
+    size_t mask = table.size() - 1;
+    for ( size_t i = h & mask; ; i = ( i + 1 ) & mask ) {
+      const Entry& e = table[ i ];
+      if ( e.size == EMPTY ) return NULL;
+      if ( e.hash == h && e.size == n
+           && ( n == 0 || std::memcmp( &pool[ e.offset ], s, n ) == 0 ) ) {
+        return &e;
+      }
+    }
+  }
+
+  void place( const Entry& entry ) {
+    size_t mask = table.size() - 1;
+    size_t i = entry.hash & mask;
+    while ( table[ i ].size != EMPTY ) i = ( i + 1 ) & mask;
+    table[ i ] = entry;
+  }
+
+  void rehash( size_t new_size ) {
+    std::vector< Entry > old;
+    old.swap( table );
+    Entry empty_entry;
+    empty_entry.hash = 0;
+    empty_entry.offset = 0;
+    empty_entry.size = EMPTY;
+    empty_entry.id = ID();
+    table.assign( new_size, empty_entry );
+    for ( size_t i = 0; i < old.size(); ++i ) {
+      if ( old[ i ].size != EMPTY ) place( old[ i ] );
+    }
+  }
+
+public:
+  /// Constructor
+  StringIndex() : table(), pool(), num_strings( 0 ) {}
+
+  /// Number of strings
+  size_t size() const { return num_strings; }
+
+  /// Remove all the strings
+  void clear() {
+    table.clear();
+    pool.clear();
+    num_strings = 0;
+  }
+
+  /// Find the ID of a string of n characters
+  /// @return false if the string is not registered
+  bool find( const char* s, size_t n, ID& id ) const {
+    const Entry* e = findEntry( s, n, hashString( s, n ) );
+    if ( e == NULL ) return false;
+    id = e->id;
+    return true;
+  }
+  bool find( const std::string& s, ID& id ) const {
+    return find( s.data(), s.size(), id );
+  }
+
+  /// Register a string with its ID
+  /// @return false if the string is already registered
+  bool insert( const char* s, size_t n, ID id ) {
+    size_t h = hashString( s, n );
+    if ( findEntry( s, n, h ) != NULL ) return false;
+    if ( ( num_strings + 1 ) * 2 > table.size() ) {
+      rehash( table.empty() ? INITIAL_TABLE_SIZE : table.size() * 2 );
+    }
+    Entry e;
+    e.hash = h;
+    e.offset = pool.size();
+    e.size = n;
+    e.id = id;
+    pool.insert( pool.end(), s, s + n );
+    place( e );
+    ++num_strings;
+    return true;
+  }
+  bool insert( const std::string& s, ID id ) {
+    return insert( s.data(), s.size(), id );
+  }
+};
+
 
 AMIS_NAMESPACE_END
 
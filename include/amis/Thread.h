@@ -0,0 +1,307 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+#ifndef Amis_Thread_h_
+
+#define Amis_Thread_h_
+
+#include <amis/configure.h>
+#include <amis/ErrorBase.h>
+
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+#include <thread.h>
+#else // AMIS_SOLARIS_THREAD
+#include <pthread.h>
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+
+#include <exception>
+#include <string>
+
+AMIS_NAMESPACE_BEGIN
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * Error signaled when a thread cannot be created or a thread body failed.
+ */
+
+class ThreadError : public ErrorBase {
+public:
+  /// Constructor
+  explicit ThreadError( const std::string& s ) : ErrorBase( s ) {}
+  /// Constructor
+  explicit ThreadError( const char* s ) : ErrorBase( s ) {}
+  /// Destructor
+  virtual ~ThreadError() {}
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A minimal wrapper of native threads.
+ * Derived classes implement run().  When amis is configured without
+ * "--enable-parallel", start() simply executes run() in the calling
+ * thread, so that callers need not distinguish the two cases.
+ * An exception thrown in run() is re-thrown by join() as ThreadError.
+ */
+
+class Thread {
+private:
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+  thread_t thread_id;
+#else // AMIS_SOLARIS_THREAD
+  pthread_t thread_id;
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  bool running;
+  bool failed;
+  std::string error_message;
+
+  static void* entry( void* arg ) {
+    Thread* self = static_cast< Thread* >( arg );
+    try {
+      self->run();
+    }
+    catch ( ErrorBase& e ) {
+      self->failed = true;
+      self->error_message = e.message();
+    }
+    catch ( std::exception& e ) {
+      self->failed = true;
+      self->error_message = e.what();
+    }
+    catch ( ... ) {
+      self->failed = true;
+      self->error_message = "Unknown exception in a thread";
+    }
+    return NULL;
+  }
+
+  Thread( const Thread& );
+  Thread& operator=( const Thread& );
+
+protected:
+  /// Body of the thread
+  virtual void run() = 0;
+
+public:
+  /// Constructor
+  Thread() : running( false ), failed( false ) {}
+  /// Destructor
+  virtual ~Thread() {}
+
+  /// Whether threads really run concurrently
+  static bool isParallel() {
+#ifdef AMIS_PARALLEL
+    return true;
+#else // AMIS_PARALLEL
+    return false;
+#endif // AMIS_PARALLEL
+  }
+
+  /// Start the thread
+  void start() {
+    failed = false;
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    if ( thr_create( NULL, 0, &Thread::entry, this, 0, &thread_id ) != 0 ) {
+      throw ThreadError( "Cannot create a thread" );
+    }
+#else // AMIS_SOLARIS_THREAD
+    if ( pthread_create( &thread_id, NULL, &Thread::entry, this ) != 0 ) {
+      throw ThreadError( "Cannot create a thread" );
+    }
+#endif // AMIS_SOLARIS_THREAD
+    running = true;
+#else // AMIS_PARALLEL
+    entry( this );
+#endif // AMIS_PARALLEL
+  }
+
+  /// Wait for the termination of the thread
+  void join() {
+#ifdef AMIS_PARALLEL
+    if ( running ) {
+#ifdef AMIS_SOLARIS_THREAD
+      thr_join( thread_id, NULL, NULL );
+#else // AMIS_SOLARIS_THREAD
+      pthread_join( thread_id, NULL );
+#endif // AMIS_SOLARIS_THREAD
+      running = false;
+    }
+#endif // AMIS_PARALLEL
+    if ( failed ) {
+      throw ThreadError( error_message );
+    }
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A mutual exclusion lock.
+ * It does nothing when amis is configured without "--enable-parallel".
+ */
+
+class Mutex {
+  friend class Condition;
+private:
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+  mutex_t mutex;
+#else // AMIS_SOLARIS_THREAD
+  pthread_mutex_t mutex;
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+
+  Mutex( const Mutex& );
+  Mutex& operator=( const Mutex& );
+
+public:
+  /// Constructor
+  Mutex() {
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    mutex_init( &mutex, USYNC_THREAD, NULL );
+#else // AMIS_SOLARIS_THREAD
+    pthread_mutex_init( &mutex, NULL );
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  }
+  /// Destructor
+  ~Mutex() {
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    mutex_destroy( &mutex );
+#else // AMIS_SOLARIS_THREAD
+    pthread_mutex_destroy( &mutex );
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  }
+
+  /// Acquire the lock
+  void lock() {
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    mutex_lock( &mutex );
+#else // AMIS_SOLARIS_THREAD
+    pthread_mutex_lock( &mutex );
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  }
+  /// Release the lock
+  void unlock() {
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    mutex_unlock( &mutex );
+#else // AMIS_SOLARIS_THREAD
+    pthread_mutex_unlock( &mutex );
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  }
+};
+
+/**
+ * Holds a Mutex during its lifetime.
+ */
+
+class MutexLock {
+private:
+  Mutex& mutex;
+
+  MutexLock( const MutexLock& );
+  MutexLock& operator=( const MutexLock& );
+
+public:
+  /// Lock the mutex
+  explicit MutexLock( Mutex& m ) : mutex( m ) {
+    mutex.lock();
+  }
+  /// Unlock the mutex
+  ~MutexLock() {
+    mutex.unlock();
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+/**
+ * A condition variable used with a Mutex.
+ * It does nothing when amis is configured without "--enable-parallel";
+ * then wait() must not be called for a condition that only another
+ * thread can satisfy.
+ */
+
+class Condition {
+private:
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+  cond_t condition;
+#else // AMIS_SOLARIS_THREAD
+  pthread_cond_t condition;
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+
+  Condition( const Condition& );
+  Condition& operator=( const Condition& );
+
+public:
+  /// Constructor
+  Condition() {
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    cond_init( &condition, USYNC_THREAD, NULL );
+#else // AMIS_SOLARIS_THREAD
+    pthread_cond_init( &condition, NULL );
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  }
+  /// Destructor
+  ~Condition() {
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    cond_destroy( &condition );
+#else // AMIS_SOLARIS_THREAD
+    pthread_cond_destroy( &condition );
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  }
+
+  /// Release the locked mutex, wait for a signal, and lock it again
+  void wait( Mutex& mutex ) {
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    cond_wait( &condition, &mutex.mutex );
+#else // AMIS_SOLARIS_THREAD
+    pthread_cond_wait( &condition, &mutex.mutex );
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  }
+  /// Wake up all the waiting threads
+  void broadcast() {
+#ifdef AMIS_PARALLEL
+#ifdef AMIS_SOLARIS_THREAD
+    cond_broadcast( &condition );
+#else // AMIS_SOLARIS_THREAD
+    pthread_cond_broadcast( &condition );
+#endif // AMIS_SOLARIS_THREAD
+#endif // AMIS_PARALLEL
+  }
+};
+
+AMIS_NAMESPACE_END
+
+#endif // Amis_Thread_h_
+// end of Thread.h
@@ -80,8 +80,8 @@ private:
   size_t pointer;
   size_t buffer_size;
   size_t max_buffer_size;
+  size_t buffer_capacity;
   int prev_line_delim;
-  std::string temp;  // temporal storage
 
   const char* word_delimiters;
   const char* line_delimiters;
@@ -156,6 +156,11 @@ protected:
     buffer[ --pointer ] = c;
   }
 
+  /// Read more characters keeping a token from begin in the buffer;
+  /// the token is moved to the top of the buffer, which is enlarged
+  /// if the token fills it.  Returns false at the end of the stream.
+  bool fillToken( size_t& begin );
+
   void initCharClass( const char* char_it, CharClass c ) {
     while ( *char_it != '\0' ) {
       char_class[ *char_it ] = c;
@@ -180,7 +185,7 @@ public:
              const char* com_start = "#",
              const char* com_end = "",
              size_t max_buf_size = MAX_BUFFER_SIZE )
-    : stream_ref( s_ ), temp(),
+    : stream_ref( s_ ),
       word_delimiters( word_delim ), line_delimiters( line_delim ),
       escape( esc ), symbols( sym ),
       comment_start( com_start ), comment_end( com_end ),
@@ -189,7 +194,8 @@ public:
     current_delimiter = '\0';
     line_number = 0;
     max_buffer_size = ( stream_ref == std::cin && isatty( 0 ) ? 1 : max_buf_size );  // to avoid dead lock
-    buffer = new char[ max_buffer_size ];
+    buffer_capacity = max_buffer_size;
+    buffer = new char[ buffer_capacity ];
     pointer = 0;
     buffer_size = 0;
     prev_line_delim = EOF;
@@ -217,6 +223,10 @@ public:
     return line_number;
   }
   /// Get the current line number
+  void setLineNumber( int n ) {
+    line_number = n;
+  }
+  /// Set the current line number (for a stream starting in the middle of a file)
 
   static int str2int( const std::string& str ) {
     char* end_ptr;
@@ -238,6 +248,14 @@ public:
   }
   /// Translate a string into a real number
 
+  static int str2int( const char* str, size_t size );
+  /// Translate n characters into an integer; the same as str2int( std::string ),
+  /// without making a string for plain decimal numbers
+  static Real str2Real( const char* str, size_t size );
+  /// Translate n characters into a real number; the same as
+  /// str2Real( std::string ), without making a string for plain decimal
+  /// numbers that can be converted exactly
+
   bool gotoNewLine() {
     int c = get();
     if ( prev_line_delim != EOF && char_class[ c ] == LINE_DELIM && c != prev_line_delim ) c = get();  // to handle Windows' format
@@ -253,13 +271,28 @@ public:
     }
   }
 
-  bool nextToken( std::string& token, const char* delimiters = "" );
+  bool nextToken( const char*& token, size_t& size, const char* delimiters = "" );
+  /// Get a next token from an input line without copying it.  The token
+  /// points into the buffer of the tokenizer, and is valid until the
+  /// next call of the tokenizer.
+
+  bool nextToken( std::string& token, const char* delimiters = "" ) {
+    const char* p;
+    size_t size;
+    if ( nextToken( p, size, delimiters ) ) {
+      token.assign( p, size );
+      return true;
+    } else {
+      return false;
+    }
+  }
   /// Get a next token from an input line
 
   bool nextToken( int& i ) {
-    //std::string temp;
-    if ( nextToken( temp ) ) {
-      i = str2int( temp );
+    const char* p;
+    size_t size;
+    if ( nextToken( p, size ) ) {
+      i = str2int( p, size );
       return true;
     } else {
       return false;
@@ -267,10 +300,10 @@ public:
   }
   /// Get a next integer token from an input line
   bool nextToken( Real& r ) {
-    //std::string temp;
-    if ( nextToken( temp ) ) {
-      //AMIS_DEBUG_MESSAGE( 3, "IN:" <<  __PRETTY_FUNCTION__ << ", temp=" << temp << '\n' );
-      r = str2Real( temp );
+    const char* p;
+    size_t size;
+    if ( nextToken( p, size ) ) {
+      r = str2Real( p, size );
       return true;
     } else {
       return false;
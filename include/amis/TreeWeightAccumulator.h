@@ -40,6 +40,25 @@ public:
   TreeWeightAccumulator()
   { }
 
+  WeightAccumulator* clone() const
+  {
+    return new TreeWeightAccumulator<Feature, ParameterValue, ReferenceProbability>();
+  }
+
+  void collectFeatures(const EventBase& event_base,
+		       std::vector<FeatureID>& features) const
+  {
+    const EventType& tree =
+      dynamic_cast<const EventType&>(event_base);
+    for ( EventTreeNodeID i = 0; i < tree.numEventTreeNodes(); ++i ) {
+      if ( ! tree.isDisjunctiveNode( i ) ) {
+	for ( const Feature* feature = tree.featureBegin( i ); feature != tree.featureEnd( i ); ++feature ) {
+	  features.push_back(feature->id());
+	}
+      }
+    }
+  }
+
   void empiricalCount(std::vector<Real>& ee,
 		      const EventBase& event_base,
 		      Real event_empirical_expectation)
@@ -60,12 +79,30 @@ public:
 		  const EventBase& event_base,
 		  Real event_empirical_expectation,
 		  const ModelBase& model)
+  {
+    return modelCount(me,
+		      dynamic_cast<const EventType&>(event_base),
+		      event_empirical_expectation,
+		      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace()));
+  }
+
+  Real modelCountRange(std::vector<Real>& me,
+		       const EventBase* const* events,
+		       size_t num_events,
+		       Real event_empirical_expectation,
+		       const ModelBase& model)
+  {
+    return modelCountEach<EventType, ParameterValue>(*this, me, events, num_events,
+						     event_empirical_expectation, model);
+  }
+
+  /// Model expectation of an event of the concrete type
+  Real modelCount(std::vector<Real>& me,
+		  const EventType& tree,
+		  Real event_empirical_expectation,
+		  const ParameterSpace<ParameterValue>* parameterspace)
   {
     Real log_likelihood = 0.0;
-    const EventType& tree =
-      dynamic_cast<const EventType&>(event_base);
-    const ParameterSpace<ParameterValue>* parameterspace =
-      dynamic_cast<const ParameterSpace<ParameterValue>*>(model.getParameterSpace());
     
     AMIS_DEBUG_MESSAGE( 5, "\t\tMake AlphaProdTree\n" );
     alpha_tree.setProduct( *parameterspace, tree );
@@ -90,16 +127,14 @@ public:
     AMIS_DEBUG_MESSAGE( 5, "\t\tSet model expectations for features\n" );
     ParameterValue alpha_product;
     for ( EventTreeNodeID i = 0; i < tree.numEventTreeNodes(); ++i ) {
-      const EventTreeNode< Feature >& event_node = tree[ i ];
-      if ( ! event_node.isDisjunctiveNode() ) {
+      if ( ! tree.isDisjunctiveNode( i ) ) {
 	alpha_product = product( alpha_tree.insideProd( i ),
 				 alpha_tree.outsideProd( i ) );
 	AMIS_DEBUG_MESSAGE( 5, alpha_product << std::endl );
 	alpha_product *= denom;
-	for ( typename FeatureList< Feature >::const_iterator feature = event_node.featureList().begin();
-	      feature != event_node.featureList().end();
-	      ++feature ) {
-	  me[feature->id()] += alpha_product.getAlpha() * feature->freq();
+	Real alpha = alpha_product.getAlpha();
+	for ( const Feature* feature = tree.featureBegin( i ); feature != tree.featureEnd( i ); ++feature ) {
+	  me[feature->id()] += alpha * feature->freq();
 	}
       }
     }
@@ -141,12 +176,9 @@ public:
     }
 
     for ( EventTreeNodeID i = 0; i < tree.numEventTreeNodes(); ++i ) {
-      const EventTreeNode< Feature >& event_node = tree[ i ];
-      if ( ! event_node.isDisjunctiveNode() &&
+      if ( ! tree.isDisjunctiveNode( i ) &&
 	   viterbi_tree.isMaximizer(i) ) {
-	for ( typename FeatureList< Feature >::const_iterator feature = event_node.featureList().begin();
-	      feature != event_node.featureList().end();
-	      ++feature ) {
+	for ( const Feature* feature = tree.featureBegin( i ); feature != tree.featureEnd( i ); ++feature ) {
 	  Real incr = -feature->freq() * tree.eventFrequency() * step_size;
 	  model.incLambda(feature->id(), incr);
 	  history[feature->id()] += static_cast<double>(iteration) * incr;
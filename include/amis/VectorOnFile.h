@@ -48,23 +48,32 @@ class VectorOnFileError : public ErrorBase {
 /// <classdef>
 /// <name>VectorOnFile</name>
 /// <overview>A vector class on a file</overview>
-/// Only one element is accessible at the same time
+/// Only one element is accessible at the same time through operator[];
+/// concurrent readers use their own Cursor
 /// <body>
 
 template < class T >
 class VectorOnFile {
 public:
   static const int DEFAULT_CHUNK_SIZE = 512 * 1024 * 1024;  // 512 MB
+  /// Buffer size of the streams of a cursor.  Cursors jump between
+  /// ranges of objects, and the whole buffer is refilled at each jump.
+  static const size_t CURSOR_BUFFER_SIZE = 64 * 1024;
 
 private:
   std::string stream_base_name;
 
   std::vector<objstream*> stream_v;
-  std::vector<objstream*> event2stream_v;
+  /// Index in stream_v of the chunk file holding each object
+  std::vector<int> event2stream_v;
   std::vector<std::streampos>  event2pos_v;
   int                last_stream_no;
   std::streampos          last_pos;
-  
+
+  /// The object at which the read position of read_stream is, i.e. the
+  /// one following the object read last (-1 if unknown)
+  mutable int next_object;
+  mutable objstream* read_stream;
 
   mutable T* tmp_object;
 
@@ -78,9 +87,13 @@ protected:
     */
 
     // support multiple stream 
-    objstream* stream = event2stream_v[i];
+    objstream* stream = stream_v[event2stream_v[i]];
 
-    stream->seekg( event2pos_v[i] );
+    // objects are usually read in order; seeking only when the order is
+    // broken keeps the read-ahead buffer of the stream
+    if ( i != next_object || stream != read_stream ) {
+      stream->seekg( event2pos_v[i] );
+    }
 
     /*
     if ( ! *stream ) {
@@ -92,6 +105,8 @@ protected:
       throw VectorOnFileError( "Invalid Vector On Memory (should not happen)" );
     }
     tmp_object->readObject( *stream );
+    next_object = i + 1;
+    read_stream = stream;
     
     // Delete: since "!" predicts the success of the next action, 
     // not the previous action. 
@@ -113,8 +128,9 @@ protected:
     */
     objstream* stream = stream_v[last_stream_no];
     stream->seekg( last_pos );
+    next_object = -1;
 
-    event2stream_v.push_back(stream);
+    event2stream_v.push_back(last_stream_no);
     event2pos_v.push_back(last_pos);
     
     if ( ! *stream ) {
@@ -131,6 +147,7 @@ protected:
       std::string fname = os.str();
       AMIS_PROF_MESSAGE( "Creating a new temporary event file on " << fname << '\n' );
       stream_v.push_back(new objstream(fname));
+      stream_v.back()->setCompact( stream->isCompact() );
       last_pos = 0;
     }
   
@@ -148,6 +165,8 @@ public:
   
     last_stream_no = 0;
     last_pos       = 0;
+    next_object    = -1;
+    read_stream    = NULL;
   }
   
   VectorOnFile( objstream* s ) {
@@ -156,6 +175,8 @@ public:
     tmp_object = NULL;
     last_stream_no = 0;
     last_pos       = 0;
+    next_object    = -1;
+    read_stream    = NULL;
   }
   virtual ~VectorOnFile() {    
     delete tmp_object;
@@ -166,6 +187,8 @@ public:
     tmp_object = NULL;
     last_stream_no = 0;
     last_pos       = 0;
+    next_object    = -1;
+    read_stream    = NULL;
     event2stream_v.clear();
     event2pos_v.clear();
   }
@@ -178,6 +201,7 @@ public:
 
   void setStream( objstream* s ) {
     stream_v[0] = s; // ?? is this useful
+    next_object = -1;
   }
 
   int size( void ) const {
@@ -192,6 +216,67 @@ public:
   void push_back( const T& t ) {
     pushObject( t );
   }
+
+  /// Write out the objects buffered in the streams, so that they can
+  /// be read through other streams
+  void flush() const {
+    for ( size_t k = 0; k < stream_v.size(); ++k ) {
+      stream_v[k]->flush();
+    }
+  }
+
+  /// An independent read position over the objects.
+  /// A cursor opens the chunk files by itself and decodes objects into
+  /// its own workspace, so several threads can read objects at once,
+  /// each through its own cursor.  Objects must not be pushed while
+  /// cursors are in use.
+  class Cursor {
+  private:
+    const VectorOnFile* vec;
+    T* object;
+    /// Streams of the chunk files, opened on demand
+    std::vector<objstream*> streams;
+    int next_object;
+    int read_stream_no;
+
+    Cursor( const Cursor& );
+    Cursor& operator=( const Cursor& );
+
+  public:
+    /// Read the objects of v into obj, which is deleted with the cursor
+    Cursor( const VectorOnFile& v, T* obj )
+      : vec( &v ), object( obj ), streams( v.stream_v.size(), static_cast<objstream*>( NULL ) ),
+        next_object( -1 ), read_stream_no( -1 )
+    {
+      v.flush();
+    }
+    ~Cursor() {
+      for ( size_t k = 0; k < streams.size(); ++k ) {
+        delete streams[k];
+      }
+      delete object;
+    }
+
+    const T& operator[]( int i ) {
+      int stream_no = vec->event2stream_v[i];
+      objstream*& stream = streams[stream_no];
+      if ( stream == NULL ) {
+        stream = new objstream( vec->stream_v[stream_no]->fileName(), std::ios::in | std::ios::binary, CURSOR_BUFFER_SIZE );
+        if ( ! *stream ) {
+          throw VectorOnFileError( "Cannot open a temporary event file: " + stream->fileName() );
+        }
+        stream->setCompact( vec->stream_v[stream_no]->isCompact() );
+      }
+      if ( i != next_object || stream_no != read_stream_no ) {
+        stream->clear();
+        stream->seekg( vec->event2pos_v[i] );
+      }
+      object->readObject( *stream );
+      next_object = i + 1;
+      read_stream_no = stream_no;
+      return *object;
+    }
+  };
 };
 
 AMIS_NAMESPACE_END
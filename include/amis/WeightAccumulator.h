@@ -39,6 +39,37 @@ public:
 
 class WeightAccumulator {
   size_t ignored;
+protected:
+  /// Make a scratch buffer hold at least n elements.  Buffers only grow,
+  /// so an accumulator stops allocating once it has seen its largest event.
+  template <class T>
+  static void growScratch(std::vector<T>& buffer, size_t n)
+  {
+    if ( buffer.size() < n ) buffer.resize(n);
+  }
+  /// The body of modelCountRange for an accumulator whose events are all
+  /// of type Event: calls accumulator.modelCount(me, event, event_ee,
+  /// parameterspace) for each event, with the parameters of type Value
+  template <class Event, class Value, class Accumulator>
+  static Real modelCountEach(Accumulator& accumulator,
+			     std::vector<Real>& me,
+			     const EventBase* const* events,
+			     size_t num_events,
+			     Real event_ee,
+			     const ModelBase& model)
+  {
+    const ParameterSpace<Value>* parameterspace =
+      dynamic_cast<const ParameterSpace<Value>*>(model.getParameterSpace());
+    Real log_likelihood = 0.0;
+    for ( size_t i = 0; i < num_events; ++i ) {
+      // every event was made by the reader that made this accumulator
+      log_likelihood += accumulator.modelCount(me,
+					       static_cast<const Event&>(*events[i]),
+					       event_ee,
+					       parameterspace);
+    }
+    return log_likelihood;
+  }
 public:
   WeightAccumulator()
   {
@@ -50,6 +81,15 @@ public:
   void incIgnored() { ++ignored; }
   virtual ~WeightAccumulator()
   { }
+  /// Make a fresh accumulator of the same type (used for per-thread copies)
+  virtual WeightAccumulator* clone() const = 0;
+  /// Called with the current model before each pass of modelCountRange
+  /// over the events, on the accumulator that the clones were made of
+  virtual void prepare(const ModelBase& model)
+  { }
+  /// Append the IDs of features to which modelCount may add (duplicates allowed)
+  virtual void collectFeatures(const EventBase& event,
+			       std::vector<FeatureID>& features) const = 0;
   virtual void empiricalCount(std::vector<Real>& ee,
 			      const EventBase& event,
 			      Real event_ee) = 0;
@@ -57,6 +97,14 @@ public:
 			  const EventBase& event,
 			  Real event_ee,
 			  const ModelBase& model) = 0;
+  /// Same as modelCount for each of events[0 .. num_events), with the
+  /// types of the events and the parameters resolved once;
+  /// returns the sum of the log-likelihoods in the order of events
+  virtual Real modelCountRange(std::vector<Real>& me,
+			       const EventBase* const* events,
+			       size_t num_events,
+			       Real event_ee,
+			       const ModelBase& model) = 0;
 
   virtual void perceptronUpdate(const EventBase& event,
 				Real step_size,
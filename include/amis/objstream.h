@@ -19,48 +19,155 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 
 AMIS_NAMESPACE_BEGIN
 
 class objstream : public std::fstream
 {
+public:
+  /// Size of the buffer of the stream; objects are read sequentially
+  /// in large blocks through it
+  static const size_t BUFFER_SIZE = 1024 * 1024;
+
 private:
   std::string name;
+  std::vector< char > buffer;
+  bool compact;
   objstream(std::fstream* st){
     AMIS_ABORT( "Not yet implemented. Please tell me how to make a stream from another stream (kazama@is.s.u-tokyo.ac.jp)." );
   }
 
 public:
   objstream(const std::string& filename,
-            std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc ) : std::fstream(filename.c_str(), mode) {
+            std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc,
+            size_t buffer_size = BUFFER_SIZE ) : std::fstream(), buffer( buffer_size ), compact( false ) {
     name = filename;
+    // the buffer must be given before the file is opened
+    rdbuf()->pubsetbuf( &buffer[ 0 ], buffer.size() );
+    open( filename.c_str(), mode );
     seekg(0);
   }
   /// Make a new objstream of a specified file name
+  ~objstream() {
+    // flush the buffer while it is still alive
+    if ( is_open() ) close();
+  }
 
   const std::string& fileName( void ) const { return name; }
   /// Get a name of the file
 
+  bool isCompact() const { return compact; }
+  /// Whether objects are written in the compact encoding
+  void setCompact( bool c ) { compact = c; }
+  /// Select the compact encoding, in which feature IDs are written as
+  /// variable-length differences and default values are omitted.
+  /// Objects must be read in the encoding by which they were written.
+
   template< class T > objstream& operator<< (const T& obj);
   /// Input from an objstream
   template< class T > objstream& operator>> (T& obj);
   /// Output to an objstream
+
+  /// Write n objects stored contiguously at p in one block.
+  /// T must be a plain type which can be copied byte by byte.
+  template< class T > objstream& writeBlock( const T* p, size_t n ) {
+    return putBytes( reinterpret_cast< const char* >( p ), n * sizeof( T ) );
+  }
+  /// Read n objects into the contiguous storage at p in one block
+  template< class T > objstream& readBlock( T* p, size_t n ) {
+    return getBytes( reinterpret_cast< char* >( p ), n * sizeof( T ) );
+  }
+
+  /// Write the size of a vector followed by its elements in one block
+  template< class T, class Alloc > objstream& writeArray( const std::vector< T, Alloc >& v ) {
+    *this << static_cast< size_t >( v.size() );
+    return v.empty() ? *this : writeBlock( &v[ 0 ], v.size() );
+  }
+  /// Read a vector written by writeArray; its storage is reused when
+  /// it is large enough
+  template< class T, class Alloc > objstream& readArray( std::vector< T, Alloc >& v ) {
+    size_t n = 0;
+    *this >> n;
+    if ( fail() ) return *this;
+    v.resize( n );
+    return n == 0 ? *this : readBlock( &v[ 0 ], n );
+  }
+
+  /// Write an unsigned integer in 7-bit groups, smaller first
+  objstream& writeVarint( size_t v ) {
+    if ( fail() ) return *this;
+    std::streambuf* sb = rdbuf();
+    for ( ; v >= 0x80; v >>= 7 ) {
+      if ( sb->sputc( static_cast< char >( ( v & 0x7f ) | 0x80 ) ) == std::char_traits< char >::eof() ) {
+        setstate( std::ios::badbit );
+        return *this;
+      }
+    }
+    if ( sb->sputc( static_cast< char >( v ) ) == std::char_traits< char >::eof() ) setstate( std::ios::badbit );
+    return *this;
+  }
+  /// Read an unsigned integer written by writeVarint
+  size_t readVarint() {
+    std::streambuf* sb = rdbuf();
+    int c = sb->sbumpc();
+    if ( ! ( c & 0x80 ) ) return c;  // one byte; eof() has the bit set
+    if ( c == std::char_traits< char >::eof() ) {
+      setstate( std::ios::eofbit | std::ios::failbit );
+      return 0;
+    }
+    size_t v = c & 0x7f;
+    for ( int shift = 7; ; shift += 7 ) {
+      c = sb->sbumpc();
+      if ( c == std::char_traits< char >::eof() ) {
+        setstate( std::ios::eofbit | std::ios::failbit );
+        return 0;
+      }
+      v |= static_cast< size_t >( c & 0x7f ) << shift;
+      if ( ! ( c & 0x80 ) ) return v;
+    }
+  }
+  /// Write a signed integer; small absolute values take few bytes
+  objstream& writeSignedVarint( long v ) {
+    return writeVarint( v < 0 ? ( static_cast< size_t >( ~v ) << 1 ) | 1 : static_cast< size_t >( v ) << 1 );
+  }
+  /// Read a signed integer written by writeSignedVarint
+  long readSignedVarint() {
+    size_t v = readVarint();
+    return ( v & 1 ) ? ~static_cast< long >( v >> 1 ) : static_cast< long >( v >> 1 );
+  }
+
+private:
+  /// Copy bytes into the buffer of the stream.  Unlike write(), this
+  /// does not build a sentry for each call, which dominates the cost
+  /// of writing small objects one by one.
+  objstream& putBytes( const char* p, size_t len ) {
+    if ( fail() || len == 0 ) return *this;
+    if ( rdbuf()->sputn( p, len ) != static_cast< std::streamsize >( len ) ) {
+      setstate( std::ios::badbit );
+    }
+    return *this;
+  }
+  /// Copy bytes out of the buffer of the stream
+  objstream& getBytes( char* p, size_t len ) {
+    if ( fail() || len == 0 ) return *this;
+    if ( rdbuf()->sgetn( p, len ) != static_cast< std::streamsize >( len ) ) {
+      setstate( std::ios::eofbit | std::ios::failbit );
+    }
+    return *this;
+  }
 };
 
 template< class T >
 objstream& objstream::operator<<( const T& obj )
 {
-  int len = sizeof( obj );
-  write( reinterpret_cast< const char* >( &obj ), len );
-  return *this;
+  return putBytes( reinterpret_cast< const char* >( &obj ), sizeof( obj ) );
 }
 
 template< class T >
 objstream& objstream::operator>>( T& obj )
 {
-  int len = sizeof( obj );
-  read( reinterpret_cast< char* >( &obj ), len );
-  return *this;
+  return getBytes( reinterpret_cast< char* >( &obj ), sizeof( obj ) );
 }
 
 AMIS_NAMESPACE_END
@@ -15,6 +15,8 @@
 #include <amis/Profile.h>
 #include <amis/ErrorBase.h>
 #include <amis/EventFormat.h>
+#include <amis/EventCache.h>
+#include <amis/ParallelEventInput.h>
 //#include <amis/EstimatorState.h>
 #include <amis/BzStream.h>
 #include <amis/ZStream.h>
@@ -289,16 +291,37 @@ void AmisDriver::inputEventSpace( EventReader& reader,
                                   EventSpace& event_space )
 {
   reader.initialize();
+
+  std::string cache_file = property.getEventCache();
+  if ( ! cache_file.empty() ) {
+    objstream cache( cache_file, std::ios::in | std::ios::binary );
+    if ( ! cache ) {
+      throw( AmisDriverError( "Cannot open input file " + cache_file ) );
+    }
+    EventCache( &reader, eventCacheSignature() ).inputEventSpace( cache, reader.featureNameTable(), event_space );
+    return;
+  }
+
   EventFormat format(&reader);
 
   std::vector<std::string> event_files = property.getEventFileList();
+  std::vector<std::string> reference_files;
   if ( property.getReferenceDistribution() ) {
-    // with reference distribution
-    std::vector<std::string> reference_files = property.getReferenceFileList();
+    reference_files = property.getReferenceFileList();
     if ( event_files.size() != reference_files.size() ) {
       throw ( AmisDriverError( "The numbers of event and references files are different" ) );
     }
-    
+  }
+
+  if ( Thread::isParallel() && property.getNumThreads() > 1 ) {
+    // parse the files concurrently
+    ParallelEventInput input( &reader, property.getNumThreads(), property.getEventFileCompression() );
+    input.inputEventSpace( event_files,
+			   property.getReferenceDistribution() ? &reference_files : NULL,
+			   event_space );
+  }
+  else if ( property.getReferenceDistribution() ) {
+    // with reference distribution
     std::vector<std::string>::iterator event_it = event_files.begin();
     std::vector<std::string>::iterator reference_it = reference_files.begin();
     for ( ;
@@ -328,6 +351,23 @@ void AmisDriver::inputEventSpace( EventReader& reader,
       format.inputEventSpace( *event_file, event_space );
     }
   }
+
+  std::string write_cache_file = property.getWriteEventCache();
+  if ( ! write_cache_file.empty() ) {
+    objstream cache( write_cache_file, std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( ! cache ) {
+      throw( AmisDriverError( "Cannot open an output file: " + write_cache_file ) );
+    }
+    EventCache( &reader, eventCacheSignature() ).outputEventSpace( cache, reader.featureNameTable(), event_space );
+  }
+}
+
+std::string AmisDriver::eventCacheSignature()
+{
+  std::string signature = property.getDataFormat() + "," + property.getFeatureType();
+  if ( property.getReferenceDistribution() ) signature += ",Reference";
+  if ( ! property.getRestrictionFileList().empty() ) signature += ",Restricted";
+  return signature;
 }
 
 
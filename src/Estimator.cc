@@ -34,6 +34,7 @@ Estimator::Estimator()
   max_update = 0.0;
   till_convergence = false;
   suppress_message = false;
+  deterministic_reduction = false;
 
   model = NULL;
   event_space = NULL;
@@ -54,6 +55,7 @@ Estimator::Estimator( ModelBase* init_model, EventSpace* init_event )
   max_update = 0.0;
   till_convergence = false;
   suppress_message = false;
+  deterministic_reduction = false;
 
   setModel( init_model );
   setEventSpace( init_event );
@@ -39,6 +39,13 @@ namespace {
   EventReaderLauncherItem< AmisEventReader< RealFeature, LambdaValue, false > >
   amis_amis_real_lambda_false( EventReaderIdentifier("Amis", "real", "lambda", false), "Amis-style standard event format (binary feature)" );
 
+  EventReaderLauncherItem< AmisEventReader< BinaryFeature, ScaledAlphaValue, false > >
+  amis_amis_binary_scaled_false( EventReaderIdentifier("Amis", "binary", "scaled", false), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisEventReader< IntegerFeature, ScaledAlphaValue, false > >
+  amis_amis_integer_scaled_false( EventReaderIdentifier("Amis", "integer", "scaled", false), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisEventReader< RealFeature, ScaledAlphaValue, false > >
+  amis_amis_real_scaled_false( EventReaderIdentifier("Amis", "real", "scaled", false), "Amis-style standard event format (binary feature)" );
+
   EventReaderLauncherItem< AmisEventReader< BinaryFeature, AlphaValue, true > >
   amis_amis_binary_alpha_true( EventReaderIdentifier("Amis", "binary", "alpha", true), "Amis-style standard event format (binary feature)" );
   EventReaderLauncherItem< AmisEventReader< IntegerFeature, AlphaValue, true > >
@@ -53,6 +60,13 @@ namespace {
   EventReaderLauncherItem< AmisEventReader< RealFeature, LambdaValue, true > >
   amis_amis_real_lambda_true( EventReaderIdentifier("Amis", "real", "lambda", true), "Amis-style standard event format (binary feature)" );
 
+  EventReaderLauncherItem< AmisEventReader< BinaryFeature, ScaledAlphaValue, true > >
+  amis_amis_binary_scaled_true( EventReaderIdentifier("Amis", "binary", "scaled", true), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisEventReader< IntegerFeature, ScaledAlphaValue, true > >
+  amis_amis_integer_scaled_true( EventReaderIdentifier("Amis", "integer", "scaled", true), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisEventReader< RealFeature, ScaledAlphaValue, true > >
+  amis_amis_real_scaled_true( EventReaderIdentifier("Amis", "real", "scaled", true), "Amis-style standard event format (binary feature)" );
+
 
   EventReaderLauncherItem< AmisTreeEventReader< BinaryFeature, AlphaValue, false > >
   amis_tree_binary_alpha_false( EventReaderIdentifier("AmisTree", "binary", "alpha", false), "Amis-style standard event format (binary feature)" );
@@ -68,6 +82,13 @@ namespace {
   EventReaderLauncherItem< AmisTreeEventReader< RealFeature, LambdaValue, false > >
   amis_tree_real_lambda_false( EventReaderIdentifier("AmisTree", "real", "lambda", false), "Amis-style standard event format (binary feature)" );
 
+  EventReaderLauncherItem< AmisTreeEventReader< BinaryFeature, ScaledAlphaValue, false > >
+  amis_tree_binary_scaled_false( EventReaderIdentifier("AmisTree", "binary", "scaled", false), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisTreeEventReader< IntegerFeature, ScaledAlphaValue, false > >
+  amis_tree_integer_scaled_false( EventReaderIdentifier("AmisTree", "integer", "scaled", false), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisTreeEventReader< RealFeature, ScaledAlphaValue, false > >
+  amis_tree_real_scaled_false( EventReaderIdentifier("AmisTree", "real", "scaled", false), "Amis-style standard event format (binary feature)" );
+
   EventReaderLauncherItem< AmisTreeEventReader< BinaryFeature, AlphaValue, true > >
   amis_tree_binary_alpha_true( EventReaderIdentifier("AmisTree", "binary", "alpha", true), "Amis-style standard event format (binary feature)" );
   EventReaderLauncherItem< AmisTreeEventReader< IntegerFeature, AlphaValue, true > >
@@ -82,6 +103,13 @@ namespace {
   EventReaderLauncherItem< AmisTreeEventReader< RealFeature, LambdaValue, true > >
   amis_tree_real_lambda_true( EventReaderIdentifier("AmisTree", "real", "lambda", true), "Amis-style standard event format (binary feature)" );
 
+  EventReaderLauncherItem< AmisTreeEventReader< BinaryFeature, ScaledAlphaValue, true > >
+  amis_tree_binary_scaled_true( EventReaderIdentifier("AmisTree", "binary", "scaled", true), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisTreeEventReader< IntegerFeature, ScaledAlphaValue, true > >
+  amis_tree_integer_scaled_true( EventReaderIdentifier("AmisTree", "integer", "scaled", true), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisTreeEventReader< RealFeature, ScaledAlphaValue, true > >
+  amis_tree_real_scaled_true( EventReaderIdentifier("AmisTree", "real", "scaled", true), "Amis-style standard event format (binary feature)" );
+
 
   EventReaderLauncherItem< AmisFixEventReader< BinaryFeature, AlphaValue, false > >
   amis_fix_binary_alpha_false( EventReaderIdentifier("AmisFix", "binary", "alpha", false), "Amis-style standard event format (binary feature)" );
@@ -97,6 +125,13 @@ namespace {
   EventReaderLauncherItem< AmisFixEventReader< RealFeature, LambdaValue, false > >
   amis_fix_real_lambda_false( EventReaderIdentifier("AmisFix", "real", "lambda", false), "Amis-style standard event format (binary feature)" );
 
+  EventReaderLauncherItem< AmisFixEventReader< BinaryFeature, ScaledAlphaValue, false > >
+  amis_fix_binary_scaled_false( EventReaderIdentifier("AmisFix", "binary", "scaled", false), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisFixEventReader< IntegerFeature, ScaledAlphaValue, false > >
+  amis_fix_integer_scaled_false( EventReaderIdentifier("AmisFix", "integer", "scaled", false), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisFixEventReader< RealFeature, ScaledAlphaValue, false > >
+  amis_fix_real_scaled_false( EventReaderIdentifier("AmisFix", "real", "scaled", false), "Amis-style standard event format (binary feature)" );
+
   EventReaderLauncherItem< AmisFixEventReader< BinaryFeature, AlphaValue, true > >
   amis_fix_binary_alpha_true( EventReaderIdentifier("AmisFix", "binary", "alpha", true), "Amis-style standard event format (binary feature)" );
   EventReaderLauncherItem< AmisFixEventReader< IntegerFeature, AlphaValue, true > >
@@ -111,6 +146,13 @@ namespace {
   EventReaderLauncherItem< AmisFixEventReader< RealFeature, LambdaValue, true > >
   amis_fix_real_lambda_true( EventReaderIdentifier("AmisFix", "real", "lambda", true), "Amis-style standard event format (binary feature)" );
 
+  EventReaderLauncherItem< AmisFixEventReader< BinaryFeature, ScaledAlphaValue, true > >
+  amis_fix_binary_scaled_true( EventReaderIdentifier("AmisFix", "binary", "scaled", true), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisFixEventReader< IntegerFeature, ScaledAlphaValue, true > >
+  amis_fix_integer_scaled_true( EventReaderIdentifier("AmisFix", "integer", "scaled", true), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisFixEventReader< RealFeature, ScaledAlphaValue, true > >
+  amis_fix_real_scaled_true( EventReaderIdentifier("AmisFix", "real", "scaled", true), "Amis-style standard event format (binary feature)" );
+
 
   EventReaderLauncherItem< AmisCRFEventReader< BinaryFeature, AlphaValue, false > >
   amis_crf_binary_alpha_false( EventReaderIdentifier("AmisCRF", "binary", "alpha", false), "Amis-style standard event format (binary feature)" );
@@ -126,6 +168,13 @@ namespace {
   EventReaderLauncherItem< AmisCRFEventReader< RealFeature, LambdaValue, false > >
   amis_crf_real_lambda_false( EventReaderIdentifier("AmisCRF", "real", "lambda", false), "Amis-style standard event format (binary feature)" );
 
+  EventReaderLauncherItem< AmisCRFEventReader< BinaryFeature, ScaledAlphaValue, false > >
+  amis_crf_binary_scaled_false( EventReaderIdentifier("AmisCRF", "binary", "scaled", false), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisCRFEventReader< IntegerFeature, ScaledAlphaValue, false > >
+  amis_crf_integer_scaled_false( EventReaderIdentifier("AmisCRF", "integer", "scaled", false), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisCRFEventReader< RealFeature, ScaledAlphaValue, false > >
+  amis_crf_real_scaled_false( EventReaderIdentifier("AmisCRF", "real", "scaled", false), "Amis-style standard event format (binary feature)" );
+
   EventReaderLauncherItem< AmisCRFEventReader< BinaryFeature, AlphaValue, true > >
   amis_crf_binary_alpha_true( EventReaderIdentifier("AmisCRF", "binary", "alpha", true), "Amis-style standard event format (binary feature)" );
   EventReaderLauncherItem< AmisCRFEventReader< IntegerFeature, AlphaValue, true > >
@@ -140,6 +189,13 @@ namespace {
   EventReaderLauncherItem< AmisCRFEventReader< RealFeature, LambdaValue, true > >
   amis_crf_real_lambda_true( EventReaderIdentifier("AmisCRF", "real", "lambda", true), "Amis-style standard event format (binary feature)" );
 
+  EventReaderLauncherItem< AmisCRFEventReader< BinaryFeature, ScaledAlphaValue, true > >
+  amis_crf_binary_scaled_true( EventReaderIdentifier("AmisCRF", "binary", "scaled", true), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisCRFEventReader< IntegerFeature, ScaledAlphaValue, true > >
+  amis_crf_integer_scaled_true( EventReaderIdentifier("AmisCRF", "integer", "scaled", true), "Amis-style standard event format (binary feature)" );
+  EventReaderLauncherItem< AmisCRFEventReader< RealFeature, ScaledAlphaValue, true > >
+  amis_crf_real_scaled_true( EventReaderIdentifier("AmisCRF", "real", "scaled", true), "Amis-style standard event format (binary feature)" );
+
 }
 
 // end of EventReader.cc
@@ -34,6 +34,7 @@ namespace {
 
   ModelLauncherItem< Model, AlphaValue > model_alpha_item( ModelIdentifier("Model", "alpha"), "Standard model" );
   ModelLauncherItem< Model, LambdaValue > model_lambda_item( ModelIdentifier("Model", "lambda"), "Standard model" );
+  ModelLauncherItem< Model, ScaledAlphaValue > model_scaled_item( ModelIdentifier("Model", "scaled"), "Standard model" );
 
 }
 
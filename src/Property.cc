@@ -16,6 +16,9 @@
 #include <GzStream.h>
 #include <BzStream.h>
 #include <ZStream.h>
+#include <amis/PipeStream.h>
+#include <amis/ParallelBzStream.h>
+#include <algorithm>
 
 AMIS_NAMESPACE_BEGIN
 
@@ -72,13 +75,18 @@ PropertyItem< std::string > Property::data_dir( "DATA_DIR", "--data-dir", "-D",
 PropertyItemVector< std::string > Property::model_file_list( "MODEL_FILE", "--model-file", "-m", std::vector< std::string >( 1, "amis.model" ), "Model file name(s)" );
 PropertyItemVector< std::string > Property::event_file_list( "EVENT_FILE", "--event-file", "-e", std::vector< std::string >( 1, "amis.event" ), "Event file name(s)" );
 PropertyItemVector< std::string > Property::fixmap_file_list( "FIXMAP_FILE", "--fixmap-file", "-x", std::vector< std::string >( 1, "amis.fixmap" ), "Mapper for AmisFix format" );
+PropertyItemVector< std::string > Property::restriction_file_list( "RESTRICTION_FILE", "--restriction-file", "", std::vector< std::string >(), "Groups of the targets allowed for events of AmisFix format" );
 PropertyItemVector< std::string > Property::transition_file_list( "TRANSITION_FILE", "--transition-file", "-t", std::vector< std::string >( 1, "amis.trans" ), "Transition Table for AmisCRF Format" );
 //PropertyItem< bool > Property::event_file_bz2( "EVENT_FILE_BZ2", "--event-file-bz2", "", false, "Event files are provided as compressed (bzip2) files" );
 PropertyItem< std::string > Property::event_file_compression( "EVENT_FILE_COMPRESSION", "--event-file-compression", "", "none", "Compression format of event file [raw, gz, z, bz2]" );
 PropertyItem< std::string > Property::model_file_compression( "MODEL_FILE_COMPRESSION", "--model-file-compression", "", "none", "Compression format of model file [raw, gz, z, bz2]" );
 PropertyItem< std::string > Property::output_file_compression( "OUTPUT_FILE_COMPRESSION", "--output-file-compression", "", "none", "Compression format of output file [raw, gz, z, bz2]" );
 PropertyItem< std::string > Property::fixmap_file_compression( "FIXMAP_FILE_COMPRESSION", "--fixmap-file-compression", "", "none", "Compression format of fixmap file [raw, gz, z, bz2]" );
+PropertyItem< int > Property::decompression_buffers( "DECOMPRESSION_BUFFERS", "--decompression-buffers", "", 4, "The number of blocks decompressed ahead by a separate thread, at least 2 (0: decompress in the reading thread)" );
+PropertyItem< int > Property::decompression_buffer_size( "DECOMPRESSION_BUFFER_SIZE", "--decompression-buffer-size", "", 1024, "The size of a block decompressed ahead, in kilobytes" );
+PropertyItem< std::string > Property::fix_target_layout( "FIX_TARGET_LAYOUT", "--fix-target-layout", "", "auto", "Layout of the fixmap used to score the targets of AmisFix (sparse, dense, auto)" );
 PropertyItem< std::string > Property::transition_file_compression( "TRANSITION_FILE_COMPRESSION", "--transition-file-compression", "", "none", "Compression format of transition file [raw, gz, z, bz2]" );
+PropertyItem< std::string > Property::crf_transition_layout( "CRF_TRANSITION_LAYOUT", "--crf-transition-layout", "", "auto", "Layout of the transitions of AmisCRF (sparse, dense, auto)" );
 PropertyItemVector< std::string > Property::reference_file_list( "REFERENCE_FILE", "--reference-file", "", std::vector< std::string >( 1, "amis.ref" ), "Reference distribution file name(s)" );
 PropertyItem< std::string > Property::output_file( "OUTPUT_FILE", "--output-file", "-o", "amis.output", "The name of the output file" );
 PropertyItem< std::string > Property::prob_file( "PROB_FILE", "--prob-file", "-b", "amis.prob", "The name of the file of probability output" );
@@ -86,13 +94,18 @@ PropertyItem< std::string > Property::log_file( "LOG_FILE", "--log-file", "-l",
 PropertyItem< std::string > Property::statistics_file( "STATISTICS_FILE", "--statistics-file", "", "amis.stat", "The name of the file of the statistics of features" );
 PropertyItem< std::string > Property::data_format( "DATA_FORMAT", "--data-format", "-d", "Amis", "Data format type (Amis, AmisTree, AmisFix)" );
 PropertyItem< std::string > Property::estimation_algorithm( "ESTIMATION_ALGORITHM", "--estimation-algorithm", "-a", "GIS", "Estimation algorithm (GIS, GISMAP, BFGS, BFGSMAP, BLMVMBC, BLMVMBCMAP)" );
-PropertyItem< std::string > Property::parameter_type( "PARAMETER_TYPE", "--parameter-type", "", "alpha", "Internal parameter type (alpha, lambda)" );
+PropertyItem< std::string > Property::parameter_type( "PARAMETER_TYPE", "--parameter-type", "", "alpha", "Internal parameter type (alpha, lambda, scaled)" );
 PropertyItem< int > Property::num_iterations( "NUM_ITERATIONS", "--num-iterations", "-i", 200, "The number of iterations" );
 PropertyItem< int > Property::report_interval( "REPORT_INTERVAL", "--report-interval", "-r", 1, "The interval of interation report" );
 PropertyItem< int > Property::prec( "PRECISION", "--precision", "-p", 6, "The precision of the estimation" );
 PropertyItem< bool > Property::event_on_file( "EVENT_ON_FILE", "--event-on-file", "", false, "Store events on file during the estimation" );
 PropertyItem< std::string > Property::event_on_file_name( "EVENT_ON_FILE_NAME", "--event-on-file-name", "", "amis.event.tmp", "The name of temp event file used by EVENT_ON_FILE" );
+PropertyItem< std::string > Property::event_on_file_encoding( "EVENT_ON_FILE_ENCODING", "--event-on-file-encoding", "", "raw", "Encoding of events in the temp event file (raw, compact)" );
+PropertyItem< std::string > Property::event_cache( "EVENT_CACHE", "--event-cache", "", "", "Read events from an event cache instead of EVENT_FILE" );
+PropertyItem< std::string > Property::write_event_cache( "WRITE_EVENT_CACHE", "--write-event-cache", "", "", "Write the events read from EVENT_FILE to an event cache" );
 PropertyItem< int > Property::num_threads( "NUM_THREADS", "--num-threads", "-j", 1, "The level of parallelism of estimation" );
+PropertyItem< std::string > Property::reduction( "REDUCTION", "--reduction", "", "fast", "Reduction of expectations computed by threads (fast, deterministic)" );
+PropertyItem< std::string > Property::log_sum_exp( "LOG_SUM_EXP", "--log-sum-exp", "", "exact", "Summation of lambda values in log space (exact, fast)" );
 PropertyItem< bool > Property::till_convergence( "TILL_CONVERGENCE", "--till-convergence", "-tc", false, "Run estimation till convergence" );
 PropertyItem< bool > Property::suppress_message( "SUPPRESS_MESSAGE", "--suppress-message", "", false, "Suppress profiling messages" );
 PropertyItem< std::string > Property::variance_type( "VARIANCE_TYPE", "--variance-type", "", "single", "Type of the variances used for MAP estimation" );
@@ -206,9 +219,14 @@ void Property::importProperty( void ) throw( IllegalPropertyError ) {
 std::auto_ptr< std::istream > Property::openInputStream( const std::string& file_name, const std::string& compress = "none" )
 {
   std::auto_ptr< std::istream > ret;
+  // blocks of bzip2 are decoded on NUM_THREADS threads
+  bool parallel_bz2 = IParallelBzStreamBuf::isAvailable() && num_threads.getValue() > 1;
   
   if (file_name == "-") {
-    if ( compress == "bz2" ) {
+    if ( compress == "bz2" && parallel_bz2 ) {
+      ret = std::auto_ptr< std::istream >( new IParallelBzStream( std::cin, num_threads.getValue() ) );
+    }
+    else if ( compress == "bz2" ) {
       ret = std::auto_ptr< std::istream >( new IBzStream( std::cin ) );
     }
     else if ( compress == "z" ) {
@@ -226,7 +244,10 @@ std::auto_ptr< std::istream > Property::openInputStream( const std::string& file
     }
   }
   else {
-    if ( compress == "bz2" ) {
+    if ( compress == "bz2" && parallel_bz2 ) {
+      ret = std::auto_ptr< std::istream >( new IParallelBzFStream( file_name, num_threads.getValue() ) );
+    }
+    else if ( compress == "bz2" ) {
       ret = std::auto_ptr< std::istream >( new IBzFStream( file_name ) );
     }
     else if ( compress == "z" ) {
@@ -243,6 +264,22 @@ std::auto_ptr< std::istream > Property::openInputStream( const std::string& file
     }
   }
 
+  if ( compress != "none" && compress != "raw" && ! ( compress == "bz2" && parallel_bz2 ) ) {
+    // decompress on a separate thread while the caller parses the text
+    int num_blocks = decompression_buffers.getValue();
+    if ( num_blocks < 0 || num_blocks == 1 ) {
+      OStringStream os;
+      os << "DECOMPRESSION_BUFFERS must be 0 or at least 2: " << num_blocks;
+      throw IllegalPropertyError( os.str() );
+    }
+    if ( num_blocks > 0 && IPipeStreamBuf::isAvailable() ) {
+      size_t block_size = static_cast< size_t >( std::max( decompression_buffer_size.getValue(), 1 ) ) * 1024;
+      ret = std::auto_ptr< std::istream >( new IPipeStream( ret, block_size, num_blocks ) );
+    }
+  }
+
+  // an error in decompression is thrown to the reader, not taken as the end of the file
+  ret->exceptions( std::ios::badbit );
   return ret;
 }
 
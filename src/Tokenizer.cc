@@ -11,6 +11,8 @@
 //////////////////////////////////////////////////////////////////////
 #include <amis/Tokenizer.h>
 #include <amis/Profile.h>
+#include <algorithm>
+#include <cstring>
 
 AMIS_NAMESPACE_BEGIN
 
@@ -70,12 +72,34 @@ bool Tokenizer::nextToken( std::string& token, const char* delimiters ) {
 }
 */
 
-bool Tokenizer::nextToken( std::string& token, const char* delimiters )
+bool Tokenizer::fillToken( size_t& begin )
+{
+  if ( ! stream_ref ) return false;
+  if ( begin > 0 ) {
+    std::memmove( buffer, buffer + begin, buffer_size - begin );
+    pointer -= begin;
+    buffer_size -= begin;
+    begin = 0;
+  }
+  if ( buffer_size == buffer_capacity ) {
+    char* new_buffer = new char[ buffer_capacity * 2 ];
+    std::memcpy( new_buffer, buffer, buffer_size );
+    delete [] buffer;
+    buffer = new_buffer;
+    buffer_capacity *= 2;
+  }
+  size_t size = std::min( max_buffer_size, buffer_capacity - buffer_size );
+  stream_ref.read( buffer + buffer_size, size );
+  size_t count = stream_ref.gcount();
+  buffer_size += count;
+  return count > 0;
+}
+
+bool Tokenizer::nextToken( const char*& token, size_t& size, const char* delimiters )
 {
-  static std::vector< char > char_list;
   if ( endOfStream() ) return false;
   int c = get();
-  if ( prev_line_delim != EOF && char_class[ c ] == LINE_DELIM && c != prev_line_delim ) c = get();  // to handle Windows' format
+  if ( prev_line_delim != EOF && c != EOF && char_class[ c ] == LINE_DELIM && c != prev_line_delim ) c = get();  // to handle Windows' format
   prev_line_delim = EOF;
   while ( true ) {
     // read delimiters until a proper character appears
@@ -90,8 +114,8 @@ bool Tokenizer::nextToken( std::string& token, const char* delimiters )
       continue;
     }
     if ( char_class[ c ] == SYMBOL ) {
-      token = c;
-      //std::cerr << "token = " << token << std::endl;
+      token = buffer + pointer - 1;
+      size = 1;
       return true;
     }
     if ( char_class[ c ] == WORD_DELIM ) {
@@ -106,7 +130,7 @@ bool Tokenizer::nextToken( std::string& token, const char* delimiters )
     if ( char_class[ c ] == COM_START ) {
       while ( c != EOF && char_class[ c ] != LINE_DELIM && char_class[ c ] != COM_END ) c = get();
       current_delimiter = c;
-      if ( char_class[ c ] == COM_END ) {
+      if ( c != EOF && char_class[ c ] == COM_END ) {
 	c = get();
 	continue;
       }
@@ -120,43 +144,133 @@ bool Tokenizer::nextToken( std::string& token, const char* delimiters )
     }
     throw TokenError( "Unbalanced Comment end token" );
   }
-  char_list.resize( 0 );
+  // the token is scanned in the buffer; c is at pointer - 1
+  size_t begin = pointer - 1;
+  size_t end = pointer;
+  bool escaped = ( char_class[ c ] == ESCAPE );  // retains the escape character but reads the next character as-is
+  bool extra_delimiters = ( *delimiters != '\0' );
   while ( true ) {
-    if ( char_class[ c ] == ESCAPE ) {
-      // retains the escape character but reads the next character as-is
-      char_list.push_back( c );
-      c = get();
-      if ( c == EOF ) {
-	end_of_stream = true;
+    if ( pointer == buffer_size && ! fillToken( begin ) ) {
+      end_of_stream = true;
+      if ( escaped ) {
 	throw TokenError( "Escape character found at the end of the stream" );
       }
-    }
-    char_list.push_back( c );
-    c = get();
-    current_delimiter = c;
-    if ( c == EOF ) {
-      end_of_stream = true;
+      current_delimiter = EOF;
+      end = pointer;
       break;
     }
+    c = static_cast< unsigned char >( buffer[ pointer ] );
+    if ( escaped ) {
+      ++pointer;
+      escaped = false;
+      continue;
+    }
+    current_delimiter = c;
     CharClass cl = char_class[ c ];
     if ( cl == OTHER || cl == ESCAPE ) {
-      if ( findChar( delimiters, c ) ) break;
+      ++pointer;
+      if ( extra_delimiters && findChar( delimiters, c ) ) {
+	end = pointer - 1;
+	break;
+      }
+      escaped = ( cl == ESCAPE );
       continue;
     }
     if ( cl == WORD_DELIM ) {
+      end = pointer++;
       break;
     }
     if ( cl == LINE_DELIM ||
 	 cl == COM_START ||
 	 cl == SYMBOL ) {
-      putback( c );
+      end = pointer;
       break;
     }
+    ++pointer;
     throw TokenError( "Unbalanced Comment end token" );
   }
-  token = std::string( char_list.begin(), char_list.end() );
-  //std::cerr << "token = " << token << std::endl;
-  return ! token.empty();
+  token = buffer + begin;
+  size = end - begin;
+  return true;
+}
+
+int Tokenizer::str2int( const char* str, size_t size )
+{
+  // plain decimal numbers of up to 9 digits (without a leading zero,
+  // which strtol reads as octal)
+  const char* p = str;
+  const char* end = str + size;
+  bool negative = false;
+  if ( p != end && ( *p == '-' || *p == '+' ) ) {
+    negative = ( *p == '-' );
+    ++p;
+  }
+  if ( p != end && end - p <= 9 && ( *p != '0' || end - p == 1 ) ) {
+    int num = 0;
+    for ( ; p != end; ++p ) {
+      if ( *p < '0' || *p > '9' ) break;
+      num = num * 10 + ( *p - '0' );
+    }
+    if ( p == end ) return negative ? -num : num;
+  }
+  return str2int( std::string( str, size ) );
+}
+
+Real Tokenizer::str2Real( const char* str, size_t size )
+{
+#if defined( __FLT_EVAL_METHOD__ ) && __FLT_EVAL_METHOD__ == 0
+  // Plain decimal numbers whose digits and power of ten are exact
+  // doubles; one multiplication or division is then correctly rounded,
+  // and gives the same value as strtod
+  static const double power_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  static const int MAX_DIGITS = 15;
+  static const int MAX_POWER = 22;
+  const char* p = str;
+  const char* end = str + size;
+  bool negative = false;
+  if ( p != end && ( *p == '-' || *p == '+' ) ) {
+    negative = ( *p == '-' );
+    ++p;
+  }
+  double mantissa = 0.0;
+  int num_digits = 0;
+  int exponent = 0;
+  for ( ; p != end && *p >= '0' && *p <= '9'; ++p, ++num_digits ) {
+    mantissa = mantissa * 10.0 + ( *p - '0' );
+  }
+  if ( p != end && *p == '.' ) {
+    for ( ++p; p != end && *p >= '0' && *p <= '9'; ++p, ++num_digits ) {
+      mantissa = mantissa * 10.0 + ( *p - '0' );
+      --exponent;
+    }
+  }
+  if ( num_digits > 0 && num_digits <= MAX_DIGITS ) {
+    bool valid = true;
+    if ( p != end && ( *p == 'e' || *p == 'E' ) ) {
+      ++p;
+      bool negative_exponent = false;
+      if ( p != end && ( *p == '-' || *p == '+' ) ) {
+	negative_exponent = ( *p == '-' );
+	++p;
+      }
+      int e = 0;
+      int num_exponent_digits = 0;
+      for ( ; p != end && *p >= '0' && *p <= '9' && num_exponent_digits < 4; ++p, ++num_exponent_digits ) {
+	e = e * 10 + ( *p - '0' );
+      }
+      valid = ( num_exponent_digits > 0 );
+      exponent += negative_exponent ? -e : e;
+    }
+    if ( valid && p == end && exponent >= -MAX_POWER && exponent <= MAX_POWER ) {
+      double num = exponent >= 0 ? mantissa * power_of_ten[ exponent ] : mantissa / power_of_ten[ -exponent ];
+      return static_cast< Real >( negative ? -num : num );
+    }
+  }
+#endif // __FLT_EVAL_METHOD__
+  return str2Real( std::string( str, size ) );
 }
 
 AMIS_NAMESPACE_END
@@ -127,7 +127,7 @@ protected:
       } else {
         // conjunctive node
         node_check[ id ] = true;
-        for ( typename FeatureList< Feature >::const_iterator fit = event_tree[ id ].featureList().begin();
+        for ( typename EventTreeFeatureList< Feature >::const_iterator fit = event_tree[ id ].featureList().begin();
               fit != event_tree[ id ].featureList().end();
               ++fit ) {
           if ( fit->freq() != static_cast< FeatureFreq >( 0 ) && ! observed_feature[ fit->id() ] ) {
@@ -168,7 +168,7 @@ protected:
     //std::cerr << node_id << std::endl;
     if ( ! node_check[ node_id ] ) return false;
     if ( ++num_node_check > limit_node_check ) throw ForestCheckerError( "limit of node checks exceeded" );
-    EventTreeNode< Feature >& node = event_tree[ node_id ];
+    const EventTreeNode< Feature > node = event_tree[ node_id ];
     if ( node.isDisjunctiveNode() ) {
       // disjunctive node
       std::vector< EventTreeNodeID > node_stack_copy( node_stack );
@@ -181,7 +181,7 @@ protected:
       return false;
     } else {
       // conjunctive node
-      for ( typename FeatureList< Feature >::const_iterator fit = node.featureList().begin();
+      for ( typename EventTreeFeatureList< Feature >::const_iterator fit = node.featureList().begin();
             fit != node.featureList().end();
             ++fit ) {
         observed_freq[ fit->id() ] -= fit->freq();
@@ -224,7 +224,7 @@ protected:
       }
 FAIL:
       // backtracking
-      for ( typename FeatureList< Feature >::const_iterator fit = node.featureList().begin();
+      for ( typename EventTreeFeatureList< Feature >::const_iterator fit = node.featureList().begin();
             fit != node.featureList().end();
             ++fit ) {
         observed_freq[ fit->id() ] += fit->freq();
@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+// Compares the vector loops of DenseKernel with the scalar loops on
+// random matrices.  The values are small multiples of 1/4, so that the
+// products and their sums are exact in any order, and many products tie.
+
+#include <amis/configure.h>
+#include <amis/DenseKernel.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace amis;
+
+namespace {
+
+const int NUM_CASES = 20000;
+const size_t MAX_LENGTH = 40;
+
+unsigned long seed = 12345;
+
+size_t nextRandom( size_t n ) {
+  seed = ( seed * 1103515245 + 12345 ) & 0x7fffffff;
+  return ( seed >> 16 ) % n;
+}
+
+Real randomValue() {
+  static const Real values[] = { 0.0, 0.25, 0.5, 1.0, 1.0, 2.0, 3.0 };
+  return values[ nextRandom( sizeof( values ) / sizeof( values[ 0 ] ) ) ];
+}
+
+void scalarProduct( const Real* m, const Real* x, Real* y, size_t n ) {
+  for ( size_t i = 0; i < n; ++i, m += n ) {
+    Real sum = 0.0;
+    for ( size_t j = 0; j < n; ++j ) {
+      sum += m[ j ] * x[ j ];
+    }
+    y[ i ] = sum;
+  }
+}
+
+size_t scalarMaxProduct( const Real* m, const Real* x, size_t n, Real& best ) {
+  size_t arg = n;
+  for ( size_t j = 0; j < n; ++j ) {
+    Real v = m[ j ] * x[ j ];
+    if ( v > best ) {
+      best = v;
+      arg = j;
+    }
+  }
+  return arg;
+}
+
+}
+
+int main() {
+  std::cout << "DenseKernel: " << SparseKernel::levelName( SparseKernel::level() ) << std::endl;
+  if ( SparseKernel::level() == SparseKernel::SCALAR ) {
+    std::cout << "The vector loops are not used on this machine" << std::endl;
+    return 77;  // skipped
+  }
+  int num_errors = 0;
+  for ( int c = 0; c < NUM_CASES; ++c ) {
+    size_t n = DenseKernel::MIN_VECTOR_LENGTH + nextRandom( MAX_LENGTH - DenseKernel::MIN_VECTOR_LENGTH + 1 );
+    std::vector< Real > m( n * n ), x( n ), y( n ), expected( n );
+    for ( size_t i = 0; i < m.size(); ++i ) m[ i ] = randomValue();
+    for ( size_t i = 0; i < n; ++i ) x[ i ] = randomValue();
+
+    DenseKernel::product( &m[ 0 ], &x[ 0 ], &y[ 0 ], n );
+    scalarProduct( &m[ 0 ], &x[ 0 ], &expected[ 0 ], n );
+    for ( size_t i = 0; i < n; ++i ) {
+      if ( y[ i ] != expected[ i ] ) {
+        std::cerr << "product: case " << c << " n=" << n << " row " << i << ": "
+                  << y[ i ] << " != " << expected[ i ] << std::endl;
+        ++num_errors;
+        break;
+      }
+    }
+
+    // an initial best of -1 is below every product; others may tie with them
+    Real initial = nextRandom( 4 ) == 0 ? -1.0 : randomValue() * randomValue();
+    for ( size_t i = 0; i < n; ++i ) {
+      Real best = initial, expected_best = initial;
+      size_t arg = DenseKernel::maxProduct( &m[ i * n ], &x[ 0 ], n, best );
+      size_t expected_arg = scalarMaxProduct( &m[ i * n ], &x[ 0 ], n, expected_best );
+      if ( arg != expected_arg || best != expected_best ) {
+        std::cerr << "maxProduct: case " << c << " n=" << n << " row " << i << ": "
+                  << arg << " (" << best << ") != " << expected_arg << " (" << expected_best << ")" << std::endl;
+        ++num_errors;
+        break;
+      }
+    }
+    if ( num_errors >= 10 ) break;
+  }
+  if ( num_errors > 0 ) {
+    std::cout << num_errors << " cases failed" << std::endl;
+    return 1;
+  }
+  std::cout << NUM_CASES << " cases passed" << std::endl;
+  return 0;
+}
+
+// end of densekernelcheck.cc
@@ -0,0 +1,141 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2006, Yusuke Miyao
+//  You may distribute under the terms of the Artistic License.
+//
+//  Amis - A maximum entropy estimator
+//
+//  Author: Yusuke Miyao (yusuke@is.s.u-tokyo.ac.jp)
+//  $Id$
+//
+//////////////////////////////////////////////////////////////////////
+
+// Compares SparseKernel::dot and product with scalar loops on random
+// feature lists around and above MIN_VECTOR_LENGTH.  The weights and
+// frequencies are small multiples of 1/4 and the product factors are
+// powers of two, so that the results are exact in any order.  The
+// level is capped by AMIS_SIMD as usual; sparsekernelcheck_avx2.sh runs
+// this again with the AVX2 kernels.
+
+#include <amis/configure.h>
+#include <amis/SparseKernel.h>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace amis;
+
+namespace {
+
+const int NUM_CASES = 5000;
+const size_t MIN_LENGTH = 60;
+const size_t MAX_LENGTH = 600;
+const size_t NUM_WEIGHTS = 1000;
+
+unsigned long seed = 12345;
+
+size_t nextRandom( size_t n ) {
+  seed = ( seed * 1103515245 + 12345 ) & 0x7fffffff;
+  return ( seed >> 16 ) % n;
+}
+
+Real randomValue() {
+  static const Real values[] = { 0.0, 0.25, 0.5, 1.0, 1.0, 2.0, 3.0, -1.5 };
+  return values[ nextRandom( sizeof( values ) / sizeof( values[ 0 ] ) ) ];
+}
+
+Real randomFactor() {
+  static const Real values[] = { 0.5, 1.0, 1.0, 2.0 };
+  return values[ nextRandom( sizeof( values ) / sizeof( values[ 0 ] ) ) ];
+}
+
+template < class Feature > Feature randomFeature();
+
+template <> BinaryFeature randomFeature< BinaryFeature >() {
+  return BinaryFeature( nextRandom( NUM_WEIGHTS ) );
+}
+
+template <> IntegerFeature randomFeature< IntegerFeature >() {
+  return IntegerFeature( nextRandom( NUM_WEIGHTS ), static_cast< int >( nextRandom( 9 ) ) - 2 );
+}
+
+template <> RealFeature randomFeature< RealFeature >() {
+  return RealFeature( nextRandom( NUM_WEIGHTS ), randomValue() );
+}
+
+template < class Feature >
+Real scalarDot( const Real* w, const Feature* f, size_t n ) {
+  Real sum = 0.0;
+  for ( size_t i = 0; i < n; ++i ) sum += w[ f[ i ].id() ] * f[ i ].freq();
+  return sum;
+}
+
+Real scalarProduct( const Real* w, const BinaryFeature* f, size_t n ) {
+  Real prod = 1.0;
+  for ( size_t i = 0; i < n; ++i ) prod *= w[ f[ i ].id() ];
+  return prod;
+}
+
+template < class Feature >
+int checkDot( const char* name ) {
+  int num_errors = 0;
+  std::vector< Real > w( NUM_WEIGHTS );
+  for ( int c = 0; c < NUM_CASES && num_errors < 10; ++c ) {
+    for ( size_t i = 0; i < NUM_WEIGHTS; ++i ) w[ i ] = randomValue();
+    size_t n = MIN_LENGTH + nextRandom( MAX_LENGTH - MIN_LENGTH + 1 );
+    std::vector< Feature > f;
+    for ( size_t i = 0; i < n; ++i ) f.push_back( randomFeature< Feature >() );
+    // const pointers select the vector kernels (others take the scalar loop)
+    const Feature* first = &f[ 0 ];
+    Real result = SparseKernel::dot( &w[ 0 ], NUM_WEIGHTS, first, first + n );
+    Real expected = scalarDot( &w[ 0 ], &f[ 0 ], n );
+    if ( result != expected ) {
+      std::cerr << "dot<" << name << ">: case " << c << " n=" << n << ": "
+                << result << " != " << expected << std::endl;
+      ++num_errors;
+    }
+  }
+  return num_errors;
+}
+
+int checkProduct() {
+  int num_errors = 0;
+  std::vector< Real > w( NUM_WEIGHTS );
+  for ( int c = 0; c < NUM_CASES && num_errors < 10; ++c ) {
+    for ( size_t i = 0; i < NUM_WEIGHTS; ++i ) w[ i ] = randomFactor();
+    size_t n = MIN_LENGTH + nextRandom( MAX_LENGTH - MIN_LENGTH + 1 );
+    std::vector< BinaryFeature > f;
+    for ( size_t i = 0; i < n; ++i ) f.push_back( randomFeature< BinaryFeature >() );
+    const BinaryFeature* first = &f[ 0 ];
+    Real result = SparseKernel::product( &w[ 0 ], NUM_WEIGHTS, first, first + n );
+    Real expected = scalarProduct( &w[ 0 ], &f[ 0 ], n );
+    if ( result != expected ) {
+      std::cerr << "product: case " << c << " n=" << n << ": "
+                << result << " != " << expected << std::endl;
+      ++num_errors;
+    }
+  }
+  return num_errors;
+}
+
+}
+
+int main() {
+  std::cout << "SparseKernel: " << SparseKernel::levelName( SparseKernel::level() ) << std::endl;
+  if ( SparseKernel::level() == SparseKernel::SCALAR ) {
+    std::cout << "The vector loops are not used on this machine" << std::endl;
+    return 77;  // skipped
+  }
+  int num_errors = checkDot< BinaryFeature >( "BinaryFeature" )
+    + checkDot< IntegerFeature >( "IntegerFeature" )
+    + checkDot< RealFeature >( "RealFeature" )
+    + checkProduct();
+  if ( num_errors > 0 ) {
+    std::cout << num_errors << " cases failed" << std::endl;
+    return 1;
+  }
+  std::cout << 4 * NUM_CASES << " cases passed" << std::endl;
+  return 0;
+}
+
+// end of sparsekernelcheck.cc
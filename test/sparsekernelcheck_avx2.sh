@@ -0,0 +1,7 @@
+#!/bin/sh
+
+# Runs sparsekernelcheck with the AVX2 kernels, which processors with
+# AVX-512 would not use otherwise
+AMIS_SIMD=avx2
+export AMIS_SIMD
+exec ./sparsekernelcheck